@@ -0,0 +1,146 @@
+// Petter Strandmark 2013.
+
+#include <algorithm>
+#include <cstdlib>
+
+#ifdef __linux__
+	#include <sys/mman.h>
+#endif
+
+#include "arena.h"
+
+namespace rapidsvg {
+
+namespace
+{
+	const std::size_t alignment = 16;
+	// Size of a huge page on x86-64 and most other platforms.
+	const std::size_t huge_page_size = 2 << 20;
+}
+
+Arena::Arena(std::size_t block_size_) :
+	block_size(block_size_),
+	huge_pages(false),
+	current_index(0),
+	current(0),
+	allocated_blocks(0),
+	reused_blocks(0)
+{
+}
+
+Arena::~Arena()
+{
+	release();
+}
+
+Arena::Block* Arena::allocate_block(std::size_t size, bool huge_pages)
+{
+	Block* block = new Block;
+	block->size = size;
+	block->used = 0;
+	block->huge_pages = false;
+
+	#ifdef __linux__
+		if (huge_pages) {
+			// Huge pages need blocks aligned to and sized in huge pages.
+			std::size_t rounded = (size + huge_page_size - 1) / huge_page_size * huge_page_size;
+			void* memory = 0;
+			if (posix_memalign(&memory, huge_page_size, rounded) == 0) {
+				madvise(memory, rounded, MADV_HUGEPAGE);
+				block->memory = static_cast<char*>(memory);
+				block->size = rounded;
+				block->huge_pages = true;
+				return block;
+			}
+		}
+	#endif
+
+	block->memory = static_cast<char*>(::operator new(size));
+	return block;
+}
+
+void Arena::free_block(Block* block)
+{
+	if (block->huge_pages) {
+		std::free(block->memory);
+	}
+	else {
+		::operator delete(block->memory);
+	}
+	delete block;
+}
+
+void Arena::set_huge_pages(bool use_huge_pages)
+{
+	huge_pages = use_huge_pages;
+}
+
+void* Arena::allocate(std::size_t size)
+{
+	size = (std::max(size, std::size_t(1)) + alignment - 1) / alignment * alignment;
+	while (true) {
+		Block* block = current.load(std::memory_order_acquire);
+		if (block) {
+			std::size_t start = block->used.fetch_add(size);
+			if (start + size <= block->size) {
+				return block->memory + start;
+			}
+		}
+		next_block(block, size);
+	}
+}
+
+void Arena::next_block(Block* full_block, std::size_t size)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (current.load() != full_block) {
+		// Another thread already moved on to a new block.
+		return;
+	}
+
+	// Blocks after the current one are unused since the last reset. The
+	// first one large enough is moved forward and used.
+	std::size_t next = full_block ? current_index + 1 : 0;
+	std::size_t index = next;
+	while (index < blocks.size() && blocks[index]->size < size) {
+		index++;
+	}
+	if (index < blocks.size()) {
+		std::swap(blocks[index], blocks[next]);
+		blocks[next]->used = 0;
+		reused_blocks++;
+	}
+	else {
+		blocks.insert(blocks.begin() + next,
+		              allocate_block(std::max(size, block_size), huge_pages));
+		allocated_blocks++;
+	}
+	current_index = next;
+	current.store(blocks[next], std::memory_order_release);
+}
+
+void Arena::reset()
+{
+	current.store(0);
+	current_index = 0;
+}
+
+void Arena::release()
+{
+	reset();
+	for (auto block : blocks) {
+		free_block(block);
+	}
+	blocks.clear();
+}
+
+std::size_t Arena::get_reserved_bytes() const
+{
+	std::size_t bytes = 0;
+	for (auto block : blocks) {
+		bytes += block->size;
+	}
+	return bytes;
+}
+
+}
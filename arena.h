@@ -0,0 +1,135 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_ARENA_H
+#define RAPIDSVG_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace rapidsvg {
+
+// Bump allocator for the memory of a scene. Memory is taken from large
+// blocks and is never freed on its own; instead the whole arena is reset
+// at once, keeping the blocks for the next scene. Allocation may be done
+// from several threads at once.
+class Arena
+{
+public:
+	explicit Arena(std::size_t block_size = 16 << 20);
+	~Arena();
+
+	// Allocates size bytes aligned to 16 bytes.
+	void* allocate(std::size_t size);
+
+	// Makes all memory available again. Nothing allocated may be used
+	// afterwards and no allocation may run concurrently.
+	void reset();
+	// Resets the arena and returns the blocks to the system.
+	void release();
+
+	// Whether new blocks should be backed by transparent huge pages,
+	// where the system supports it.
+	void set_huge_pages(bool use_huge_pages);
+
+	std::size_t get_reserved_bytes() const;
+	// Number of blocks allocated from the system so far.
+	std::size_t get_allocated_blocks() const { return allocated_blocks; }
+	// Number of blocks used again after a reset so far.
+	std::size_t get_reused_blocks() const { return reused_blocks; }
+
+private:
+	Arena(const Arena&);
+	Arena& operator=(const Arena&);
+
+	struct Block
+	{
+		char* memory;
+		std::size_t size;
+		std::atomic<std::size_t> used;
+		bool huge_pages;
+	};
+
+	// Makes a block with room for size bytes current, unless another
+	// thread already replaced full_block.
+	void next_block(Block* full_block, std::size_t size);
+	static Block* allocate_block(std::size_t size, bool huge_pages);
+	static void free_block(Block* block);
+
+	const std::size_t block_size;
+	bool huge_pages;
+	std::vector<Block*> blocks;
+	// Index in blocks of the current block.
+	std::size_t current_index;
+	std::atomic<Block*> current;
+	std::mutex mutex;
+	std::size_t allocated_blocks;
+	std::size_t reused_blocks;
+};
+
+// Standard allocator drawing from an arena. Deallocation does nothing.
+// Without an arena, the global heap is used.
+template<typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+	// Containers take the arena along when moved or swapped, so that
+	// memory is always returned to where it came from.
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	ArenaAllocator() : arena(0)
+	{ }
+	explicit ArenaAllocator(Arena* arena_) : arena(arena_)
+	{ }
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena)
+	{ }
+
+	T* allocate(std::size_t n)
+	{
+		if (arena) {
+			return static_cast<T*>(arena->allocate(n * sizeof(T)));
+		}
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+	}
+
+	void deallocate(T* pointer, std::size_t)
+	{
+		if (!arena) {
+			::operator delete(pointer);
+		}
+	}
+
+	template<typename U>
+	struct rebind
+	{
+		typedef ArenaAllocator<U> other;
+	};
+
+	Arena* arena;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+	return a.arena == b.arena;
+}
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+	return a.arena != b.arena;
+}
+
+// Points of polygons and polylines.
+typedef std::vector<std::pair<float, float>,
+                    ArenaAllocator<std::pair<float, float> > > PointVector;
+
+}
+
+#endif
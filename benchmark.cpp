@@ -0,0 +1,749 @@
+// Petter Strandmark 2013.
+//
+// Benchmarks of the loading stages. Runs on the given SVG file, or on a
+// generated one if no file is given.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef USE_OPENMP
+	#include <omp.h>
+#else
+	#include <ctime>
+	namespace
+	{
+		double omp_get_wtime()
+		{
+			return std::time(0);
+		}
+	}
+#endif
+
+#ifdef __linux__
+	#include <linux/perf_event.h>
+	#include <sys/ioctl.h>
+	#include <sys/resource.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+#endif
+
+#include "color.h"
+#include "indexed_lines.h"
+#include "line_chains.h"
+#include "render_batch.h"
+#include "spatial_order.h"
+#include "svg_file.h"
+
+namespace rapidsvg {
+
+// Results are written here so that they are not optimized away.
+volatile double benchmark_sink = 0;
+
+// Counts the cache misses of the calling process, where the platform
+// allows it.
+class CacheMissCounter
+{
+public:
+	CacheMissCounter() : file_descriptor(-1)
+	{
+		#ifdef __linux__
+			perf_event_attr attr;
+			std::memset(&attr, 0, sizeof(attr));
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.size = sizeof(attr);
+			attr.config = PERF_COUNT_HW_CACHE_MISSES;
+			attr.disabled = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			file_descriptor = int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+		#endif
+	}
+
+	~CacheMissCounter()
+	{
+		#ifdef __linux__
+			if (file_descriptor >= 0) {
+				close(file_descriptor);
+			}
+		#endif
+	}
+
+	bool available() const { return file_descriptor >= 0; }
+
+	void start()
+	{
+		#ifdef __linux__
+			if (available()) {
+				ioctl(file_descriptor, PERF_EVENT_IOC_RESET, 0);
+				ioctl(file_descriptor, PERF_EVENT_IOC_ENABLE, 0);
+			}
+		#endif
+	}
+
+	// Returns the number of misses since start, or -1.
+	long long stop()
+	{
+		long long count = -1;
+		#ifdef __linux__
+			if (available()) {
+				ioctl(file_descriptor, PERF_EVENT_IOC_DISABLE, 0);
+				if (read(file_descriptor, &count, sizeof(count)) != sizeof(count)) {
+					count = -1;
+				}
+			}
+		#endif
+		return count;
+	}
+
+private:
+	int file_descriptor;
+};
+
+// Returns the peak resident memory of the process in bytes, or 0 where
+// the platform does not report it.
+size_t peak_resident_bytes()
+{
+	#ifdef __linux__
+		rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) == 0) {
+			return size_t(usage.ru_maxrss) * 1024;
+		}
+	#endif
+	return 0;
+}
+
+// Writes a grid graph with its edges in random order, which is what
+// our generated files tend to look like.
+void generate_graph_svg(const std::string& filename, int side)
+{
+	std::vector<std::pair<int, int> > edges;
+	for (int y = 0; y < side; ++y) {
+		for (int x = 0; x < side; ++x) {
+			if (x + 1 < side) {
+				edges.push_back(std::make_pair(y * side + x, y * side + x + 1));
+			}
+			if (y + 1 < side) {
+				edges.push_back(std::make_pair(y * side + x, (y + 1) * side + x));
+			}
+		}
+	}
+	std::mt19937 engine(0);
+	std::shuffle(edges.begin(), edges.end(), engine);
+
+	std::ofstream fout(filename);
+	if (!fout) {
+		throw std::runtime_error("Could not write generated file.");
+	}
+	fout << "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n";
+	fout << "<svg width=\"" << side << "\" height=\"" << side
+	     << "\" version=\"1.1\" xmlns=\"http://www.w3.org/2000/svg\">\n";
+	for (auto& edge : edges) {
+		fout << "<line style=\"stroke-width:0.01;stroke:#4f4f4f;\" "
+		     << "x1=\"" << edge.first % side << "\" y1=\"" << edge.first / side << "\" "
+		     << "x2=\"" << edge.second % side << "\" y2=\"" << edge.second / side << "\" />\n";
+	}
+	fout << "</svg>\n";
+}
+
+// Writes a binary tree of nested groups with lines at the leaves. With
+// transforms, every group is translated, rotated and scaled.
+void generate_nested_groups_svg(const std::string& filename, int depth,
+                                int lines_per_leaf, bool with_transforms)
+{
+	std::ofstream fout(filename);
+	if (!fout) {
+		throw std::runtime_error("Could not write generated file.");
+	}
+	fout << "<svg width=\"100\" height=\"100\" viewBox=\"-50 -50 100 100\" "
+	     << "xmlns=\"http://www.w3.org/2000/svg\">\n";
+
+	// Depth-first, with one entry per open group: the number of children
+	// written so far.
+	std::vector<int> open(1, 0);
+	while (!open.empty()) {
+		if (int(open.size()) == depth + 1) {
+			for (int i = 0; i < lines_per_leaf; ++i) {
+				fout << "<line style=\"stroke-width:0.01;stroke:#000000\" x1=\"" << i
+				     << "\" y1=\"0\" x2=\"" << i << "\" y2=\"1\" />\n";
+			}
+			open.pop_back();
+			fout << "</g>\n";
+		}
+		else if (open.back() < 2) {
+			if (with_transforms) {
+				fout << "<g transform=\"translate(" << (open.back() ? 1 : -1)
+				     << ",0.5) rotate(15) scale(0.9)\">\n";
+			}
+			else {
+				fout << "<g>\n";
+			}
+			open.back()++;
+			open.push_back(0);
+		}
+		else {
+			open.pop_back();
+			if (!open.empty()) {
+				fout << "</g>\n";
+			}
+		}
+	}
+	fout << "</svg>\n";
+}
+
+// Writes polygons and polylines with many points each.
+void generate_shapes_svg(const std::string& filename, int num_shapes,
+                         int points_per_shape)
+{
+	std::ofstream fout(filename);
+	if (!fout) {
+		throw std::runtime_error("Could not write generated file.");
+	}
+	fout << "<svg width=\"1000\" height=\"1000\" xmlns=\"http://www.w3.org/2000/svg\">\n";
+	std::mt19937 engine(0);
+	std::uniform_int_distribution<int> coordinate(0, 999);
+	for (int i = 0; i < num_shapes; ++i) {
+		fout << (i % 2 ? "<polyline" : "<polygon") << " points=\"";
+		for (int p = 0; p < points_per_shape; ++p) {
+			fout << coordinate(engine) << "," << coordinate(engine) << " ";
+		}
+		fout << "\" style=\"fill:#4f4f4f\" />\n";
+	}
+	fout << "</svg>\n";
+}
+
+// Reads every element tile by tile through a grid of element indices,
+// which is the access pattern of culling and tile rasterization.
+class TilePass
+{
+public:
+	TilePass(const SVGFile& file, int tiles_per_side) :
+		bins(tiles_per_side * tiles_per_side)
+	{
+		for (size_t i = 0; i < file.lines.size(); ++i) {
+			Rect box = file.lines[i].bounding_box();
+			int tx = tile(box.x_min + box.x_max, file.get_width() * 2, tiles_per_side);
+			int ty = tile(box.y_min + box.y_max, file.get_height() * 2, tiles_per_side);
+			bins[ty * tiles_per_side + tx].push_back(i);
+		}
+	}
+
+	// Returns a checksum of everything read.
+	double run(const SVGFile& file) const
+	{
+		double sum = 0;
+		for (auto& bin : bins) {
+			for (auto i : bin) {
+				const Line& line = file.lines[i];
+				sum += line.x1 + line.y1 + line.x2 + line.y2 + line.width;
+			}
+		}
+		return sum;
+	}
+
+private:
+	static int tile(double coordinate, double size, int tiles_per_side)
+	{
+		int t = int(coordinate / size * tiles_per_side);
+		return std::max(0, std::min(tiles_per_side - 1, t));
+	}
+
+	std::vector<std::vector<size_t> > bins;
+};
+
+void benchmark_spatial_order(const std::string& filename)
+{
+	using namespace std;
+
+	SVGFile file;
+	file.load(filename);
+
+	CacheMissCounter counter;
+	const int tiles_per_side = 256;
+	const int repetitions = 5;
+
+	long long misses[2];
+	double times[2];
+	for (int sorted = 0; sorted < 2; ++sorted) {
+		if (sorted) {
+			sort_spatially(file.groups, &file.lines, &file.polygons);
+		}
+		TilePass pass(file, tiles_per_side);
+		double checksum = pass.run(file);
+		counter.start();
+		double start_time = ::omp_get_wtime();
+		for (int r = 0; r < repetitions; ++r) {
+			checksum += pass.run(file);
+		}
+		times[sorted] = (::omp_get_wtime() - start_time) / repetitions;
+		misses[sorted] = counter.stop();
+		benchmark_sink = checksum;
+	}
+
+	cout << "Tile pass over " << file.lines.size() << " lines:\n";
+	cout << "  document order: " << times[0] << " s";
+	if (counter.available()) {
+		cout << ", " << misses[0] / repetitions << " cache misses";
+	}
+	cout << "\n  Hilbert order:  " << times[1] << " s";
+	if (counter.available()) {
+		cout << ", " << misses[1] / repetitions << " cache misses";
+	}
+	cout << "\n";
+	if (counter.available() && misses[0] > 0) {
+		cout << "  Cache misses reduced by "
+		     << 100.0 * (misses[0] - misses[1]) / misses[0] << "%.\n";
+	}
+	else {
+		cout << "  (Cache miss counters are not available here.)\n";
+	}
+}
+
+// Culls the lines against views of a sixteenth of the image, one line at
+// a time and one chunk of indexed lines at a time. The lines are sorted
+// spatially first, or the chunks would span the whole image.
+void benchmark_indexed_lines(const std::string& filename)
+{
+	using namespace std;
+
+	SVGFile file;
+	file.options.spatial_order = true;
+	file.load(filename);
+	size_t line_bytes = file.lines.size() * sizeof(Line);
+	IndexedLines indexed;
+	double start_time = ::omp_get_wtime();
+	indexed.build(file.lines);
+	double build_time = ::omp_get_wtime() - start_time;
+
+	const int views_per_side = 4;
+	const int repetitions = 20;
+	float view_width = float(file.get_width()) / views_per_side;
+	float view_height = float(file.get_height()) / views_per_side;
+	double times[2];
+	size_t in_view[2] = {0, 0};
+	for (int with_index = 0; with_index < 2; ++with_index) {
+		start_time = ::omp_get_wtime();
+		for (int r = 0; r < repetitions; ++r) {
+			for (int v = 0; v < views_per_side * views_per_side; ++v) {
+				Rect view((v % views_per_side) * view_width,
+				          (v / views_per_side) * view_height,
+				          (v % views_per_side + 1) * view_width,
+				          (v / views_per_side + 1) * view_height);
+				if (with_index) {
+					for (auto& chunk : indexed.chunks) {
+						if (chunk.bounding_box.intersects(view)) {
+							in_view[1] += chunk.end - chunk.first;
+						}
+					}
+				}
+				else {
+					for (auto& line : file.lines) {
+						in_view[0] += line.bounding_box().intersects(view);
+					}
+				}
+			}
+		}
+		times[with_index] = (::omp_get_wtime() - start_time) / repetitions;
+	}
+	benchmark_sink = double(in_view[0] + in_view[1]);
+
+	const double megabyte = 1 << 20;
+	cout << "Indexing " << indexed.num_lines() << " lines with "
+	     << indexed.num_vertices() << " end points:\n";
+	cout << "  build time: " << build_time << " s\n";
+	cout << "  memory: " << indexed.memory_bytes() / megabyte << " MB instead of "
+	     << line_bytes / megabyte << " MB\n";
+	cout << "  culling " << views_per_side * views_per_side << " views by line:  "
+	     << times[0] << " s\n";
+	cout << "  culling " << views_per_side * views_per_side << " views by chunk: "
+	     << times[1] << " s (" << in_view[1] / repetitions << " lines drawn instead of "
+	     << in_view[0] / repetitions << ")\n";
+}
+
+// Chains the lines and compares the triangles drawn for them.
+void benchmark_line_chains(const std::string& filename)
+{
+	using namespace std;
+
+	SVGFile file;
+	file.load(filename);
+	size_t num_lines = file.lines.size();
+	TriangleBatch line_batch;
+	add_lines(file.lines, &line_batch);
+
+	Arena arena;
+	std::vector<Polyline> chains;
+	double start_time = ::omp_get_wtime();
+	chain_lines(&file.lines, &arena, &chains);
+	double chain_time = ::omp_get_wtime() - start_time;
+	TriangleBatch fills, strokes;
+	add_polylines(chains, &fills, &strokes);
+
+	cout << "Chaining " << num_lines << " lines into " << chains.size()
+	     << " polylines:\n";
+	cout << "  chain time: " << chain_time << " s\n";
+	cout << "  vertices: " << strokes.num_vertices() << " instead of "
+	     << line_batch.num_vertices() << "\n";
+}
+
+void benchmark_nested_transforms()
+{
+	using namespace std;
+
+	const char* filename = "rapidsvg_benchmark_nested.svg";
+	const int depth = 12;
+	const int lines_per_leaf = 50;
+	double times[2];
+	size_t num_lines = 0;
+	for (int with_transforms = 0; with_transforms < 2; ++with_transforms) {
+		generate_nested_groups_svg(filename, depth, lines_per_leaf,
+		                           with_transforms != 0);
+		SVGFile file;
+		double start_time = ::omp_get_wtime();
+		file.load(filename);
+		times[with_transforms] = ::omp_get_wtime() - start_time;
+		num_lines = file.lines.size();
+	}
+	std::remove(filename);
+
+	cout << "Loading " << num_lines << " lines in groups nested "
+	     << depth << " deep:\n";
+	cout << "  without transforms: " << times[0] << " s\n";
+	cout << "  with transforms:    " << times[1] << " s\n";
+}
+
+// Must run before anything else is loaded, as the peak memory of the
+// process only grows.
+void benchmark_load_memory()
+{
+	using namespace std;
+
+	const char* filename = "rapidsvg_benchmark_shapes.svg";
+	const int num_shapes = 200000;
+	const int points_per_shape = 20;
+	generate_shapes_svg(filename, num_shapes, points_per_shape);
+
+	size_t peak_before = peak_resident_bytes();
+	SVGFile file;
+	double start_time = ::omp_get_wtime();
+	file.load(filename);
+	double load_time = ::omp_get_wtime() - start_time;
+	size_t peak_growth = peak_resident_bytes() - peak_before;
+	std::remove(filename);
+
+	size_t point_bytes = 0;
+	for (auto& polygon : file.polygons) {
+		point_bytes += polygon.points.size() * sizeof(polygon.points[0]);
+	}
+	for (auto& polyline : file.polylines) {
+		point_bytes += polyline.points.size() * sizeof(polyline.points[0]);
+	}
+
+	const double megabyte = 1 << 20;
+	cout << "Loading " << num_shapes << " polygons and polylines with "
+	     << points_per_shape << " points each:\n";
+	cout << "  load time: " << load_time << " s (walk time above)\n";
+	if (peak_before > 0) {
+		cout << "  peak memory growth: " << peak_growth / megabyte << " MB for "
+		     << point_bytes / megabyte << " MB of points\n";
+	}
+	else {
+		cout << "  (Peak memory is not available here.)\n";
+	}
+}
+
+// Whether two colors agree to within rounding to bytes.
+bool same_color(float r1, float g1, float b1, float a1, float r2, float g2, float b2, float a2)
+{
+	const float tolerance = 0.5f / 255;
+	return std::abs(r1 - r2) <= tolerance && std::abs(g1 - g2) <= tolerance &&
+	       std::abs(b1 - b2) <= tolerance && std::abs(a1 - a2) <= tolerance;
+}
+
+// Writes a generated test file.
+void write_file(const char* filename, const char* contents)
+{
+	std::ofstream fout(filename);
+	if (!fout || !(fout << contents)) {
+		throw std::runtime_error("Could not write generated file.");
+	}
+}
+
+void benchmark_colors()
+{
+	using namespace std;
+
+	const char* kinds[] = {"named", "hexadecimal", "rgb()"};
+	const vector<const char*> colors[] = {
+		{"black", "steelblue", "lightgoldenrodyellow", "Red", "rebeccapurple", "tan"},
+		{"#4f4f4f", "#FF8000", "#0f0", "#ff000080", "#12ab9c", "#fff"},
+		{"rgb(255, 128, 0)", "rgb(10%,20%,30%)", "rgba(0,0,255,0.5)",
+		 "rgb(10 20 30 / 25%)", "rgb(1,2,3)", "rgba(100, 100, 100, 1)"}};
+	const int repetitions = 1000000;
+
+	cout << "Parsing colors:\n";
+	for (int k = 0; k < 3; ++k) {
+		float sum = 0;
+		double start_time = ::omp_get_wtime();
+		for (int r = 0; r < repetitions; ++r) {
+			for (auto color : colors[k]) {
+				float red, green, blue;
+				parse_color(color, &red, &green, &blue);
+				sum += red + green + blue;
+			}
+		}
+		double time = ::omp_get_wtime() - start_time;
+		benchmark_sink = sum;
+		cout << "  " << kinds[k] << ": "
+		     << repetitions * colors[k].size() / time / 1e6 << " million colors/s\n";
+	}
+
+	// Some of the colors above, with the alpha they give.
+	struct Expected
+	{
+		const char* color;
+		float r, g, b, a;
+	};
+	const Expected expected[] = {
+		{"steelblue", 70 / 255.0f, 130 / 255.0f, 180 / 255.0f, 1},
+		{"Red", 1, 0, 0, 1},
+		{"#FF8000", 1, 128 / 255.0f, 0, 1},
+		{"#0f0", 0, 1, 0, 1},
+		{"#ff000080", 1, 0, 0, 128 / 255.0f},
+		{"rgb(10%,20%,30%)", 0.1f, 0.2f, 0.3f, 1},
+		{"rgba(0,0,255,0.5)", 0, 0, 1, 0.5f},
+		{"rgb(10 20 30 / 25%)", 10 / 255.0f, 20 / 255.0f, 30 / 255.0f, 0.25f}};
+	for (auto& color : expected) {
+		float r = -1, g = -1, b = -1, a = 1;
+		if (!parse_color(color.color, &r, &g, &b, &a) ||
+		    !same_color(r, g, b, a, color.r, color.g, color.b, color.a)) {
+			throw runtime_error(string("Wrong color parsed from ") + color.color + ".");
+		}
+	}
+	float r = 0.5f, g = 0.5f, b = 0.5f;
+	if (parse_color("rgb(1, 2)", &r, &g, &b) || r != 0.5f) {
+		throw runtime_error("Invalid color was parsed.");
+	}
+	cout << "  Checked " << sizeof(expected) / sizeof(expected[0]) << " colors.\n";
+}
+
+// Style sheet rules apply by specificity and then by order, above the
+// presentation attributes and below the style attribute.
+void check_style_sheets()
+{
+	using namespace std;
+
+	const char* filename = "rapidsvg_benchmark_styles.svg";
+	write_file(filename,
+		"<svg width=\"100\" height=\"100\" xmlns=\"http://www.w3.org/2000/svg\">\n"
+		"<style>\n"
+		"  #top { fill: blue }\n"
+		"  rect.a { fill: lime }\n"
+		"  .a { fill: red; stroke: black }\n"
+		"  rect { fill: yellow }\n"
+		"  .b { fill: red }\n"
+		"  .b { fill: #808080 }\n"
+		"</style>\n"
+		"<rect class=\"a\" width=\"1\" height=\"1\" />\n"
+		"<rect class=\"a\" id=\"top\" width=\"1\" height=\"1\" />\n"
+		"<rect class=\"b\" width=\"1\" height=\"1\" />\n"
+		"<rect class=\"a\" fill=\"red\" style=\"fill: white\" width=\"1\" height=\"1\" />\n"
+		"<rect fill=\"red\" width=\"1\" height=\"1\" />\n"
+		"</svg>\n");
+	SVGFile file;
+	file.load(filename);
+	std::remove(filename);
+
+	const float gray = 128 / 255.0f;
+	const float fills[][3] = {{0, 1, 0}, {0, 0, 1}, {gray, gray, gray}, {1, 1, 1}, {1, 1, 0}};
+	const size_t num_rectangles = sizeof(fills) / sizeof(fills[0]);
+	if (file.rectangles.size() != num_rectangles) {
+		throw runtime_error("The styled rects were not loaded.");
+	}
+	for (size_t i = 0; i < num_rectangles; ++i) {
+		const ShapeStyle& style = file.rectangles[i].style;
+		if (!same_color(style.r, style.g, style.b, style.a,
+		                fills[i][0], fills[i][1], fills[i][2], 1)) {
+			throw runtime_error("Rect " + to_string(i) + " was given the wrong fill.");
+		}
+		if (style.has_stroke() != (i == 0 || i == 1 || i == 3)) {
+			throw runtime_error("Rect " + to_string(i) + " was given the wrong stroke.");
+		}
+	}
+	cout << "Applied style sheet rules by specificity and order.\n";
+}
+
+// Only the earlier copies of opaque lines and polygons are dropped.
+void check_duplicate_removal()
+{
+	using namespace std;
+
+	const char* filename = "rapidsvg_benchmark_duplicates.svg";
+	write_file(filename,
+		"<svg width=\"100\" height=\"100\" xmlns=\"http://www.w3.org/2000/svg\">\n"
+		"<line x1=\"0\" y1=\"0\" x2=\"10\" y2=\"10\" stroke=\"black\" />\n"
+		"<line x1=\"10\" y1=\"10\" x2=\"0\" y2=\"0\" stroke=\"black\" />\n"
+		"<line x1=\"0\" y1=\"0\" x2=\"10\" y2=\"10\" stroke=\"black\" />\n"
+		"<line x1=\"0\" y1=\"0\" x2=\"10\" y2=\"10\" stroke=\"red\" />\n"
+		"<line x1=\"0\" y1=\"5\" x2=\"10\" y2=\"5\" stroke=\"black\" stroke-opacity=\"0.5\" />\n"
+		"<line x1=\"0\" y1=\"5\" x2=\"10\" y2=\"5\" stroke=\"black\" stroke-opacity=\"0.5\" />\n"
+		"<polygon points=\"0,0 10,0 10,10\" fill=\"blue\" />\n"
+		"<polygon points=\"0,0 10,0 10,10\" fill=\"blue\" />\n"
+		"<polygon points=\"10,0 10,10 0,0\" fill=\"blue\" />\n"
+		"</svg>\n");
+	SVGFile file;
+	file.options.remove_duplicates = true;
+	file.load(filename);
+	std::remove(filename);
+
+	// Two of the three black lines and one of the first two polygons.
+	if (file.lines.size() != 6 - 2 || file.polygons.size() != 3 - 1) {
+		throw runtime_error("Dropped " + to_string(6 - file.lines.size()) + " lines and " +
+		                    to_string(3 - file.polygons.size()) +
+		                    " polygons as duplicates instead of 2 and 1.");
+	}
+	// The elements left keep their document order.
+	if (file.num_orders() != file.num_elements()) {
+		throw runtime_error("Dropped duplicates left gaps in the document order.");
+	}
+	cout << "Dropped duplicates of opaque lines and polygons only.\n";
+}
+
+// Loads two files with different style sheets into the same SVGFile and
+// into a new one, which must not see the rules of the files before.
+void check_consecutive_loads()
+{
+	using namespace std;
+
+	const char* first = "rapidsvg_benchmark_first.svg";
+	const char* second = "rapidsvg_benchmark_second.svg";
+	write_file(first,
+		"<svg width=\"100\" height=\"100\" xmlns=\"http://www.w3.org/2000/svg\">\n"
+		"<style> rect { fill: red } .x { stroke: red } </style>\n"
+		"<rect class=\"x\" width=\"1\" height=\"1\" />\n"
+		"</svg>\n");
+	write_file(second,
+		"<svg width=\"100\" height=\"100\" xmlns=\"http://www.w3.org/2000/svg\">\n"
+		"<style> .y { fill: blue } </style>\n"
+		"<rect class=\"y\" width=\"1\" height=\"1\" />\n"
+		"<rect class=\"x\" width=\"1\" height=\"1\" />\n"
+		"</svg>\n");
+
+	auto check_first = [](const SVGFile& file)
+	{
+		if (file.rectangles.size() != 1) {
+			throw runtime_error("The first styled file was not loaded.");
+		}
+		const ShapeStyle& style = file.rectangles[0].style;
+		if (!same_color(style.r, style.g, style.b, style.a, 1, 0, 0, 1) || !style.has_stroke()) {
+			throw runtime_error("The first styled file was loaded with the wrong styles.");
+		}
+	};
+	auto check_second = [](const SVGFile& file)
+	{
+		if (file.rectangles.size() != 2) {
+			throw runtime_error("The second styled file was not loaded.");
+		}
+		const ShapeStyle& styled = file.rectangles[0].style;
+		const ShapeStyle& unstyled = file.rectangles[1].style;
+		if (!same_color(styled.r, styled.g, styled.b, styled.a, 0, 0, 1, 1) ||
+		    !same_color(unstyled.r, unstyled.g, unstyled.b, unstyled.a, 0, 0, 0, 1) ||
+		    styled.has_stroke() || unstyled.has_stroke()) {
+			throw runtime_error("The style sheet of a file loaded before was applied.");
+		}
+	};
+
+	SVGFile file;
+	file.load(first);
+	check_first(file);
+	file.load(second);
+	check_second(file);
+	file.load(first);
+	check_first(file);
+	SVGFile other;
+	other.load(second);
+	check_second(other);
+	std::remove(first);
+	std::remove(second);
+	cout << "Loaded files with different style sheets one after the other.\n";
+}
+
+// Loads outline-only polygons strictly, which must not fail on their
+// unfilled fills.
+void check_outline_polygons()
+{
+	using namespace std;
+
+	const char* filename = "rapidsvg_benchmark_outlines.svg";
+	{
+		ofstream fout(filename);
+		if (!fout) {
+			throw runtime_error("Could not write generated file.");
+		}
+		fout << "<svg width=\"100\" height=\"100\" xmlns=\"http://www.w3.org/2000/svg\">\n"
+		     << "<polygon points=\"10,10 90,10 50,90\" style=\"fill:none;stroke:#000\" />\n"
+		     << "<polygon points=\"20,20 80,20 50,80\" style=\"fill: none; stroke:red\" />\n"
+		     << "</svg>\n";
+	}
+	SVGFile file;
+	file.load(filename);
+	std::remove(filename);
+	if (file.polygons.size() != 2) {
+		throw runtime_error("Outline-only polygons were not loaded.");
+	}
+	for (auto& polygon : file.polygons) {
+		if (polygon.a != 0 || !polygon.has_stroke()) {
+			throw runtime_error("Outline-only polygon was loaded with a fill or without a stroke.");
+		}
+	}
+	cout << "Loaded outline-only polygons strictly.\n";
+}
+
+void main_function(int argc, char** argv)
+{
+	std::string filename;
+	bool generated = argc <= 1;
+	if (generated) {
+		filename = "rapidsvg_benchmark.svg";
+		generate_graph_svg(filename, 400);
+	}
+	else {
+		filename = argv[1];
+	}
+
+	benchmark_load_memory();
+	benchmark_spatial_order(filename);
+	benchmark_indexed_lines(filename);
+	benchmark_line_chains(filename);
+	benchmark_nested_transforms();
+	benchmark_colors();
+	check_outline_polygons();
+	check_style_sheets();
+	check_duplicate_removal();
+	check_consecutive_loads();
+
+	if (generated) {
+		std::remove(filename.c_str());
+	}
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	try {
+		rapidsvg::main_function(argc, argv);
+	}
+	catch (std::exception& e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+}
@@ -0,0 +1,54 @@
+// Petter Strandmark 2013.
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "block_pool.h"
+
+namespace rapidsvg {
+
+namespace
+{
+	// Every block starts with its size, padded to keep the alignment.
+	const std::size_t block_header_size = 16;
+
+	std::mutex pool_mutex;
+	// Freed blocks by size.
+	std::map<std::size_t, std::vector<char*> > free_blocks;
+	std::size_t reused_blocks = 0;
+}
+
+void* block_pool_allocate(std::size_t size)
+{
+	{
+		std::lock_guard<std::mutex> lock(pool_mutex);
+		auto blocks = free_blocks.find(size);
+		if (blocks != free_blocks.end() && !blocks->second.empty()) {
+			char* block = blocks->second.back();
+			blocks->second.pop_back();
+			reused_blocks++;
+			return block + block_header_size;
+		}
+	}
+
+	char* block = new char[block_header_size + size];
+	*reinterpret_cast<std::size_t*>(block) = size;
+	return block + block_header_size;
+}
+
+void block_pool_free(void* memory)
+{
+	char* block = static_cast<char*>(memory) - block_header_size;
+	std::size_t size = *reinterpret_cast<std::size_t*>(block);
+	std::lock_guard<std::mutex> lock(pool_mutex);
+	free_blocks[size].push_back(block);
+}
+
+std::size_t block_pool_reused_blocks()
+{
+	std::lock_guard<std::mutex> lock(pool_mutex);
+	return reused_blocks;
+}
+
+}
@@ -0,0 +1,22 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_BLOCK_POOL_H
+#define RAPIDSVG_BLOCK_POOL_H
+
+#include <cstddef>
+
+namespace rapidsvg {
+
+// Allocation functions for rapidxml memory pools. Freed blocks are kept
+// and handed out again for requests of the same size, so that parsing a
+// file again does not allocate. The blocks kept are at most those used by
+// the largest parse so far.
+void* block_pool_allocate(std::size_t size);
+void block_pool_free(void* block);
+
+// Number of blocks handed out again instead of being allocated.
+std::size_t block_pool_reused_blocks();
+
+}
+
+#endif
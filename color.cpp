@@ -0,0 +1,407 @@
+// Petter Strandmark 2013.
+
+#include <cstdint>
+#include <cstring>
+
+#include "color.h"
+#include "number_parser.h"
+
+namespace rapidsvg {
+
+namespace
+{
+	// Values of the hexadecimal digits by character, and -1 for other
+	// characters.
+	const std::int8_t hex_values[256] = {
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+	-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+	};
+
+	struct NamedColor
+	{
+		const char* name;
+		std::uint8_t r, g, b;
+	};
+
+	// The named colors of CSS.
+	const NamedColor named_colors[] = {
+	{"aliceblue", 0xf0, 0xf8, 0xff},
+	{"antiquewhite", 0xfa, 0xeb, 0xd7},
+	{"aqua", 0x00, 0xff, 0xff},
+	{"aquamarine", 0x7f, 0xff, 0xd4},
+	{"azure", 0xf0, 0xff, 0xff},
+	{"beige", 0xf5, 0xf5, 0xdc},
+	{"bisque", 0xff, 0xe4, 0xc4},
+	{"black", 0x00, 0x00, 0x00},
+	{"blanchedalmond", 0xff, 0xeb, 0xcd},
+	{"blue", 0x00, 0x00, 0xff},
+	{"blueviolet", 0x8a, 0x2b, 0xe2},
+	{"brown", 0xa5, 0x2a, 0x2a},
+	{"burlywood", 0xde, 0xb8, 0x87},
+	{"cadetblue", 0x5f, 0x9e, 0xa0},
+	{"chartreuse", 0x7f, 0xff, 0x00},
+	{"chocolate", 0xd2, 0x69, 0x1e},
+	{"coral", 0xff, 0x7f, 0x50},
+	{"cornflowerblue", 0x64, 0x95, 0xed},
+	{"cornsilk", 0xff, 0xf8, 0xdc},
+	{"crimson", 0xdc, 0x14, 0x3c},
+	{"cyan", 0x00, 0xff, 0xff},
+	{"darkblue", 0x00, 0x00, 0x8b},
+	{"darkcyan", 0x00, 0x8b, 0x8b},
+	{"darkgoldenrod", 0xb8, 0x86, 0x0b},
+	{"darkgray", 0xa9, 0xa9, 0xa9},
+	{"darkgreen", 0x00, 0x64, 0x00},
+	{"darkgrey", 0xa9, 0xa9, 0xa9},
+	{"darkkhaki", 0xbd, 0xb7, 0x6b},
+	{"darkmagenta", 0x8b, 0x00, 0x8b},
+	{"darkolivegreen", 0x55, 0x6b, 0x2f},
+	{"darkorange", 0xff, 0x8c, 0x00},
+	{"darkorchid", 0x99, 0x32, 0xcc},
+	{"darkred", 0x8b, 0x00, 0x00},
+	{"darksalmon", 0xe9, 0x96, 0x7a},
+	{"darkseagreen", 0x8f, 0xbc, 0x8f},
+	{"darkslateblue", 0x48, 0x3d, 0x8b},
+	{"darkslategray", 0x2f, 0x4f, 0x4f},
+	{"darkslategrey", 0x2f, 0x4f, 0x4f},
+	{"darkturquoise", 0x00, 0xce, 0xd1},
+	{"darkviolet", 0x94, 0x00, 0xd3},
+	{"deeppink", 0xff, 0x14, 0x93},
+	{"deepskyblue", 0x00, 0xbf, 0xff},
+	{"dimgray", 0x69, 0x69, 0x69},
+	{"dimgrey", 0x69, 0x69, 0x69},
+	{"dodgerblue", 0x1e, 0x90, 0xff},
+	{"firebrick", 0xb2, 0x22, 0x22},
+	{"floralwhite", 0xff, 0xfa, 0xf0},
+	{"forestgreen", 0x22, 0x8b, 0x22},
+	{"fuchsia", 0xff, 0x00, 0xff},
+	{"gainsboro", 0xdc, 0xdc, 0xdc},
+	{"ghostwhite", 0xf8, 0xf8, 0xff},
+	{"gold", 0xff, 0xd7, 0x00},
+	{"goldenrod", 0xda, 0xa5, 0x20},
+	{"gray", 0x80, 0x80, 0x80},
+	{"green", 0x00, 0x80, 0x00},
+	{"greenyellow", 0xad, 0xff, 0x2f},
+	{"grey", 0x80, 0x80, 0x80},
+	{"honeydew", 0xf0, 0xff, 0xf0},
+	{"hotpink", 0xff, 0x69, 0xb4},
+	{"indianred", 0xcd, 0x5c, 0x5c},
+	{"indigo", 0x4b, 0x00, 0x82},
+	{"ivory", 0xff, 0xff, 0xf0},
+	{"khaki", 0xf0, 0xe6, 0x8c},
+	{"lavender", 0xe6, 0xe6, 0xfa},
+	{"lavenderblush", 0xff, 0xf0, 0xf5},
+	{"lawngreen", 0x7c, 0xfc, 0x00},
+	{"lemonchiffon", 0xff, 0xfa, 0xcd},
+	{"lightblue", 0xad, 0xd8, 0xe6},
+	{"lightcoral", 0xf0, 0x80, 0x80},
+	{"lightcyan", 0xe0, 0xff, 0xff},
+	{"lightgoldenrodyellow", 0xfa, 0xfa, 0xd2},
+	{"lightgray", 0xd3, 0xd3, 0xd3},
+	{"lightgreen", 0x90, 0xee, 0x90},
+	{"lightgrey", 0xd3, 0xd3, 0xd3},
+	{"lightpink", 0xff, 0xb6, 0xc1},
+	{"lightsalmon", 0xff, 0xa0, 0x7a},
+	{"lightseagreen", 0x20, 0xb2, 0xaa},
+	{"lightskyblue", 0x87, 0xce, 0xfa},
+	{"lightslategray", 0x77, 0x88, 0x99},
+	{"lightslategrey", 0x77, 0x88, 0x99},
+	{"lightsteelblue", 0xb0, 0xc4, 0xde},
+	{"lightyellow", 0xff, 0xff, 0xe0},
+	{"lime", 0x00, 0xff, 0x00},
+	{"limegreen", 0x32, 0xcd, 0x32},
+	{"linen", 0xfa, 0xf0, 0xe6},
+	{"magenta", 0xff, 0x00, 0xff},
+	{"maroon", 0x80, 0x00, 0x00},
+	{"mediumaquamarine", 0x66, 0xcd, 0xaa},
+	{"mediumblue", 0x00, 0x00, 0xcd},
+	{"mediumorchid", 0xba, 0x55, 0xd3},
+	{"mediumpurple", 0x93, 0x70, 0xdb},
+	{"mediumseagreen", 0x3c, 0xb3, 0x71},
+	{"mediumslateblue", 0x7b, 0x68, 0xee},
+	{"mediumspringgreen", 0x00, 0xfa, 0x9a},
+	{"mediumturquoise", 0x48, 0xd1, 0xcc},
+	{"mediumvioletred", 0xc7, 0x15, 0x85},
+	{"midnightblue", 0x19, 0x19, 0x70},
+	{"mintcream", 0xf5, 0xff, 0xfa},
+	{"mistyrose", 0xff, 0xe4, 0xe1},
+	{"moccasin", 0xff, 0xe4, 0xb5},
+	{"navajowhite", 0xff, 0xde, 0xad},
+	{"navy", 0x00, 0x00, 0x80},
+	{"oldlace", 0xfd, 0xf5, 0xe6},
+	{"olive", 0x80, 0x80, 0x00},
+	{"olivedrab", 0x6b, 0x8e, 0x23},
+	{"orange", 0xff, 0xa5, 0x00},
+	{"orangered", 0xff, 0x45, 0x00},
+	{"orchid", 0xda, 0x70, 0xd6},
+	{"palegoldenrod", 0xee, 0xe8, 0xaa},
+	{"palegreen", 0x98, 0xfb, 0x98},
+	{"paleturquoise", 0xaf, 0xee, 0xee},
+	{"palevioletred", 0xdb, 0x70, 0x93},
+	{"papayawhip", 0xff, 0xef, 0xd5},
+	{"peachpuff", 0xff, 0xda, 0xb9},
+	{"peru", 0xcd, 0x85, 0x3f},
+	{"pink", 0xff, 0xc0, 0xcb},
+	{"plum", 0xdd, 0xa0, 0xdd},
+	{"powderblue", 0xb0, 0xe0, 0xe6},
+	{"purple", 0x80, 0x00, 0x80},
+	{"rebeccapurple", 0x66, 0x33, 0x99},
+	{"red", 0xff, 0x00, 0x00},
+	{"rosybrown", 0xbc, 0x8f, 0x8f},
+	{"royalblue", 0x41, 0x69, 0xe1},
+	{"saddlebrown", 0x8b, 0x45, 0x13},
+	{"salmon", 0xfa, 0x80, 0x72},
+	{"sandybrown", 0xf4, 0xa4, 0x60},
+	{"seagreen", 0x2e, 0x8b, 0x57},
+	{"seashell", 0xff, 0xf5, 0xee},
+	{"sienna", 0xa0, 0x52, 0x2d},
+	{"silver", 0xc0, 0xc0, 0xc0},
+	{"skyblue", 0x87, 0xce, 0xeb},
+	{"slateblue", 0x6a, 0x5a, 0xcd},
+	{"slategray", 0x70, 0x80, 0x90},
+	{"slategrey", 0x70, 0x80, 0x90},
+	{"snow", 0xff, 0xfa, 0xfa},
+	{"springgreen", 0x00, 0xff, 0x7f},
+	{"steelblue", 0x46, 0x82, 0xb4},
+	{"tan", 0xd2, 0xb4, 0x8c},
+	{"teal", 0x00, 0x80, 0x80},
+	{"thistle", 0xd8, 0xbf, 0xd8},
+	{"tomato", 0xff, 0x63, 0x47},
+	{"turquoise", 0x40, 0xe0, 0xd0},
+	{"violet", 0xee, 0x82, 0xee},
+	{"wheat", 0xf5, 0xde, 0xb3},
+	{"white", 0xff, 0xff, 0xff},
+	{"whitesmoke", 0xf5, 0xf5, 0xf5},
+	{"yellow", 0xff, 0xff, 0x00},
+	{"yellowgreen", 0x9a, 0xcd, 0x32}
+	};
+
+	// Perfect hash of the names above: the name is hashed once to find
+	// its bucket and then again with the displacement of the bucket to
+	// find its slot. No two names share a slot. The tables were found by
+	// trying displacements for the buckets, largest bucket first.
+	const int num_buckets = 64;
+	const int num_slots = 256;
+	const std::uint8_t bucket_displacements[num_buckets] = {
+	  0,   0,   0,   6,   1,   2,   1,   0,   2,   1,   2,   0,   2,   1,   2,   2,
+	  4,   1,   3,   2,   2,   3,   1,   2,   4,   2,   1,   0,   2,   1,   1,   3,
+	  3,   0,   1,   0,   4,   0,   1,   2,   1,   2,   1,   1,   1,   5,   1,   1,
+	  5,   3,   5,   3,   8,   1,   1,   3,   0,   5,   1,   1,   1,   5,   1,  14
+	};
+	// Index in named_colors of the name in every slot, or 255.
+	const std::uint8_t slot_colors[num_slots] = {
+	 90,   3, 255,  26, 145,  70,  68, 255,  84,  94,  52,  16, 255,  48, 139, 255,
+	 34, 255, 255,  80,  21, 255,  32, 255,  10, 118, 255,  75, 143,  82, 111, 255,
+	255,  66,  62, 255, 255, 255, 255, 255, 132,  38, 255,  55,  33,  43, 255,  15,
+	255, 121, 255, 255, 255,  45, 104,  44, 255, 123, 103, 255, 255, 255,  87, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 130,  77,  59, 108, 255, 255,  91,   6,
+	255, 144, 255,  63, 255, 141, 116, 125,  50, 255, 255, 133, 138, 255,  69,  56,
+	 81, 255, 147, 142, 110, 255, 255, 119, 101, 135, 255,  53, 115, 255, 255, 255,
+	255,  61, 255, 255,  88, 255,  17, 127, 255,  99,   8,  85, 255, 255, 255, 255,
+	 40, 131,   5,  31,  58,  51, 109, 255,   9, 255, 255, 255,  29, 255,  74,  22,
+	 11,   4,  98, 255,  36, 106, 255,  39,  49, 255,  60,  25, 255, 255, 255, 255,
+	  7,  19, 113, 122, 126,  93, 136, 112, 255,  13, 255,  18,  97,  92, 120,  12,
+	 89, 100,  30, 255,  96, 255,  64, 255, 255,  78, 255, 255, 255, 255, 105,  28,
+	255, 255, 255,  37, 146, 255, 255, 255, 255,   1, 102, 255,  14,  35, 255, 255,
+	 79, 255, 255,  20,  57, 114,  27,  71, 124, 255, 255,  95,  46, 255, 255, 255,
+	 76, 140, 255,  41, 255, 117, 255, 255, 255,  65, 255, 134, 137,   0, 128,  54,
+	255,  42,  73, 129,  67,  47,  23,  24, 255,  83, 255,  72,  86, 255,   2, 107
+	};
+
+	// 32-bit FNV-1a of a name in lower case.
+	std::uint32_t hash_name(const char* name, size_t length, std::uint32_t seed)
+	{
+		std::uint32_t hash = 2166136261u ^ seed;
+		for (size_t i = 0; i < length; ++i) {
+			hash ^= std::uint8_t(name[i] | 0x20);
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	bool equal_lower_case(const char* name, size_t length, const char* lower_case)
+	{
+		for (size_t i = 0; i < length; ++i) {
+			if ((name[i] | 0x20) != lower_case[i]) {
+				return false;
+			}
+		}
+		return lower_case[length] == '\0';
+	}
+
+	// Returns the named color with the given name, ignoring case, or null.
+	const NamedColor* find_named_color(const char* name, size_t length)
+	{
+		// Only letters can be part of a name; this also makes the case
+		// folding in hash_name safe.
+		for (size_t i = 0; i < length; ++i) {
+			char c = name[i] | 0x20;
+			if (c < 'a' || c > 'z') {
+				return 0;
+			}
+		}
+		std::uint32_t bucket = hash_name(name, length, 0) % num_buckets;
+		std::uint32_t slot = hash_name(name, length, bucket_displacements[bucket]) %
+		                     num_slots;
+		if (slot_colors[slot] == 255) {
+			return 0;
+		}
+		const NamedColor* color = &named_colors[slot_colors[slot]];
+		return equal_lower_case(name, length, color->name) ? color : 0;
+	}
+
+	// Decodes num_digits hexadecimal digits to
+	// num_digits / digits_per_component components in [0, 255]. With one digit per component, the digit is
+	// repeated, as in #rgb. All digits are looked up before a single check.
+	bool decode_hex(const char* digits, int num_digits, int digits_per_component,
+	                int* components)
+	{
+		int values[8];
+		int invalid = 0;
+		for (int i = 0; i < num_digits; ++i) {
+			values[i] = hex_values[std::uint8_t(digits[i])];
+			invalid |= values[i];
+		}
+		if (invalid < 0) {
+			return false;
+		}
+		for (int i = 0; i < num_digits / digits_per_component; ++i) {
+			components[i] = digits_per_component == 2 ?
+			                16 * values[2 * i] + values[2 * i + 1] :
+			                17 * values[i];
+		}
+		return true;
+	}
+
+	// Parses the arguments of rgb() or rgba() after the opening
+	// parenthesis: three numbers in [0, 255] or percentages and an
+	// optional alpha in [0, 1] or a percentage, separated by commas or
+	// spaces and, before the alpha, a slash.
+	bool parse_rgb_arguments(const char* ptr, const char* end, float* components,
+	                         int* num_components)
+	{
+		*num_components = 0;
+		while (true) {
+			ptr = skip_separators(ptr);
+			if (*num_components == 3 && *ptr == '/') {
+				ptr = skip_separators(ptr + 1);
+			}
+			if (*ptr == ')') {
+				break;
+			}
+			float value;
+			if (*num_components == 4 || !parse_number(&ptr, &value)) {
+				return false;
+			}
+			bool is_alpha = *num_components == 3;
+			if (*ptr == '%') {
+				value *= is_alpha ? 0.01f : 2.55f;
+				ptr++;
+			}
+			float max_value = is_alpha ? 1.0f : 255.0f;
+			value = value < 0 ? 0 : value;
+			components[(*num_components)++] = value > max_value ? max_value : value;
+		}
+		return *num_components >= 3 && ptr + 1 == end;
+	}
+}
+
+bool parse_color(const char* color, float* r, float* g, float* b, float* a)
+{
+	while (*color == ' ' || *color == '\t') {
+		color++;
+	}
+	size_t length = std::strlen(color);
+	while (length > 0 && (color[length - 1] == ' ' || color[length - 1] == '\t')) {
+		length--;
+	}
+
+	float components[4] = {0, 0, 0, 255};
+	if (color[0] == '#') {
+		int values[4] = {0, 0, 0, 255};
+		if (length == 5 && color[1] == ' ') {
+			// Seen in some files; drawn black.
+		}
+		else if (length == 7 || length == 9) {
+			if (!decode_hex(color + 1, int(length) - 1, 2, values)) {
+				return false;
+			}
+		}
+		else if (length == 4 || length == 5) {
+			if (!decode_hex(color + 1, int(length) - 1, 1, values)) {
+				return false;
+			}
+		}
+		else {
+			return false;
+		}
+		for (int i = 0; i < 4; ++i) {
+			components[i] = float(values[i]);
+		}
+	}
+	else if (length > 4 && (std::strncmp(color, "rgb(", 4) == 0 ||
+	                        std::strncmp(color, "rgba(", 5) == 0)) {
+		const char* arguments = color + (color[3] == '(' ? 4 : 5);
+		int num_components;
+		if (!parse_rgb_arguments(arguments, color + length, components,
+		                         &num_components)) {
+			return false;
+		}
+		if (num_components == 4) {
+			components[3] *= 255;
+		}
+	}
+	else if (length == 11 && equal_lower_case(color, length, "transparent")) {
+		components[3] = 0;
+	}
+	else {
+		const NamedColor* named = find_named_color(color, length);
+		if (!named) {
+			return false;
+		}
+		components[0] = named->r;
+		components[1] = named->g;
+		components[2] = named->b;
+	}
+
+	*r = components[0] / 255.0f;
+	*g = components[1] / 255.0f;
+	*b = components[2] / 255.0f;
+	if (a) {
+		*a = components[3] / 255.0f;
+	}
+	return true;
+}
+
+bool parse_opacity(const char* value, float* opacity)
+{
+	const char* ptr = skip_separators(value);
+	float number;
+	if (!parse_number(&ptr, &number)) {
+		return false;
+	}
+	if (*ptr == '%') {
+		number /= 100;
+		ptr++;
+	}
+	if (*skip_separators(ptr) != '\0') {
+		return false;
+	}
+	*opacity = number < 0 ? 0 : number > 1 ? 1 : number;
+	return true;
+}
+
+}
@@ -0,0 +1,21 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_COLOR_H
+#define RAPIDSVG_COLOR_H
+
+namespace rapidsvg {
+
+// Parses a CSS color: one of the named colors, "transparent", #rgb,
+// #rgba, #rrggbb, #rrggbbaa, rgb(r, g, b) or rgba(r, g, b, a), where the
+// components may also be percentages. The components are stored in
+// [0, 1], the alpha only if a is given. Returns false, leaving the color
+// unchanged, if the color is invalid.
+bool parse_color(const char* color, float* r, float* g, float* b, float* a = 0);
+
+// Parses an opacity, a number or a percentage, clamped to [0, 1]. Returns
+// false, leaving the opacity unchanged, if it is invalid.
+bool parse_opacity(const char* value, float* opacity);
+
+}
+
+#endif
@@ -0,0 +1,212 @@
+// Petter Strandmark 2013.
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+#ifdef USE_OPENMP
+	#include <omp.h>
+#else
+	#include <ctime>
+	namespace
+	{
+		double omp_get_wtime()
+		{
+			return std::time(0);
+		}
+	}
+#endif
+
+#include "duplicates.h"
+
+namespace rapidsvg {
+
+namespace
+{
+	// The elements are split by the top bits of their hashes into this
+	// many buckets, which are searched for duplicates in parallel.
+	const int num_buckets = 64;
+
+	std::uint64_t mix(std::uint64_t key)
+	{
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdull;
+		key ^= key >> 33;
+		key *= 0xc4ceb9fe1a85ec53ull;
+		key ^= key >> 33;
+		return key;
+	}
+
+	// Adds the values to the hash. Adding 0 turns -0 into 0, which
+	// compares equal to it.
+	std::uint64_t hash_floats(std::uint64_t hash, const float* values, size_t n)
+	{
+		for (size_t i = 0; i < n; ++i) {
+			float value = values[i] + 0.0f;
+			std::uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			hash = mix(hash ^ bits);
+		}
+		return hash;
+	}
+
+	std::uint64_t element_hash(const Line& line)
+	{
+		// The end points in a fixed order, so that reversed lines hash
+		// the same.
+		bool swap = std::make_pair(line.x2, line.y2) < std::make_pair(line.x1, line.y1);
+		float values[9] = {swap ? line.x2 : line.x1, swap ? line.y2 : line.y1,
+		                   swap ? line.x1 : line.x2, swap ? line.y1 : line.y2,
+		                   line.width, line.r, line.g, line.b, line.a};
+		return hash_floats(0, values, 9);
+	}
+
+	std::uint64_t element_hash(const Polygon& polygon)
+	{
+		float style[9] = {polygon.r, polygon.g, polygon.b, polygon.a,
+		                  polygon.stroke_r, polygon.stroke_g, polygon.stroke_b,
+		                  polygon.stroke_a, polygon.stroke_width};
+		std::uint64_t hash = hash_floats(polygon.stroked, style, polygon.stroked ? 9 : 4);
+		if (!polygon.points.empty()) {
+			hash = hash_floats(hash, &polygon.points[0].first, 2 * polygon.points.size());
+		}
+		return hash;
+	}
+
+	bool same_element(const Line& a, const Line& b)
+	{
+		if (a.width != b.width || a.r != b.r || a.g != b.g || a.b != b.b || a.a != b.a) {
+			return false;
+		}
+		return (a.x1 == b.x1 && a.y1 == b.y1 && a.x2 == b.x2 && a.y2 == b.y2) ||
+		       (a.x1 == b.x2 && a.y1 == b.y2 && a.x2 == b.x1 && a.y2 == b.y1);
+	}
+
+	bool same_element(const Polygon& a, const Polygon& b)
+	{
+		if (a.r != b.r || a.g != b.g || a.b != b.b || a.a != b.a ||
+		    a.stroked != b.stroked || a.points != b.points) {
+			return false;
+		}
+		return !a.stroked ||
+		       (a.stroke_r == b.stroke_r && a.stroke_g == b.stroke_g &&
+		        a.stroke_b == b.stroke_b && a.stroke_a == b.stroke_a &&
+		        a.stroke_width == b.stroke_width);
+	}
+
+	bool translucent(float alpha)
+	{
+		return alpha > 0 && alpha < 1;
+	}
+
+	bool is_opaque(const Line& line)
+	{
+		return !translucent(line.a);
+	}
+
+	bool is_opaque(const Polygon& polygon)
+	{
+		return !translucent(polygon.a) &&
+		       !(polygon.stroked && translucent(polygon.stroke_a));
+	}
+
+	// Removes the duplicates of the elements and updates the ranges of
+	// the groups for the given type. Returns the number removed.
+	template<typename Element>
+	size_t remove_duplicates_of(std::vector<Element>* elements,
+	                            std::vector<Group>* groups, ElementType type)
+	{
+		int n = int(elements->size());
+		std::vector<std::uint64_t> hashes(n);
+		#pragma omp parallel for
+		for (int i = 0; i < n; ++i) {
+			hashes[i] = element_hash((*elements)[i]);
+		}
+
+		// The opaque elements of every bucket, last first.
+		std::vector<int> bucket_starts(num_buckets + 1, 0);
+		for (int i = 0; i < n; ++i) {
+			bucket_starts[(hashes[i] >> 58) + 1]++;
+		}
+		for (int b = 0; b < num_buckets; ++b) {
+			bucket_starts[b + 1] += bucket_starts[b];
+		}
+		std::vector<int> bucket_elements(n);
+		std::vector<int> fill(bucket_starts.begin(), bucket_starts.end() - 1);
+		for (int i = n - 1; i >= 0; --i) {
+			bucket_elements[fill[hashes[i] >> 58]++] = i;
+		}
+
+		// An element is removed if an equal one follows it.
+		std::vector<char> removed(n, 0);
+		#pragma omp parallel for schedule(dynamic)
+		for (int b = 0; b < num_buckets; ++b) {
+			int count = bucket_starts[b + 1] - bucket_starts[b];
+			size_t capacity = 16;
+			while (capacity < 2 * size_t(count)) {
+				capacity *= 2;
+			}
+			// Indices of the elements seen, plus one; zero is empty.
+			std::vector<int> table(capacity, 0);
+			for (int k = bucket_starts[b]; k < bucket_starts[b + 1]; ++k) {
+				int i = bucket_elements[k];
+				const Element& element = (*elements)[i];
+				if (!is_opaque(element)) {
+					continue;
+				}
+				for (size_t slot = hashes[i] & (capacity - 1); ;
+				     slot = (slot + 1) & (capacity - 1)) {
+					if (table[slot] == 0) {
+						table[slot] = i + 1;
+						break;
+					}
+					int j = table[slot] - 1;
+					if (hashes[j] == hashes[i] && same_element((*elements)[j], element)) {
+						removed[i] = 1;
+						break;
+					}
+				}
+			}
+		}
+
+		// New index of every element, or of the next one kept.
+		std::vector<size_t> new_index(n + 1);
+		size_t num_kept = 0;
+		for (int i = 0; i < n; ++i) {
+			new_index[i] = num_kept;
+			if (!removed[i]) {
+				if (num_kept != size_t(i)) {
+					(*elements)[num_kept] = std::move((*elements)[i]);
+				}
+				num_kept++;
+			}
+		}
+		new_index[n] = num_kept;
+		elements->resize(num_kept);
+
+		for (auto& group : *groups) {
+			group.first[type] = new_index[group.first[type]];
+			group.end[type] = new_index[group.end[type]];
+		}
+		return n - num_kept;
+	}
+}
+
+void remove_duplicates(std::vector<Group>* groups,
+                       std::vector<Line>* lines,
+                       std::vector<Polygon>* polygons)
+{
+	double start_time = ::omp_get_wtime();
+	size_t num_lines = lines->size();
+	size_t num_polygons = polygons->size();
+	size_t removed_lines = remove_duplicates_of(lines, groups, LineElement);
+	size_t removed_polygons = remove_duplicates_of(polygons, groups, PolygonElement);
+	double end_time = ::omp_get_wtime();
+	std::cerr << "Removed " << removed_lines << " of " << num_lines
+	          << " lines and " << removed_polygons << " of " << num_polygons
+	          << " polygons as duplicates in " << end_time - start_time
+	          << " seconds.\n";
+}
+
+}
@@ -0,0 +1,28 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_DUPLICATES_H
+#define RAPIDSVG_DUPLICATES_H
+
+#include <vector>
+
+#include "group.h"
+#include "line.h"
+#include "polygon.h"
+
+namespace rapidsvg {
+
+// Removes lines and polygons that are drawn again later with the same
+// geometry and style. Lines are the same if their end points are, in
+// either order, and polygons if their points are, in the same order.
+//
+// Only opaque elements are removed, and only the earlier copies, since
+// the last copy covers them and whatever was drawn between them either
+// way. Translucent copies darken what they cover every time they are
+// drawn, so they are kept. The ranges of the groups are updated.
+void remove_duplicates(std::vector<Group>* groups,
+                       std::vector<Line>* lines,
+                       std::vector<Polygon>* polygons);
+
+}
+
+#endif
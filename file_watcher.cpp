@@ -0,0 +1,100 @@
+// Petter Strandmark 2013.
+
+#include <stdexcept>
+
+#include <sys/stat.h>
+
+#ifdef __linux__
+	#include <sys/inotify.h>
+	#include <unistd.h>
+#endif
+
+#include "file_watcher.h"
+
+namespace rapidsvg {
+
+namespace
+{
+	long long file_size(const std::string& filename)
+	{
+		struct stat info;
+		if (stat(filename.c_str(), &info) != 0) {
+			return -1;
+		}
+		return info.st_size;
+	}
+}
+
+FileWatcher::FileWatcher(const std::string& filename_in) :
+	filename(filename_in),
+	inotify_fd(-1),
+	watch_descriptor(-1),
+	last_size(file_size(filename_in))
+{
+	#ifdef __linux__
+		inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (inotify_fd < 0) {
+			throw std::runtime_error("Could not initialize inotify.");
+		}
+		add_watch();
+	#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+	#ifdef __linux__
+		if (inotify_fd >= 0) {
+			close(inotify_fd);
+		}
+	#endif
+}
+
+void FileWatcher::add_watch()
+{
+	#ifdef __linux__
+		// The file may be replaced by its writer, in which case the
+		// watch has to be added again for the new inode.
+		watch_descriptor = inotify_add_watch(inotify_fd, filename.c_str(),
+			IN_MODIFY | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF);
+	#endif
+}
+
+bool FileWatcher::changed()
+{
+	#ifdef __linux__
+		if (watch_descriptor < 0) {
+			add_watch();
+			return watch_descriptor >= 0;
+		}
+
+		// Drain all pending events.
+		bool has_changed = false;
+		char buffer[4096];
+		while (true) {
+			ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+			if (length <= 0) {
+				break;
+			}
+			for (char* ptr = buffer; ptr < buffer + length; ) {
+				auto event = reinterpret_cast<inotify_event*>(ptr);
+				has_changed = true;
+				if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+					inotify_rm_watch(inotify_fd, watch_descriptor);
+					watch_descriptor = -1;
+				}
+				ptr += sizeof(inotify_event) + event->len;
+			}
+		}
+		if (watch_descriptor < 0) {
+			add_watch();
+		}
+		return has_changed;
+	#else
+		long long size = file_size(filename);
+		bool has_changed = size != last_size;
+		last_size = size;
+		return has_changed;
+	#endif
+}
+
+}
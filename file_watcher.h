@@ -0,0 +1,36 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_FILE_WATCHER_H
+#define RAPIDSVG_FILE_WATCHER_H
+
+#include <string>
+
+namespace rapidsvg {
+
+// Watches a file for modifications. Uses inotify on Linux and falls
+// back to polling the file size elsewhere.
+class FileWatcher
+{
+public:
+	FileWatcher(const std::string& filename);
+	~FileWatcher();
+
+	// Returns true if the file has changed since the last call.
+	// Never blocks.
+	bool changed();
+
+private:
+	FileWatcher(const FileWatcher&);
+	FileWatcher& operator=(const FileWatcher&);
+
+	void add_watch();
+
+	std::string filename;
+	int inotify_fd;
+	int watch_descriptor;
+	long long last_size;
+};
+
+}
+
+#endif
@@ -0,0 +1,50 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_GROUP_H
+#define RAPIDSVG_GROUP_H
+
+#include <cstddef>
+
+#include "transform.h"
+
+namespace rapidsvg {
+
+// Kinds of elements stored by SVGFile, each in a vector of its own.
+enum ElementType
+{
+	LineElement,
+	PolygonElement,
+	PathElement,
+	PolylineElement,
+	RectangleElement,
+	EllipseElement,
+	NumElementTypes
+};
+
+// Represents a <g> element in the SVG file. Since elements are stored in
+// document order, the elements of a group and its nested groups of every
+// type t are the contiguous range [first[t], end[t]).
+class Group
+{
+public:
+	Group() : parent(-1), depth(0)
+	{
+		for (int t = 0; t < NumElementTypes; ++t) {
+			first[t] = 0;
+			end[t] = 0;
+		}
+	}
+	// Index of the enclosing group, or -1 for top-level groups.
+	int parent;
+	// Number of enclosing groups.
+	int depth;
+	std::size_t first[NumElementTypes];
+	std::size_t end[NumElementTypes];
+	// Accumulated transform of the group, already applied to the
+	// coordinates of its elements.
+	Transform transform;
+};
+
+}
+
+#endif
@@ -0,0 +1,80 @@
+// Petter Strandmark 2013.
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <stdexcept>
+
+#include "image_export.h"
+#include "png_writer.h"
+#include "raster.h"
+#include "svg_file.h"
+
+namespace rapidsvg {
+
+namespace
+{
+	// Strips have as many rows as fit in about this many bytes.
+	const size_t strip_bytes = 16 << 20;
+	// Curves are flattened to within this fraction of a pixel.
+	const double pixel_tolerance = 0.25;
+}
+
+int export_image(const SVGFile& file, const std::string& filename, int width)
+{
+	using namespace std;
+
+	const double svg_width = file.get_width();
+	const double svg_height = file.get_height();
+	if (width <= 0 || !(svg_width > 0) || !(svg_height > 0)) {
+		throw runtime_error("Can not export an empty image.");
+	}
+	const double units_per_pixel = svg_width / width;
+	const int height = max(1, int(std::round(svg_height / units_per_pixel)));
+	const int strip_height = int(max(size_t(1), strip_bytes / (4 * size_t(width))));
+	const int num_strips = (height + strip_height - 1) / strip_height;
+
+	SceneRaster scene(file, float(pixel_tolerance * units_per_pixel));
+	PngWriter writer(filename, width, height);
+
+	// The strips are written in order; a thread that has rendered a strip
+	// waits for the strips above it before taking the next one.
+	exception_ptr error;
+	#pragma omp parallel for ordered schedule(dynamic)
+	for (int s = 0; s < num_strips; ++s) {
+		int first_row = s * strip_height;
+		int num_rows = min(strip_height, height - first_row);
+		Image strip;
+		exception_ptr strip_error;
+		try {
+			strip.clear(width, num_rows);
+			Rect region(0.0f, float(first_row * units_per_pixel),
+			            float(svg_width), float((first_row + num_rows) * units_per_pixel));
+			scene.render(region, &strip);
+		}
+		catch (...) {
+			strip_error = current_exception();
+		}
+		#pragma omp ordered
+		{
+			if (!error) {
+				try {
+					if (strip_error) {
+						rethrow_exception(strip_error);
+					}
+					writer.write_rows(&strip.pixels[0], num_rows);
+				}
+				catch (...) {
+					error = current_exception();
+				}
+			}
+		}
+	}
+	if (error) {
+		rethrow_exception(error);
+	}
+	writer.close();
+	return height;
+}
+
+}
@@ -0,0 +1,21 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_IMAGE_EXPORT_H
+#define RAPIDSVG_IMAGE_EXPORT_H
+
+#include <string>
+
+namespace rapidsvg {
+
+class SVGFile;
+
+// Renders the whole file into a PNG image width pixels wide, with the
+// height following the aspect of the SVG. The image is rendered in
+// horizontal strips in parallel, and every strip is written as soon as
+// the strips above it are, so memory use grows with the width and the
+// number of threads but not with the height. Returns the height.
+int export_image(const SVGFile& file, const std::string& filename, int width);
+
+}
+
+#endif
@@ -0,0 +1,228 @@
+// Petter Strandmark 2013.
+
+#include <algorithm>
+#include <cstring>
+
+#include "indexed_lines.h"
+
+namespace rapidsvg {
+
+namespace
+{
+	// The bits of a point. Adding 0 turns -0 into 0, so that the two
+	// are merged.
+	std::uint64_t point_key(float x, float y)
+	{
+		x += 0.0f;
+		y += 0.0f;
+		std::uint32_t x_bits, y_bits;
+		std::memcpy(&x_bits, &x, sizeof(x_bits));
+		std::memcpy(&y_bits, &y, sizeof(y_bits));
+		return (std::uint64_t(x_bits) << 32) | y_bits;
+	}
+
+	std::uint64_t mix(std::uint64_t key)
+	{
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdull;
+		key ^= key >> 33;
+		key *= 0xc4ceb9fe1a85ec53ull;
+		key ^= key >> 33;
+		return key;
+	}
+
+	// Maps points to their indices in a table of vertices, adding the
+	// points not seen before. Open addressing with linear probing.
+	class VertexTable
+	{
+	public:
+		VertexTable(size_t max_points, std::vector<float>* vertices_) :
+			vertices(vertices_)
+		{
+			size_t capacity = 16;
+			while (capacity < 2 * max_points) {
+				capacity *= 2;
+			}
+			mask = capacity - 1;
+			keys.resize(capacity);
+			// Zero marks an empty slot, so indices are stored plus one.
+			slots.resize(capacity, 0);
+		}
+
+		std::uint32_t index(float x, float y)
+		{
+			std::uint64_t key = point_key(x, y);
+			for (size_t slot = mix(key) & mask; ; slot = (slot + 1) & mask) {
+				if (slots[slot] == 0) {
+					keys[slot] = key;
+					vertices->push_back(x);
+					vertices->push_back(y);
+					slots[slot] = std::uint32_t(vertices->size() / 2);
+					return slots[slot] - 1;
+				}
+				if (keys[slot] == key) {
+					return slots[slot] - 1;
+				}
+			}
+		}
+
+	private:
+		std::vector<float>* vertices;
+		std::vector<std::uint64_t> keys;
+		std::vector<std::uint32_t> slots;
+		size_t mask;
+	};
+
+	bool same_style(const IndexedLines::Style& style, const Line& line)
+	{
+		return style.width == line.width && style.r == line.r &&
+		       style.g == line.g && style.b == line.b && style.a == line.a;
+	}
+
+	bool same_style(const Line& a, const Line& b)
+	{
+		return a.width == b.width && a.r == b.r && a.g == b.g && a.b == b.b &&
+		       a.a == b.a;
+	}
+
+	// Finds the runs of equally styled lines that take consecutive
+	// positions in document order, in any order, and gives the lines of
+	// every run the positions of the run in the order they are stored.
+	// Other lines keep their positions.
+	void find_run_orders(const std::vector<Line>& lines, std::vector<std::uint32_t>* orders)
+	{
+		const size_t n = lines.size();
+		orders->resize(n);
+		// Smallest position of the lines from i to the end of their
+		// stretch of equally styled lines.
+		std::vector<std::uint32_t> suffix_min(n);
+		for (size_t start = 0, end = 0; start < n; start = end) {
+			end = start + 1;
+			while (end < n && same_style(lines[start], lines[end])) {
+				end++;
+			}
+			suffix_min[end - 1] = lines[end - 1].order;
+			for (size_t i = end - 1; i > start; --i) {
+				suffix_min[i - 1] = std::min(suffix_min[i], lines[i - 1].order);
+			}
+
+			// The stretch is split into blocks wherever all lines before
+			// come before all lines after in document order. A block
+			// taking consecutive positions continues the run of the block
+			// before it if their positions do.
+			bool in_run = false;
+			size_t run_start = start;
+			std::uint32_t run_first = 0, run_last = 0;
+			size_t block_start = start;
+			std::uint32_t block_first = lines[start].order;
+			std::uint32_t block_last = block_first;
+			for (size_t i = start; i < end; ++i) {
+				block_first = std::min(block_first, lines[i].order);
+				block_last = std::max(block_last, lines[i].order);
+				if (i + 1 < end && block_last > suffix_min[i + 1]) {
+					continue;
+				}
+				if (size_t(block_last - block_first) + 1 == i + 1 - block_start) {
+					if (!in_run || run_last + 1 != block_first) {
+						in_run = true;
+						run_start = block_start;
+						run_first = block_first;
+					}
+					run_last = block_last;
+					for (size_t k = block_start; k <= i; ++k) {
+						(*orders)[k] = std::uint32_t(run_first + (k - run_start));
+					}
+				}
+				else {
+					in_run = false;
+					for (size_t k = block_start; k <= i; ++k) {
+						(*orders)[k] = lines[k].order;
+					}
+				}
+				if (i + 1 < end) {
+					block_start = i + 1;
+					block_first = block_last = lines[i + 1].order;
+				}
+			}
+		}
+	}
+}
+
+const std::uint32_t IndexedLines::max_chunk_lines;
+
+size_t IndexedLines::memory_bytes() const
+{
+	return vertices.size() * sizeof(vertices[0]) +
+	       indices.size() * sizeof(indices[0]) +
+	       styles.size() * sizeof(styles[0]) +
+	       chunks.size() * sizeof(chunks[0]);
+}
+
+void IndexedLines::clear()
+{
+	vertices.clear();
+	indices.clear();
+	styles.clear();
+	chunks.clear();
+}
+
+void IndexedLines::build(const std::vector<Line>& lines)
+{
+	clear();
+	indices.resize(2 * lines.size());
+	VertexTable table(2 * lines.size(), &vertices);
+	std::vector<std::uint32_t> orders;
+	find_run_orders(lines, &orders);
+	for (size_t i = 0; i < lines.size(); ++i) {
+		const Line& line = lines[i];
+		indices[2 * i]     = table.index(line.x1, line.y1);
+		indices[2 * i + 1] = table.index(line.x2, line.y2);
+
+		bool new_style = styles.empty() || !same_style(styles.back(), line);
+		if (new_style) {
+			Style style = {line.width, line.r, line.g, line.b, line.a};
+			styles.push_back(style);
+		}
+		if (new_style || orders[i] != orders[i - 1] + 1 ||
+		    chunks.back().end - chunks.back().first == max_chunk_lines) {
+			Chunk chunk;
+			chunk.first = chunk.end = std::uint32_t(i);
+			chunk.style = std::uint32_t(styles.size() - 1);
+			chunk.order = orders[i];
+			chunk.bounding_box = line.bounding_box();
+			chunks.push_back(chunk);
+		}
+		Chunk& chunk = chunks.back();
+		Rect box = line.bounding_box();
+		chunk.bounding_box.add(box.x_min, box.y_min);
+		chunk.bounding_box.add(box.x_max, box.y_max);
+		chunk.end++;
+	}
+	vertices.shrink_to_fit();
+}
+
+Line IndexedLines::line(size_t i) const
+{
+	// The last chunk starting at or before the line.
+	auto chunk = std::upper_bound(chunks.begin(), chunks.end(), i,
+		[](size_t index, const Chunk& other)
+		{
+			return index < other.first;
+		}) - 1;
+	const Style& style = styles[chunk->style];
+
+	Line line;
+	line.x1 = vertices[2 * indices[2 * i]];
+	line.y1 = vertices[2 * indices[2 * i] + 1];
+	line.x2 = vertices[2 * indices[2 * i + 1]];
+	line.y2 = vertices[2 * indices[2 * i + 1] + 1];
+	line.width = style.width;
+	line.r = style.r;
+	line.g = style.g;
+	line.b = style.b;
+	line.a = style.a;
+	line.order = std::uint32_t(chunk->order + (i - chunk->first));
+	return line;
+}
+
+}
@@ -0,0 +1,74 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_INDEXED_LINES_H
+#define RAPIDSVG_INDEXED_LINES_H
+
+#include <cstdint>
+#include <vector>
+
+#include "line.h"
+#include "rect.h"
+
+namespace rapidsvg {
+
+// Lines stored as pairs of indices into a table of end points, so that
+// an end point shared by many lines, like a node of a graph, is stored
+// once. The lines are kept in order and split into chunks of equally
+// styled lines with consecutive positions in document order, which are
+// culled and drawn as a whole.
+class IndexedLines
+{
+public:
+	// Stroke of the lines of a chunk.
+	class Style
+	{
+	public:
+		float width;
+		float r, g, b, a;
+	};
+
+	// A range of consecutive lines with the same style.
+	class Chunk
+	{
+	public:
+		std::uint32_t first, end;
+		// Index in styles.
+		std::uint32_t style;
+		// Position in document order of the first line; the others follow
+		// it. Equally styled lines that take consecutive positions, in any
+		// order, as after sorting them spatially, are given the positions
+		// in the order they are stored, which draws them the same.
+		std::uint32_t order;
+		// The rectangle covered by the lines, including their width.
+		Rect bounding_box;
+	};
+
+	// Chunks have at most this many lines, so that culling them is not too
+	// coarse.
+	static const std::uint32_t max_chunk_lines = 1024;
+
+	// End points as x0, y0, x1, y1, ...
+	std::vector<float> vertices;
+	// Indices of the two end points of every line.
+	std::vector<std::uint32_t> indices;
+	std::vector<Style> styles;
+	std::vector<Chunk> chunks;
+
+	size_t num_lines() const { return indices.size() / 2; }
+	size_t num_vertices() const { return vertices.size() / 2; }
+	// Bytes used by the vectors above.
+	size_t memory_bytes() const;
+	void clear();
+
+	// Replaces the contents by the given lines. End points with exactly the
+	// same coordinates are merged.
+	void build(const std::vector<Line>& lines);
+
+	// Returns line i as it was given to build, but with the position in
+	// document order it is drawn at.
+	Line line(size_t i) const;
+};
+
+}
+
+#endif
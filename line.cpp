@@ -1,53 +1,30 @@
 // Petter Strandmark 2013.
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <stdexcept>
 
 #include "line.h"
-#include "svg_file.h"
 
 namespace rapidsvg {
 
-void Line::parse_style_entry(char* style)
+void Line::transform(const Transform& transform)
 {
-	using namespace std;
-
-	char* name = style;
-	char* value = style;
-	while (*(++style)) {
-		if (*style == ':') {
-			*style = '\0';
-			value = style + 1;
-			break;
-		}
-	}
-
-	if (strcmp(name, "stroke-width") == 0) {
-		this->width = float(std::atof(value));
-	}
-	else if (strcmp(name, "stroke") == 0) {
-		parse_color(value, &this->r, &this->g, &this->b);
-	}
+	float xy[4] = {x1, y1, x2, y2};
+	transform.apply(xy, 2);
+	x1 = xy[0];
+	y1 = xy[1];
+	x2 = xy[2];
+	y2 = xy[3];
+	width *= float(transform.scale());
 }
 
-void Line::parse_style(char* style)
+Rect Line::bounding_box() const
 {
-	char* start = style;
-	while (true) {
-		if (*style == '\0') {
-			if (*start) {
-				parse_style_entry(start);
-			}
-			return;
-		}
-		else if (*style == ';') {
-			*style = '\0';
-			parse_style_entry(start);
-			start = style + 1;
-		}
-		style++;
-	}
+	float radius = width / 2;
+	return Rect(std::min(x1, x2) - radius, std::min(y1, y2) - radius,
+	            std::max(x1, x2) + radius, std::max(y1, y2) + radius);
 }
 
 }
\ No newline at end of file
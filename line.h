@@ -1,6 +1,11 @@
 #ifndef RAPIDSVG_LINE_H
 #define RAPIDSVG_LINE_H
 
+#include <cstdint>
+
+#include "rect.h"
+#include "transform.h"
+
 namespace rapidsvg {
 
 // Represents a line in the SVG file.
@@ -8,18 +13,23 @@ class Line
 {
 public:
 	Line() : x1(0), y1(0), x2(0), y2(0),
-	         width(1), r(0), g(0), b(0)
+	         width(1), r(0), g(0), b(0), a(1), order(0)
 	{ }
 	float x1, y1, x2, y2;
 	float width;
 	float r, g, b;
+	// Opacity of the stroke: the alpha of its color times the opacity
+	// properties.
+	float a;
+	// Position of the element in the document, which sets the order the
+	// elements are drawn in.
+	std::uint32_t order;
 
-	// Parses a style string and modifies the line.
-	// Also modifies the string itself.
-	void parse_style(char* style);
+	// Transforms the end points and scales the width.
+	void transform(const Transform& transform);
 
-private:
-	void parse_style_entry(char* style);
+	// Returns the rectangle covered by the line, including its width.
+	Rect bounding_box() const;
 };
 
 }
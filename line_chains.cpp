@@ -0,0 +1,211 @@
+// Petter Strandmark 2013.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "indexed_lines.h"
+#include "line_chains.h"
+
+namespace rapidsvg {
+
+namespace
+{
+	// Number of unused lines at a point considered for continuing a
+	// chain, so that points shared by very many lines stay cheap.
+	const int max_candidates = 16;
+
+	// The lines meeting at every end point, and for every end point the
+	// first of them that may still be unused.
+	class Adjacency
+	{
+	public:
+		explicit Adjacency(const IndexedLines& indexed)
+		{
+			const size_t num_vertices = indexed.num_vertices();
+			offsets.assign(num_vertices + 1, 0);
+			for (auto vertex : indexed.indices) {
+				offsets[vertex + 1]++;
+			}
+			for (size_t v = 0; v < num_vertices; ++v) {
+				offsets[v + 1] += offsets[v];
+			}
+			cursors.assign(offsets.begin(), offsets.end() - 1);
+			lines.resize(indexed.indices.size());
+			std::vector<std::uint32_t> fill(cursors);
+			for (size_t i = 0; i < indexed.indices.size(); ++i) {
+				lines[fill[indexed.indices[i]]++] = std::uint32_t(i / 2);
+			}
+		}
+
+		std::vector<std::uint32_t> offsets;
+		std::vector<std::uint32_t> cursors;
+		std::vector<std::uint32_t> lines;
+	};
+
+	// Whether q lies on the continuation of the segment from p through
+	// the distinct point v.
+	bool continues_straight(const std::pair<float, float>& p,
+	                        const std::pair<float, float>& v,
+	                        const std::pair<float, float>& q)
+	{
+		double dx0 = double(v.first) - p.first;
+		double dy0 = double(v.second) - p.second;
+		double dx1 = double(q.first) - v.first;
+		double dy1 = double(q.second) - v.second;
+		return dx0 * dy1 - dy0 * dx1 == 0 && dx0 * dx1 + dy0 * dy1 > 0;
+	}
+
+	class ChainBuilder
+	{
+	public:
+		ChainBuilder(const IndexedLines& indexed_,
+		             const std::vector<std::uint32_t>& runs_) :
+			indexed(indexed_), runs(runs_), adjacency(indexed_),
+			used(indexed_.num_lines(), false)
+		{ }
+
+		// Builds the chain containing the unused line, as end point
+		// indices in order.
+		void build(std::uint32_t line, std::vector<std::uint32_t>* chain)
+		{
+			used[line] = true;
+			std::uint32_t start = indexed.indices[2 * line];
+			std::uint32_t end = indexed.indices[2 * line + 1];
+			backward.clear();
+			backward.push_back(start);
+			extend(end, start, runs[line], &backward);
+			chain->assign(backward.rbegin(), backward.rend());
+			// The chain is extended from the other end of the line too.
+			chain->push_back(end);
+			extend(start, end, runs[line], chain);
+		}
+
+		bool is_used(std::uint32_t line) const { return used[line]; }
+
+	private:
+		// Adds end points to points, which ends with previous, current,
+		// by following unused lines from current.
+		void extend(std::uint32_t previous, std::uint32_t current,
+		            std::uint32_t run, std::vector<std::uint32_t>* points)
+		{
+			while (true) {
+				float dx = vertex_x(current) - vertex_x(previous);
+				float dy = vertex_y(current) - vertex_y(previous);
+				float in_length = std::sqrt(dx * dx + dy * dy);
+
+				std::uint32_t& cursor = adjacency.cursors[current];
+				const std::uint32_t stop = adjacency.offsets[current + 1];
+				while (cursor < stop && used[adjacency.lines[cursor]]) {
+					cursor++;
+				}
+				int best = -1;
+				std::uint32_t best_next = 0;
+				float best_straightness = -2;
+				int num_candidates = 0;
+				for (std::uint32_t k = cursor;
+				     k < stop && num_candidates < max_candidates; ++k) {
+					std::uint32_t line = adjacency.lines[k];
+					if (used[line] || runs[line] != run) {
+						continue;
+					}
+					num_candidates++;
+					std::uint32_t next = indexed.indices[2 * line];
+					if (next == current) {
+						next = indexed.indices[2 * line + 1];
+					}
+					float ex = vertex_x(next) - vertex_x(current);
+					float ey = vertex_y(next) - vertex_y(current);
+					float out_length = std::sqrt(ex * ex + ey * ey);
+					// Cosine of the turn, or 0 for lines without length.
+					float straightness = 0;
+					if (in_length > 0 && out_length > 0) {
+						straightness = (dx * ex + dy * ey) / (in_length * out_length);
+					}
+					if (straightness > best_straightness) {
+						best = int(line);
+						best_next = next;
+						best_straightness = straightness;
+					}
+				}
+				if (best < 0) {
+					return;
+				}
+				used[best] = true;
+				points->push_back(best_next);
+				previous = current;
+				current = best_next;
+			}
+		}
+
+		float vertex_x(std::uint32_t v) const { return indexed.vertices[2 * v]; }
+		float vertex_y(std::uint32_t v) const { return indexed.vertices[2 * v + 1]; }
+
+		const IndexedLines& indexed;
+		const std::vector<std::uint32_t>& runs;
+		Adjacency adjacency;
+		std::vector<bool> used;
+		std::vector<std::uint32_t> backward;
+	};
+}
+
+size_t chain_lines(std::vector<Line>* lines, Arena* arena,
+                   std::vector<Polyline>* polylines)
+{
+	IndexedLines indexed;
+	indexed.build(*lines);
+	// A run continues into the next chunk if it has the same style and
+	// the positions of its lines continue.
+	std::vector<std::uint32_t> runs(indexed.num_lines());
+	std::uint32_t num_runs = 0;
+	for (size_t c = 0; c < indexed.chunks.size(); ++c) {
+		const IndexedLines::Chunk& chunk = indexed.chunks[c];
+		const IndexedLines::Chunk* previous = c > 0 ? &indexed.chunks[c - 1] : 0;
+		if (!previous || previous->style != chunk.style ||
+		    previous->order + (previous->end - previous->first) != chunk.order) {
+			num_runs++;
+		}
+		std::fill(runs.begin() + chunk.first, runs.begin() + chunk.end, num_runs);
+	}
+
+	const size_t num_polylines = polylines->size();
+	ChainBuilder builder(indexed, runs);
+	std::vector<std::uint32_t> chain;
+	for (std::uint32_t i = 0; i < indexed.num_lines(); ++i) {
+		if (builder.is_used(i)) {
+			continue;
+		}
+		builder.build(i, &chain);
+
+		const Line line = indexed.line(i);
+		Polyline polyline;
+		polyline.order = line.order;
+		polyline.points = PointVector(PointVector::allocator_type(arena));
+		polyline.points.reserve(chain.size());
+		for (auto v : chain) {
+			std::pair<float, float> point(indexed.vertices[2 * v], indexed.vertices[2 * v + 1]);
+			// A point where the chain continues straight on is left out,
+			// as it does not change the stroke.
+			size_t n = polyline.points.size();
+			if (n >= 2 && continues_straight(polyline.points[n - 2],
+			                                 polyline.points[n - 1], point)) {
+				polyline.points.back() = point;
+			}
+			else {
+				polyline.points.push_back(point);
+			}
+		}
+		polyline.style.filled = false;
+		polyline.style.stroked = true;
+		polyline.style.stroke_r = line.r;
+		polyline.style.stroke_g = line.g;
+		polyline.style.stroke_b = line.b;
+		polyline.style.stroke_a = line.a;
+		polyline.style.stroke_width = line.width;
+		polylines->push_back(std::move(polyline));
+	}
+	std::vector<Line>().swap(*lines);
+	return polylines->size() - num_polylines;
+}
+
+}
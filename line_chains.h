@@ -0,0 +1,30 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_LINE_CHAINS_H
+#define RAPIDSVG_LINE_CHAINS_H
+
+#include <vector>
+
+#include "arena.h"
+#include "line.h"
+#include "shapes.h"
+
+namespace rapidsvg {
+
+// Links lines with identical style that share end points into stroked
+// polylines, so that they are drawn with joins instead of gaps between
+// them. At a point where several lines meet, a chain continues along the
+// straightest of them.
+//
+// All lines are moved to the end of polylines, as unfilled polylines
+// with the points allocated from arena, and lines is left empty. Chains
+// are only made within runs of equally styled lines with nothing else
+// drawn between them, and every chain takes the position in document
+// order of one of its lines, so that the lines are drawn at the same
+// place in the stacking as before. Returns the number of polylines added.
+size_t chain_lines(std::vector<Line>* lines, Arena* arena,
+                   std::vector<Polyline>* polylines);
+
+}
+
+#endif
@@ -0,0 +1,138 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_NUMBER_PARSER_H
+#define RAPIDSVG_NUMBER_PARSER_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace rapidsvg {
+
+// Skips whitespace and commas.
+inline const char* skip_separators(const char* ptr)
+{
+	while (*ptr == ' ' || *ptr == ',' || *ptr == '\t' ||
+	       *ptr == '\r' || *ptr == '\n') {
+		ptr++;
+	}
+	return ptr;
+}
+
+// Counts the numbers of a null-terminated list like "1,2 -3-4e-1", to
+// reserve room for them before parsing. Numbers without anything between
+// them, like "1.5.5", are counted as one.
+inline std::size_t count_numbers(const char* ptr)
+{
+	std::size_t count = 0;
+	bool in_number = false;
+	bool after_exponent = false;
+	for (; *ptr; ++ptr) {
+		char c = *ptr;
+		if ((c >= '0' && c <= '9') || c == '.') {
+			count += !in_number;
+			in_number = true;
+			after_exponent = false;
+		}
+		else if (c == '-' || c == '+') {
+			count += !after_exponent;
+			in_number = true;
+			after_exponent = false;
+		}
+		else if ((c == 'e' || c == 'E') && in_number) {
+			after_exponent = true;
+		}
+		else {
+			in_number = false;
+			after_exponent = false;
+		}
+	}
+	return count;
+}
+
+// Parses a decimal number at *ptr and advances *ptr past it. Returns false,
+// leaving *ptr unchanged, if there is no number. Unlike atof, this never
+// looks at the locale and stops at a second '.' or a sign, as SVG number
+// lists like "1.5.5-2" require.
+inline bool parse_number(const char** ptr, float* value)
+{
+	static const double powers_of_ten[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+	const char* p = *ptr;
+	bool negative = false;
+	if (*p == '-' || *p == '+') {
+		negative = *p == '-';
+		p++;
+	}
+
+	// At most 18 significant digits fit in the mantissa.
+	std::uint64_t mantissa = 0;
+	int exponent = 0;
+	int num_digits = 0;
+	bool has_digits = false;
+	for (; *p >= '0' && *p <= '9'; ++p) {
+		has_digits = true;
+		if (num_digits < 18) {
+			mantissa = 10 * mantissa + (*p - '0');
+			num_digits += mantissa != 0;
+		}
+		else {
+			exponent++;
+		}
+	}
+	if (*p == '.') {
+		for (++p; *p >= '0' && *p <= '9'; ++p) {
+			has_digits = true;
+			if (num_digits < 18) {
+				mantissa = 10 * mantissa + (*p - '0');
+				num_digits += mantissa != 0;
+				exponent--;
+			}
+		}
+	}
+	if (!has_digits) {
+		return false;
+	}
+
+	if (*p == 'e' || *p == 'E') {
+		const char* e = p + 1;
+		bool negative_exponent = false;
+		if (*e == '-' || *e == '+') {
+			negative_exponent = *e == '-';
+			e++;
+		}
+		if (*e >= '0' && *e <= '9') {
+			int exponent_value = 0;
+			for (; *e >= '0' && *e <= '9'; ++e) {
+				if (exponent_value < 1000) {
+					exponent_value = 10 * exponent_value + (*e - '0');
+				}
+			}
+			exponent += negative_exponent ? -exponent_value : exponent_value;
+			p = e;
+		}
+	}
+
+	double result = double(mantissa);
+	if (exponent != 0 && mantissa != 0) {
+		if (exponent > 0 && exponent <= 22) {
+			result *= powers_of_ten[exponent];
+		}
+		else if (exponent < 0 && exponent >= -22) {
+			result /= powers_of_ten[-exponent];
+		}
+		else {
+			result *= std::pow(10.0, exponent);
+		}
+	}
+
+	*value = float(negative ? -result : result);
+	*ptr = p;
+	return true;
+}
+
+}
+
+#endif
@@ -0,0 +1,380 @@
+// Petter Strandmark 2013.
+
+#include <algorithm>
+#include <cmath>
+
+#include "number_parser.h"
+#include "path.h"
+
+namespace rapidsvg {
+
+void Path::add_point(float x, float y)
+{
+	coordinates.push_back(x);
+	coordinates.push_back(y);
+}
+
+// Parses an arc flag, which may be written without a separator after it.
+static bool parse_flag(const char** ptr, bool* flag)
+{
+	if (**ptr != '0' && **ptr != '1') {
+		return false;
+	}
+	*flag = **ptr == '1';
+	(*ptr)++;
+	return true;
+}
+
+void Path::parse_data(const char* data)
+{
+	const char* ptr = data;
+	char command = 0;
+	// Current point, start of the current subpath and the last control
+	// point, which S and T reflect.
+	float x = 0, y = 0;
+	float start_x = 0, start_y = 0;
+	float control_x = 0, control_y = 0;
+	char last_command = 0;
+
+	while (true) {
+		ptr = skip_separators(ptr);
+		if (*ptr == '\0') {
+			break;
+		}
+		if ((*ptr >= 'a' && *ptr <= 'z') || (*ptr >= 'A' && *ptr <= 'Z')) {
+			command = *ptr++;
+			if (command == 'Z' || command == 'z') {
+				if (!commands.empty() && commands.back() != Close) {
+					commands.push_back(Close);
+				}
+				x = start_x;
+				y = start_y;
+				last_command = command;
+				continue;
+			}
+			ptr = skip_separators(ptr);
+		}
+		else if (command == 0 || command == 'Z' || command == 'z') {
+			// Numbers without a command.
+			break;
+		}
+
+		bool relative = command >= 'a' && command <= 'z';
+		char upper = char(relative ? command - 'a' + 'A' : command);
+		float base_x = relative ? x : 0;
+		float base_y = relative ? y : 0;
+
+		// Read the arguments of one segment.
+		const int num_args = upper == 'H' || upper == 'V' ? 1 :
+		                     upper == 'M' || upper == 'L' || upper == 'T' ? 2 :
+		                     upper == 'Q' || upper == 'S' ? 4 :
+		                     upper == 'C' ? 6 :
+		                     upper == 'A' ? 7 : 0;
+		if (num_args == 0) {
+			break;
+		}
+		float args[7];
+		bool large_arc = false, sweep = false;
+		bool valid = true;
+		for (int i = 0; i < num_args && valid; ++i) {
+			if (i > 0) {
+				ptr = skip_separators(ptr);
+			}
+			if (upper == 'A' && i == 3) {
+				valid = parse_flag(&ptr, &large_arc);
+			}
+			else if (upper == 'A' && i == 4) {
+				valid = parse_flag(&ptr, &sweep);
+			}
+			else {
+				valid = parse_number(&ptr, &args[i]);
+			}
+		}
+		if (!valid) {
+			break;
+		}
+
+		if (upper == 'M') {
+			x = base_x + args[0];
+			y = base_y + args[1];
+			start_x = x;
+			start_y = y;
+			commands.push_back(MoveTo);
+			add_point(x, y);
+			// Further coordinate pairs are lines.
+			command = relative ? 'l' : 'L';
+			last_command = upper;
+			continue;
+		}
+
+		if (commands.empty()) {
+			// A path has to begin with a move.
+			break;
+		}
+		if (commands.back() == Close) {
+			// Drawing after a close starts a new subpath at the same point.
+			commands.push_back(MoveTo);
+			add_point(start_x, start_y);
+		}
+
+		// Reflection of the last control point for S and T.
+		bool last_cubic = last_command == 'C' || last_command == 'S';
+		bool last_quad = last_command == 'Q' || last_command == 'T';
+		float reflected_x = 2 * x - control_x;
+		float reflected_y = 2 * y - control_y;
+
+		if (upper == 'L' || upper == 'H' || upper == 'V') {
+			if (upper == 'L') {
+				x = base_x + args[0];
+				y = base_y + args[1];
+			}
+			else if (upper == 'H') {
+				x = base_x + args[0];
+			}
+			else {
+				y = base_y + args[0];
+			}
+			commands.push_back(LineTo);
+			add_point(x, y);
+		}
+		else if (upper == 'C' || upper == 'S') {
+			float x1 = last_cubic ? reflected_x : x;
+			float y1 = last_cubic ? reflected_y : y;
+			const float* p = args;
+			if (upper == 'C') {
+				x1 = base_x + p[0];
+				y1 = base_y + p[1];
+				p += 2;
+			}
+			control_x = base_x + p[0];
+			control_y = base_y + p[1];
+			x = base_x + p[2];
+			y = base_y + p[3];
+			commands.push_back(CubicTo);
+			add_point(x1, y1);
+			add_point(control_x, control_y);
+			add_point(x, y);
+		}
+		else if (upper == 'Q' || upper == 'T') {
+			if (upper == 'Q') {
+				control_x = base_x + args[0];
+				control_y = base_y + args[1];
+				x = base_x + args[2];
+				y = base_y + args[3];
+			}
+			else {
+				control_x = last_quad ? reflected_x : x;
+				control_y = last_quad ? reflected_y : y;
+				x = base_x + args[0];
+				y = base_y + args[1];
+			}
+			commands.push_back(QuadTo);
+			add_point(control_x, control_y);
+			add_point(x, y);
+		}
+		else {
+			float end_x = base_x + args[5];
+			float end_y = base_y + args[6];
+			add_arc(x, y, args[0], args[1], args[2], large_arc, sweep, end_x, end_y);
+			x = end_x;
+			y = end_y;
+		}
+		last_command = upper;
+	}
+}
+
+void Path::add_arc(float x1, float y1, float rx, float ry, float angle,
+                   bool large_arc, bool sweep, float x2, float y2)
+{
+	using namespace std;
+
+	const double pi = 3.14159265358979323846;
+	if (x1 == x2 && y1 == y2) {
+		return;
+	}
+	rx = abs(rx);
+	ry = abs(ry);
+	if (rx == 0 || ry == 0) {
+		commands.push_back(LineTo);
+		add_point(x2, y2);
+		return;
+	}
+
+	// Conversion from endpoint to center parametrization as in the
+	// implementation notes of the SVG specification.
+	double phi = angle * pi / 180;
+	double cos_phi = cos(phi), sin_phi = sin(phi);
+	double dx = (x1 - x2) / 2.0, dy = (y1 - y2) / 2.0;
+	double x1p = cos_phi * dx + sin_phi * dy;
+	double y1p = -sin_phi * dx + cos_phi * dy;
+
+	// Scale up radii that are too small to reach the end point.
+	double lambda = (x1p * x1p) / (double(rx) * rx) + (y1p * y1p) / (double(ry) * ry);
+	double rxd = rx, ryd = ry;
+	if (lambda > 1) {
+		rxd *= sqrt(lambda);
+		ryd *= sqrt(lambda);
+	}
+
+	double numerator = rxd * rxd * ryd * ryd - rxd * rxd * y1p * y1p - ryd * ryd * x1p * x1p;
+	double denominator = rxd * rxd * y1p * y1p + ryd * ryd * x1p * x1p;
+	double coefficient = sqrt(max(0.0, numerator / denominator));
+	if (large_arc == sweep) {
+		coefficient = -coefficient;
+	}
+	double cxp = coefficient * rxd * y1p / ryd;
+	double cyp = -coefficient * ryd * x1p / rxd;
+	double cx = cos_phi * cxp - sin_phi * cyp + (x1 + x2) / 2.0;
+	double cy = sin_phi * cxp + cos_phi * cyp + (y1 + y2) / 2.0;
+
+	double theta1 = atan2((y1p - cyp) / ryd, (x1p - cxp) / rxd);
+	double theta2 = atan2((-y1p - cyp) / ryd, (-x1p - cxp) / rxd);
+	double delta = theta2 - theta1;
+	if (sweep && delta < 0) {
+		delta += 2 * pi;
+	}
+	else if (!sweep && delta > 0) {
+		delta -= 2 * pi;
+	}
+
+	// One cubic curve for every quarter of a turn or less.
+	int num_segments = int(ceil(abs(delta) / (pi / 2) - 1e-9));
+	num_segments = max(num_segments, 1);
+	double step = delta / num_segments;
+	double k = 4.0 / 3.0 * tan(step / 4);
+	double theta = theta1;
+	for (int i = 0; i < num_segments; ++i) {
+		double cos1 = cos(theta), sin1 = sin(theta);
+		double cos2 = cos(theta + step), sin2 = sin(theta + step);
+		// Points on the unit circle, then mapped to the ellipse.
+		double px[3] = {cos1 - k * sin1, cos2 + k * sin2, cos2};
+		double py[3] = {sin1 + k * cos1, sin2 - k * cos2, sin2};
+		commands.push_back(CubicTo);
+		for (int j = 0; j < 3; ++j) {
+			double ex = rxd * px[j];
+			double ey = ryd * py[j];
+			add_point(float(cos_phi * ex - sin_phi * ey + cx),
+			          float(sin_phi * ex + cos_phi * ey + cy));
+		}
+		theta += step;
+	}
+	// Land exactly on the end point.
+	coordinates[coordinates.size() - 2] = x2;
+	coordinates[coordinates.size() - 1] = y2;
+}
+
+void Path::transform(const Transform& transform)
+{
+	if (!coordinates.empty()) {
+		transform.apply(&coordinates[0], coordinates.size() / 2);
+	}
+	style.stroke_width *= float(transform.scale());
+}
+
+Rect Path::bounding_box() const
+{
+	if (coordinates.empty()) {
+		return Rect();
+	}
+	// The curves lie within the convex hull of their control points.
+	Rect box(coordinates[0], coordinates[1], coordinates[0], coordinates[1]);
+	for (size_t i = 2; i < coordinates.size(); i += 2) {
+		box.add(coordinates[i], coordinates[i + 1]);
+	}
+	if (style.stroked) {
+		float radius = style.stroke_width / 2;
+		box.x_min -= radius;
+		box.y_min -= radius;
+		box.x_max += radius;
+		box.y_max += radius;
+	}
+	return box;
+}
+
+void Path::flatten(float tolerance,
+                   std::vector<float>* xy,
+                   std::vector<std::uint32_t>* subpath_ends) const
+{
+	using namespace std;
+
+	const int max_segments = 1024;
+	// Number of segments needed for a curve whose control polygon has the
+	// given largest second difference (Wang's formula).
+	auto num_segments = [tolerance, max_segments](double factor, double dx, double dy)
+	{
+		double n = ceil(sqrt(factor * sqrt(dx * dx + dy * dy) / tolerance));
+		return int(min(max(n, 1.0), double(max_segments)));
+	};
+
+	size_t subpath_start = xy->size();
+	auto end_subpath = [&]()
+	{
+		// Subpaths of a single point draw nothing.
+		if (xy->size() - subpath_start >= 4) {
+			subpath_ends->push_back(uint32_t(xy->size() / 2));
+		}
+		else {
+			xy->resize(subpath_start);
+		}
+		subpath_start = xy->size();
+	};
+
+	const float* p = coordinates.empty() ? 0 : &coordinates[0];
+	float x = 0, y = 0;
+	for (auto command : commands) {
+		if (command == MoveTo) {
+			end_subpath();
+			x = p[0];
+			y = p[1];
+			xy->push_back(x);
+			xy->push_back(y);
+			p += 2;
+		}
+		else if (command == LineTo) {
+			x = p[0];
+			y = p[1];
+			xy->push_back(x);
+			xy->push_back(y);
+			p += 2;
+		}
+		else if (command == QuadTo) {
+			int n = num_segments(0.25, x - 2 * p[0] + p[2], y - 2 * p[1] + p[3]);
+			for (int i = 1; i <= n; ++i) {
+				float t = float(i) / n;
+				float s = 1 - t;
+				xy->push_back(s * s * x + 2 * s * t * p[0] + t * t * p[2]);
+				xy->push_back(s * s * y + 2 * s * t * p[1] + t * t * p[3]);
+			}
+			x = p[2];
+			y = p[3];
+			p += 4;
+		}
+		else if (command == CubicTo) {
+			double ddx1 = x - 2 * p[0] + p[2], ddy1 = y - 2 * p[1] + p[3];
+			double ddx2 = p[0] - 2 * p[2] + p[4], ddy2 = p[1] - 2 * p[3] + p[5];
+			int n = ddx1 * ddx1 + ddy1 * ddy1 > ddx2 * ddx2 + ddy2 * ddy2 ?
+			        num_segments(0.75, ddx1, ddy1) : num_segments(0.75, ddx2, ddy2);
+			for (int i = 1; i <= n; ++i) {
+				float t = float(i) / n;
+				float s = 1 - t;
+				float w0 = s * s * s, w1 = 3 * s * s * t, w2 = 3 * s * t * t, w3 = t * t * t;
+				xy->push_back(w0 * x + w1 * p[0] + w2 * p[2] + w3 * p[4]);
+				xy->push_back(w0 * y + w1 * p[1] + w2 * p[3] + w3 * p[5]);
+			}
+			x = p[4];
+			y = p[5];
+			p += 6;
+		}
+		else if (xy->size() > subpath_start) {
+			// Close the subpath with its first point.
+			x = (*xy)[subpath_start];
+			y = (*xy)[subpath_start + 1];
+			xy->push_back(x);
+			xy->push_back(y);
+			end_subpath();
+		}
+	}
+	end_subpath();
+}
+
+}
@@ -0,0 +1,61 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_PATH_H
+#define RAPIDSVG_PATH_H
+
+#include <cstdint>
+#include <vector>
+
+#include "arena.h"
+#include "rect.h"
+#include "style.h"
+#include "transform.h"
+
+namespace rapidsvg {
+
+// Represents a path in the SVG file. The path data is kept as absolute
+// lines and Bezier curves (arcs are converted to cubic curves) and is
+// flattened to polylines for a given tolerance when drawn.
+class Path
+{
+public:
+	Path() : order(0)
+	{ }
+	enum Command {MoveTo, LineTo, QuadTo, CubicTo, Close};
+	// Segments of the path. MoveTo and LineTo use one point of
+	// coordinates, QuadTo two, CubicTo three and Close none.
+	std::vector<std::uint8_t, ArenaAllocator<std::uint8_t> > commands;
+	// Points of the segments as x0, y0, x1, y1, ...
+	std::vector<float, ArenaAllocator<float> > coordinates;
+
+	ShapeStyle style;
+	// Position of the path in the document, as Line::order.
+	std::uint32_t order;
+
+	// Parses path data, e.g. "M 0,0 L 10,0 A 5,5 0 0 1 0,0 Z". As the
+	// specification requires, the path is kept up to the first error.
+	void parse_data(const char* data);
+
+	// Transforms all points and scales the stroke width.
+	void transform(const Transform& transform);
+
+	// Returns a rectangle covering the path and its control points.
+	Rect bounding_box() const;
+
+	// Appends polylines approximating the path to xy, with no point
+	// further than tolerance from the curves. The index in xy (counted
+	// in points) of the end of every subpath is appended to
+	// subpath_ends. Closed subpaths end with their first point.
+	void flatten(float tolerance,
+	             std::vector<float>* xy,
+	             std::vector<std::uint32_t>* subpath_ends) const;
+
+private:
+	void add_point(float x, float y);
+	void add_arc(float x1, float y1, float rx, float ry, float angle,
+	             bool large_arc, bool sweep, float x2, float y2);
+};
+
+}
+
+#endif
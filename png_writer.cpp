@@ -0,0 +1,252 @@
+// Petter Strandmark 2013.
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef USE_ZLIB
+	#include <zlib.h>
+#endif
+
+#include "png_writer.h"
+#include "raster.h"
+
+namespace rapidsvg {
+
+namespace
+{
+	// Compressed data is written in IDAT chunks of about this size.
+	const size_t chunk_size = 1 << 16;
+	// Largest block of data stored without compression.
+	const size_t max_stored_block = 65535;
+
+	// Table of the CRC of every byte. Static locals are built once even
+	// when several threads write files.
+	class CrcTable
+	{
+	public:
+		CrcTable()
+		{
+			for (std::uint32_t n = 0; n < 256; ++n) {
+				std::uint32_t c = n;
+				for (int k = 0; k < 8; ++k) {
+					c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				}
+				values[n] = c;
+			}
+		}
+		std::uint32_t values[256];
+	};
+
+	std::uint32_t crc32_of(const std::uint8_t* data, size_t size, std::uint32_t crc)
+	{
+		static const CrcTable table;
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i) {
+			crc = table.values[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	void put_uint32(std::uint32_t value, std::uint8_t* bytes)
+	{
+		bytes[0] = std::uint8_t(value >> 24);
+		bytes[1] = std::uint8_t(value >> 16);
+		bytes[2] = std::uint8_t(value >> 8);
+		bytes[3] = std::uint8_t(value);
+	}
+}
+
+#ifdef USE_ZLIB
+
+// Compresses a zlib stream with deflate.
+class PngWriter::Deflater
+{
+public:
+	Deflater()
+	{
+		std::memset(&stream, 0, sizeof(stream));
+		if (deflateInit(&stream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+			throw std::runtime_error("Could not start compressing PNG data.");
+		}
+	}
+	~Deflater()
+	{
+		deflateEnd(&stream);
+	}
+
+	void add(const std::uint8_t* input, size_t size, bool last,
+	         std::vector<std::uint8_t>* output)
+	{
+		stream.next_in = const_cast<Bytef*>(input);
+		stream.avail_in = uInt(size);
+		int flush = last ? Z_FINISH : Z_NO_FLUSH;
+		std::uint8_t buffer[1 << 14];
+		int result;
+		do {
+			stream.next_out = buffer;
+			stream.avail_out = sizeof(buffer);
+			result = deflate(&stream, flush);
+			if (result == Z_STREAM_ERROR) {
+				throw std::runtime_error("Could not compress PNG data.");
+			}
+			output->insert(output->end(), buffer, buffer + sizeof(buffer) - stream.avail_out);
+		} while (stream.avail_out == 0 || (last && result != Z_STREAM_END));
+	}
+
+private:
+	z_stream stream;
+};
+
+#else
+
+// Stores a zlib stream in uncompressed blocks.
+class PngWriter::Deflater
+{
+public:
+	Deflater() : a(1), b(0), header_written(false)
+	{ }
+
+	void add(const std::uint8_t* input, size_t size, bool last,
+	         std::vector<std::uint8_t>* output)
+	{
+		if (!header_written) {
+			output->push_back(0x78);
+			output->push_back(0x01);
+			header_written = true;
+		}
+		for (size_t i = 0; i < size; ++i) {
+			a = (a + input[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+		pending.insert(pending.end(), input, input + size);
+		size_t begin = 0;
+		while (pending.size() - begin >= max_stored_block || (last && begin <= pending.size())) {
+			size_t length = std::min(max_stored_block, pending.size() - begin);
+			bool final_block = last && begin + length == pending.size();
+			output->push_back(final_block ? 1 : 0);
+			output->push_back(std::uint8_t(length));
+			output->push_back(std::uint8_t(length >> 8));
+			output->push_back(std::uint8_t(~length));
+			output->push_back(std::uint8_t(~length >> 8));
+			output->insert(output->end(), pending.begin() + begin, pending.begin() + begin + length);
+			begin += length;
+			if (final_block) {
+				break;
+			}
+		}
+		pending.erase(pending.begin(), pending.begin() + begin);
+		if (last) {
+			std::uint8_t adler[4];
+			put_uint32((b << 16) | a, adler);
+			output->insert(output->end(), adler, adler + 4);
+		}
+	}
+
+private:
+	std::uint32_t a, b;
+	bool header_written;
+	std::vector<std::uint8_t> pending;
+};
+
+#endif
+
+PngWriter::PngWriter(const std::string& filename, int width_, int height_)
+	: deflater(new Deflater),
+	  width(width_),
+	  height(height_),
+	  rows_written(0),
+	  previous_row(3 * size_t(width_), 0),
+	  filtered_row(3 * size_t(width_) + 1, 0)
+{
+	file.open(filename, std::ios::binary | std::ios::out | std::ios::trunc);
+	if (!file) {
+		throw std::runtime_error("Could not create " + filename + ".");
+	}
+	static const std::uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+	file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+	// 8 bits per channel, RGB, no interlacing.
+	std::uint8_t header[13] = {0};
+	put_uint32(std::uint32_t(width), &header[0]);
+	put_uint32(std::uint32_t(height), &header[4]);
+	header[8] = 8;
+	header[9] = 2;
+	write_chunk("IHDR", header, sizeof(header));
+}
+
+PngWriter::~PngWriter()
+{
+}
+
+void PngWriter::write_rows(const std::uint8_t* pixels, int num_rows)
+{
+	if (rows_written + num_rows > height) {
+		throw std::runtime_error("Too many rows written to PNG file.");
+	}
+	// Every row is filtered with "up": the difference to the row above.
+	filtered_row[0] = 2;
+	for (int r = 0; r < num_rows; ++r) {
+		const std::uint8_t* row = &pixels[4 * size_t(r) * width];
+		for (int x = 0; x < width; ++x) {
+			for (int c = 0; c < 3; ++c) {
+				std::uint8_t value = row[4 * x + c];
+				filtered_row[1 + 3 * x + c] = std::uint8_t(value - previous_row[3 * x + c]);
+				previous_row[3 * x + c] = value;
+			}
+		}
+		deflater->add(&filtered_row[0], filtered_row.size(), false, &data);
+		flush_data(false);
+	}
+	rows_written += num_rows;
+}
+
+void PngWriter::close()
+{
+	if (rows_written != height) {
+		throw std::runtime_error("Too few rows written to PNG file.");
+	}
+	deflater->add(0, 0, true, &data);
+	flush_data(true);
+	write_chunk("IEND", 0, 0);
+	file.close();
+	if (!file) {
+		throw std::runtime_error("Could not write PNG file.");
+	}
+}
+
+void PngWriter::flush_data(bool all)
+{
+	size_t begin = 0;
+	while (data.size() - begin >= chunk_size || (all && begin < data.size())) {
+		size_t size = std::min(chunk_size, data.size() - begin);
+		write_chunk("IDAT", &data[begin], size);
+		begin += size;
+	}
+	data.erase(data.begin(), data.begin() + begin);
+}
+
+void PngWriter::write_chunk(const char* type, const std::uint8_t* chunk, size_t size)
+{
+	std::uint8_t length[4];
+	put_uint32(std::uint32_t(size), length);
+	file.write(reinterpret_cast<const char*>(length), 4);
+	file.write(type, 4);
+	std::uint32_t crc = crc32_of(reinterpret_cast<const std::uint8_t*>(type), 4, 0);
+	if (size > 0) {
+		file.write(reinterpret_cast<const char*>(chunk), size);
+		crc = crc32_of(chunk, size, crc);
+	}
+	std::uint8_t crc_bytes[4];
+	put_uint32(crc, crc_bytes);
+	file.write(reinterpret_cast<const char*>(crc_bytes), 4);
+}
+
+void write_png(const std::string& filename, const Image& image)
+{
+	PngWriter writer(filename, image.width, image.height);
+	writer.write_rows(&image.pixels[0], image.height);
+	writer.close();
+}
+
+}
@@ -0,0 +1,53 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_PNG_WRITER_H
+#define RAPIDSVG_PNG_WRITER_H
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rapidsvg {
+
+class Image;
+
+// Writes an opaque RGB PNG file a few rows at a time, so that images
+// larger than memory can be written. The rows are compressed with zlib if
+// it was found and stored uncompressed otherwise.
+class PngWriter
+{
+public:
+	PngWriter(const std::string& filename, int width, int height);
+	~PngWriter();
+
+	// Appends rows of width RGBA pixels each. The alpha is ignored.
+	void write_rows(const std::uint8_t* pixels, int num_rows);
+	// Ends the file after all rows have been written.
+	void close();
+
+private:
+	PngWriter(const PngWriter&);
+	PngWriter& operator=(const PngWriter&);
+
+	void write_chunk(const char* type, const std::uint8_t* data, size_t size);
+	void flush_data(bool all);
+
+	class Deflater;
+	std::unique_ptr<Deflater> deflater;
+	std::ofstream file;
+	int width, height;
+	int rows_written;
+	// The last row written, for the "up" filter.
+	std::vector<std::uint8_t> previous_row, filtered_row;
+	// Compressed data not yet written.
+	std::vector<std::uint8_t> data;
+};
+
+// Writes image as a PNG file.
+void write_png(const std::string& filename, const Image& image);
+
+}
+
+#endif
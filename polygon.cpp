@@ -5,77 +5,59 @@
 #include <iostream>
 #include <stdexcept>
 
+#include "number_parser.h"
 #include "polygon.h"
-#include "svg_file.h"
 
 namespace rapidsvg {
 
-void Polygon::parse_style_entry(char* style)
+void Polygon::parse_points(char* points)
 {
-	using namespace std;
-
-	char* name = style;
-	char* value = style;
-	while (*(++style)) {
-		if (*style == ':') {
-			*style = '\0';
-			value = style + 1;
+	// Points grow in place, so their exact number is reserved up front.
+	this->points.reserve(this->points.size() + count_numbers(points) / 2);
+	const char* ptr = points;
+	std::pair<float, float> point;
+	while (true) {
+		ptr = skip_separators(ptr);
+		if (!parse_number(&ptr, &point.first)) {
 			break;
 		}
-	}
-
-	if (strcmp(name, "fill") == 0) {
-		parse_color(value, &this->r, &this->g, &this->b);
+		ptr = skip_separators(ptr);
+		if (!parse_number(&ptr, &point.second)) {
+			break;
+		}
+		this->points.push_back(point);
 	}
 }
 
-void Polygon::parse_style(char* style)
+void Polygon::transform(const Transform& transform)
 {
-	char* start = style;
-	while (true) {
-		if (*style == '\0') {
-			if (*start) {
-				parse_style_entry(start);
-			}
-			return;
-		}
-		else if (*style == ';') {
-			*style = '\0';
-			parse_style_entry(start);
-			start = style + 1;
-		}
-		style++;
+	if (!points.empty()) {
+		// The points are stored as consecutive pairs of floats.
+		transform.apply(&points[0].first, points.size());
 	}
+	stroke_width *= float(transform.scale());
 }
 
-void Polygon::parse_points(char* points)
+Rect Polygon::bounding_box() const
 {
-	char* start = points;
-	int pair_pos = 0;
-	std::pair<float, float> point;
-	while (*points) {
-		if (*points == '\0' || *points == ',' || *points == ' ') {
-			if (*points != '\0') {
-				*points = '\0';
-				points++;
-			}
-
-			if (pair_pos == 0) {
-				point.first = float(std::atof(start));
-				pair_pos = 1;
-			}
-			else {
-				point.second = float(std::atof(start));
-				this->points.push_back(point);
-				pair_pos = 0;
-			}
-
-			start = points;
-		}
-		else {
-			points++;
-		}
+	if (points.empty()) {
+		return Rect();
+	}
+	Rect box(points[0].first, points[0].second,
+	         points[0].first, points[0].second);
+	for (auto& point : points) {
+		box.add(point.first, point.second);
+	}
+	if (stroked) {
+		// Corners are mitered up to the SVG default miter limit of 4, i.e.
+		// up to twice the stroke width from the points.
+		float radius = 2 * stroke_width;
+		box.x_min -= radius;
+		box.y_min -= radius;
+		box.x_max += radius;
+		box.y_max += radius;
 	}
+	return box;
 }
 
 }
\ No newline at end of file
@@ -3,30 +3,48 @@
 #ifndef RAPIDSVG_POLYGON_H
 #define RAPIDSVG_POLYGON_H
 
+#include <cstdint>
 #include <vector>
 
+#include "arena.h"
+#include "rect.h"
+#include "transform.h"
+
 namespace rapidsvg {
 
-// Represents a line in the SVG file.
+// Represents a polygon in the SVG file.
 class Polygon
 {
 public:
-	Polygon() : r(0), g(0), b(0)
+	Polygon() : r(0), g(0), b(0), a(1),
+	            stroked(false), stroke_r(0), stroke_g(0), stroke_b(0), stroke_a(1),
+	            stroke_width(1), order(0)
 	{ }
-	std::vector<std::pair<float, float> > points;
+	PointVector points;
 	float r, g, b;
-
-	// Parses a style string and modifies the polygon.
-	// Also modifies the string itself.
-	void parse_style(char* style);
+	// Opacity of the fill: the alpha of its color times the opacity
+	// properties.
+	float a;
+	// Outline, drawn with mitered corners. Strokes that cover nothing are
+	// dropped when parsed.
+	bool stroked;
+	float stroke_r, stroke_g, stroke_b, stroke_a;
+	float stroke_width;
+	// Position of the element in the document, which sets the order the
+	// elements are drawn in.
+	std::uint32_t order;
+
+	bool has_stroke() const { return stroked; }
 
 	// Parses a string of points and adds them
 	// to the polygon.
-	// Also modifies the string itself.
-	void parse_points(char* style);
+	void parse_points(char* points);
+
+	// Transforms all points.
+	void transform(const Transform& transform);
 
-private:
-	void parse_style_entry(char* style);
+	// Returns the rectangle covered by the polygon and its stroke.
+	Rect bounding_box() const;
 };
 
 }
@@ -0,0 +1,293 @@
+// Petter Strandmark 2013.
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "polygon_levels.h"
+
+namespace rapidsvg {
+
+namespace
+{
+	// Finest tolerance relative to the size of the image.
+	const float finest_tolerance = 1.0f / 4096;
+	// Number of times a simplification that intersects itself is redone
+	// with half the tolerance.
+	const int max_attempts = 3;
+	// Rings with at most this many points are checked for intersections
+	// pair by pair.
+	const size_t max_pairwise_points = 64;
+
+	// Squared distance from p to the segment from a to b.
+	double distance2(const float* p, const float* a, const float* b)
+	{
+		double dx = double(b[0]) - a[0];
+		double dy = double(b[1]) - a[1];
+		double px = double(p[0]) - a[0];
+		double py = double(p[1]) - a[1];
+		double length2 = dx * dx + dy * dy;
+		double t = length2 > 0 ? (px * dx + py * dy) / length2 : 0;
+		t = std::max(0.0, std::min(1.0, t));
+		double ex = px - t * dx;
+		double ey = py - t * dy;
+		return ex * ex + ey * ey;
+	}
+
+	// Simplifies the closed ring of num_points points xy with
+	// Douglas-Peucker. The ring is split at its first point and the point
+	// furthest from it. At least three points are kept.
+	void douglas_peucker(const float* xy, size_t num_points, float tolerance,
+	                     std::vector<float>* simplified)
+	{
+		const size_t n = num_points;
+		std::vector<char> keep(n, 0);
+		size_t far = 0;
+		double far_distance = -1;
+		for (size_t i = 1; i < n; ++i) {
+			double d = distance2(&xy[2 * i], &xy[0], &xy[0]);
+			if (d > far_distance) {
+				far = i;
+				far_distance = d;
+			}
+		}
+		keep[0] = keep[far] = 1;
+
+		// Ranges of points between two kept ones; n is the first point.
+		const double tolerance2 = double(tolerance) * tolerance;
+		std::vector<std::pair<size_t, size_t> > stack;
+		stack.push_back(std::make_pair(size_t(0), far));
+		stack.push_back(std::make_pair(far, n));
+		size_t widest = 0;
+		double widest_distance = -1;
+		while (!stack.empty()) {
+			size_t first = stack.back().first;
+			size_t last = stack.back().second;
+			stack.pop_back();
+			size_t furthest = 0;
+			double furthest_distance = -1;
+			for (size_t i = first + 1; i < last; ++i) {
+				double d = distance2(&xy[2 * i], &xy[2 * first], &xy[2 * (last % n)]);
+				if (d > furthest_distance) {
+					furthest = i;
+					furthest_distance = d;
+				}
+			}
+			if (furthest_distance > widest_distance) {
+				widest = furthest;
+				widest_distance = furthest_distance;
+			}
+			if (furthest_distance > tolerance2) {
+				keep[furthest] = 1;
+				stack.push_back(std::make_pair(first, furthest));
+				stack.push_back(std::make_pair(furthest, last));
+			}
+		}
+		if (std::count(keep.begin(), keep.end(), 1) < 3 && widest_distance >= 0) {
+			keep[widest] = 1;
+		}
+
+		simplified->clear();
+		for (size_t i = 0; i < n; ++i) {
+			if (keep[i]) {
+				simplified->push_back(xy[2 * i]);
+				simplified->push_back(xy[2 * i + 1]);
+			}
+		}
+	}
+
+	int orientation(const float* a, const float* b, const float* c)
+	{
+		double turn = (double(b[0]) - a[0]) * (double(c[1]) - a[1]) -
+		              (double(b[1]) - a[1]) * (double(c[0]) - a[0]);
+		return (turn > 0) - (turn < 0);
+	}
+
+	bool on_segment(const float* a, const float* b, const float* p)
+	{
+		return std::min(a[0], b[0]) <= p[0] && p[0] <= std::max(a[0], b[0]) &&
+		       std::min(a[1], b[1]) <= p[1] && p[1] <= std::max(a[1], b[1]);
+	}
+
+	bool segments_intersect(const float* a, const float* b,
+	                        const float* c, const float* d)
+	{
+		int o1 = orientation(a, b, c);
+		int o2 = orientation(a, b, d);
+		int o3 = orientation(c, d, a);
+		int o4 = orientation(c, d, b);
+		if (o1 != o2 && o3 != o4) {
+			return true;
+		}
+		return (o1 == 0 && on_segment(a, b, c)) || (o2 == 0 && on_segment(a, b, d)) ||
+		       (o3 == 0 && on_segment(c, d, a)) || (o4 == 0 && on_segment(c, d, b));
+	}
+
+	// Whether segments i and j of a ring of n points intersect, ignoring
+	// the point shared by neighboring segments.
+	bool ring_segments_intersect(const float* xy, size_t n, size_t i, size_t j)
+	{
+		if (i == j || (i + 1) % n == j || (j + 1) % n == i) {
+			return false;
+		}
+		return segments_intersect(&xy[2 * i], &xy[2 * ((i + 1) % n)],
+		                          &xy[2 * j], &xy[2 * ((j + 1) % n)]);
+	}
+
+	// Whether the closed ring does not intersect itself. Large rings are
+	// checked with a grid of about one segment per cell.
+	bool is_simple(const float* xy, size_t num_points)
+	{
+		const size_t n = num_points;
+		if (n < 4) {
+			return true;
+		}
+		if (n <= max_pairwise_points) {
+			for (size_t i = 0; i < n; ++i) {
+				for (size_t j = i + 2; j < n; ++j) {
+					if (ring_segments_intersect(xy, n, i, j)) {
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+
+		float x_min = xy[0], x_max = xy[0], y_min = xy[1], y_max = xy[1];
+		for (size_t i = 1; i < n; ++i) {
+			x_min = std::min(x_min, xy[2 * i]);
+			x_max = std::max(x_max, xy[2 * i]);
+			y_min = std::min(y_min, xy[2 * i + 1]);
+			y_max = std::max(y_max, xy[2 * i + 1]);
+		}
+		const int side = std::max(1, int(std::sqrt(double(n))));
+		float cell_width = std::max(x_max - x_min, 1e-30f) / side;
+		float cell_height = std::max(y_max - y_min, 1e-30f) / side;
+		auto cell_x = [&](float x) { return std::min(side - 1, int((x - x_min) / cell_width)); };
+		auto cell_y = [&](float y) { return std::min(side - 1, int((y - y_min) / cell_height)); };
+
+		// The segments overlapping every cell, by their bounding boxes.
+		std::vector<std::vector<std::uint32_t> > cells(size_t(side) * side);
+		for (size_t i = 0; i < n; ++i) {
+			const float* a = &xy[2 * i];
+			const float* b = &xy[2 * ((i + 1) % n)];
+			for (int y = cell_y(std::min(a[1], b[1])); y <= cell_y(std::max(a[1], b[1])); ++y) {
+				for (int x = cell_x(std::min(a[0], b[0])); x <= cell_x(std::max(a[0], b[0])); ++x) {
+					cells[size_t(y) * side + x].push_back(std::uint32_t(i));
+				}
+			}
+		}
+		for (auto& cell : cells) {
+			for (size_t k = 0; k < cell.size(); ++k) {
+				for (size_t l = k + 1; l < cell.size(); ++l) {
+					if (ring_segments_intersect(xy, n, cell[k], cell[l])) {
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	}
+}
+
+const size_t PolygonLevels::min_points;
+const int PolygonLevels::num_levels;
+
+const float* PolygonLevels::Level::polygon_points(const std::vector<Polygon>& polygons,
+                                                  size_t i, size_t* num_points) const
+{
+	if (i + 1 >= starts.size() || starts[i] == starts[i + 1]) {
+		*num_points = polygons[i].points.size();
+		return polygons[i].points.empty() ? 0 : &polygons[i].points[0].first;
+	}
+	*num_points = starts[i + 1] - starts[i];
+	return &points[2 * size_t(starts[i])];
+}
+
+void PolygonLevels::clear()
+{
+	levels.clear();
+}
+
+void PolygonLevels::build(const std::vector<Polygon>& polygons, float extent)
+{
+	levels.clear();
+	std::vector<int> large;
+	for (size_t i = 0; i < polygons.size(); ++i) {
+		if (polygons[i].points.size() >= min_points) {
+			large.push_back(int(i));
+		}
+	}
+	const int num_large = int(large.size());
+
+	// Polygons that already intersect themselves are simplified without
+	// checking.
+	std::vector<char> simple(num_large);
+	#pragma omp parallel for schedule(dynamic)
+	for (int k = 0; k < num_large; ++k) {
+		const Polygon& polygon = polygons[large[k]];
+		simple[k] = is_simple(&polygon.points[0].first, polygon.points.size());
+	}
+
+	std::vector<std::vector<float> > simplified(num_large);
+	levels.reserve(num_levels);
+	for (int l = 0; l < num_levels; ++l) {
+		levels.push_back(Level());
+		Level& level = levels.back();
+		level.tolerance = extent * finest_tolerance * std::pow(4.0f, float(l));
+		const Level* finer = l > 0 ? &levels[l - 1] : 0;
+
+		#pragma omp parallel for schedule(dynamic)
+		for (int k = 0; k < num_large; ++k) {
+			const Polygon& polygon = polygons[large[k]];
+			const float* xy = &polygon.points[0].first;
+			size_t n = polygon.points.size();
+			std::vector<float>& result = simplified[k];
+			float tolerance = level.tolerance;
+			bool accepted = false;
+			for (int attempt = 0; attempt < max_attempts && !accepted; ++attempt) {
+				douglas_peucker(xy, n, tolerance, &result);
+				accepted = !simple[k] || is_simple(&result[0], result.size() / 2);
+				tolerance /= 2;
+			}
+			if (!accepted) {
+				// The finer level is used, which may be the original.
+				size_t finer_points = 0;
+				const float* finer_xy = finer ? finer->polygon_points(polygons, large[k], &finer_points)
+				                              : xy;
+				result.assign(finer_xy, finer_xy + 2 * (finer ? finer_points : n));
+			}
+			if (result.size() / 2 >= n) {
+				result.clear();
+			}
+		}
+
+		level.starts.assign(polygons.size() + 1, 0);
+		size_t num_points = 0;
+		for (int k = 0; k < num_large; ++k) {
+			num_points += simplified[k].size() / 2;
+			level.starts[large[k] + 1] = std::uint32_t(num_points);
+		}
+		// Polygons that are not simplified have empty ranges.
+		for (size_t i = 0; i < polygons.size(); ++i) {
+			level.starts[i + 1] = std::max(level.starts[i + 1], level.starts[i]);
+		}
+		level.points.reserve(2 * num_points);
+		for (int k = 0; k < num_large; ++k) {
+			level.points.insert(level.points.end(), simplified[k].begin(), simplified[k].end());
+		}
+	}
+}
+
+int PolygonLevels::level_for(float tolerance) const
+{
+	int level = -1;
+	for (int l = 0; l < int(levels.size()); ++l) {
+		if (levels[l].tolerance <= tolerance) {
+			level = l;
+		}
+	}
+	return level;
+}
+
+}
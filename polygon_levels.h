@@ -0,0 +1,61 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_POLYGON_LEVELS_H
+#define RAPIDSVG_POLYGON_LEVELS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "polygon.h"
+
+namespace rapidsvg {
+
+// Simplified copies of the polygons with many points, for drawing them
+// when zoomed out. Every level is simplified from the original polygons
+// with Douglas-Peucker, keeping every removed point within the tolerance
+// of the level. A simplification that would make a polygon without
+// self-intersections intersect itself is redone with a smaller tolerance
+// and otherwise replaced by the one of the finer level.
+class PolygonLevels
+{
+public:
+	// Polygons with fewer points are never simplified.
+	static const size_t min_points = 32;
+	// Number of levels. The tolerance grows four times from one level to
+	// the next.
+	static const int num_levels = 4;
+
+	class Level
+	{
+	public:
+		float tolerance;
+		// Points of the simplified polygons as x0, y0, x1, y1, ... Polygon
+		// i has the points [starts[i], starts[i + 1]), or no points if it
+		// is drawn as it is at this level.
+		std::vector<float> points;
+		std::vector<std::uint32_t> starts;
+
+		// The points of polygon i at this level. Polygons added after the
+		// levels were built are drawn as they are.
+		const float* polygon_points(const std::vector<Polygon>& polygons, size_t i,
+		                            size_t* num_points) const;
+	};
+
+	// In order of increasing tolerance.
+	std::vector<Level> levels;
+
+	bool empty() const { return levels.empty(); }
+	void clear();
+
+	// Simplifies the polygons in parallel. The tolerance of the finest
+	// level is extent / 4096, where extent is the size of the image.
+	void build(const std::vector<Polygon>& polygons, float extent);
+
+	// Index of the coarsest level with at most the given tolerance, or -1
+	// if the polygons should be drawn as they are.
+	int level_for(float tolerance) const;
+};
+
+}
+
+#endif
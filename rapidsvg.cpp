@@ -1,6 +1,8 @@
 // Petter Strandmark 2013.
 
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <iomanip>
@@ -30,8 +32,14 @@
 #include <GL/glut.h> // glut.h includes gl.h.
 #endif
 
+#include "file_watcher.h"
+#include "image_export.h"
 #include "line.h"
+#include "render_batch.h"
+#include "scene_store.h"
 #include "svg_file.h"
+#include "tile_cache.h"
+#include "tile_pyramid.h"
 
 
 namespace rapidsvg {
@@ -39,11 +47,70 @@ namespace rapidsvg {
 // SVG file currently opened.
 SVGFile svg_file;
 
+// Watches the file for appended elements in follow mode.
+FileWatcher* file_watcher = 0;
+// How often the watcher is checked, in milliseconds.
+const unsigned int follow_interval = 200;
+
+// Scene store viewed instead of svg_file, if any.
+SceneStore* scene_store = 0;
+
+// Tiles of svg_file drawn instead of its triangles, if any.
+TileCache* tile_cache = 0;
+// How often the viewer looks for rendered tiles while tiles are being
+// rendered, in milliseconds.
+const unsigned int tile_interval = 50;
+bool tile_timer_running = false;
+
+// Triangles of svg_file. The curve batches hold the paths and the
+// ellipses, which depend on the flattening tolerance and are rebuilt when
+// it changes.
+TriangleBatch fill_batch, stroke_batch;
+TriangleBatch curve_fill_batch, curve_stroke_batch;
+bool batches_valid = false;
+float path_tolerance = 0;
+// Triangles of the polygons of svg_file for every level of detail of
+// svg_file.polygon_levels, built when first drawn. The first pair holds
+// the polygons as they are.
+std::vector<TriangleBatch> polygon_fill_batches, polygon_stroke_batches;
+std::vector<bool> polygon_batches_built;
+// Translucent triangles of all the batches above in order of depth, which
+// is the order they are blended in, and the level of detail of the
+// polygons among them. Merged again when a batch is rebuilt.
+TriangleBatch::Triangles translucent_triangles;
+int translucent_level = -1;
+
+// Triangles of a symbol of svg_file in its own coordinates, drawn once
+// for every use with the transform of the use.
+struct SymbolBatches
+{
+	TriangleBatch fills, strokes;
+	// Largest scale of the uses, which sets the flattening tolerance.
+	float max_scale;
+	Rect bounding_box;
+};
+std::vector<SymbolBatches> symbol_batches;
+// Depth and bounding box of every use of a symbol.
+std::vector<float> use_depths;
+std::vector<Rect> use_boxes;
+// Indices of the chunks of svg_file.indexed_lines in document order.
+std::vector<size_t> chunk_order;
+
 // Part of the SVG currently being viewed.
 float view_left   = 0.0f;
 float view_right  = 1.0f;
 float view_bottom = 0.0f;
 float view_top    = 1.0f;
+// Every element drawn has its own depth in [0, depth_range).
+float depth_range = 1.0f;
+
+// Projects the view onto the window. Elements with larger depths are
+// nearer.
+void set_projection()
+{
+	glLoadIdentity();
+	glOrtho(view_left, view_right, view_bottom, view_top, -depth_range, 1.0);
+}
 
 void center_display(int view_x, int view_y, float radius_x, float radius_y)
 {
@@ -58,8 +125,7 @@ void center_display(int view_x, int view_y, float radius_x, float radius_y)
 	view_bottom = y - radius_y;
 	view_top    = y + radius_y;
 
-	glLoadIdentity ();
-	glOrtho(view_left, view_right, view_bottom, view_top, 0.0, 1.0);
+	set_projection();
 	glutPostRedisplay();
 }
 
@@ -73,8 +139,7 @@ void center_display_zoom(float radius_x, float radius_y)
 	view_bottom = y - radius_y;
 	view_top    = y + radius_y;
 
-	glLoadIdentity ();
-	glOrtho(view_left, view_right, view_bottom, view_top, 0.0, 1.0);
+	set_projection();
 	glutPostRedisplay();
 }
 
@@ -91,8 +156,7 @@ void center_display_delta(int delta_view_x, int delta_view_y)
 	view_bottom += dy;
 	view_top    += dy;
 
-	glLoadIdentity ();
-	glOrtho(view_left, view_right, view_bottom, view_top, 0.0, 1.0);
+	set_projection();
 	glutPostRedisplay();
 }
 
@@ -144,32 +208,384 @@ void keyboard (unsigned char key, int x, int y)
 {
 	//std::cerr << "key=" << int(key) << " x=" << x << " y=" << y << '\n';
 
-	if (key == 'r') {
+	if (key == 'r' && !scene_store) {
+		if (tile_cache) {
+			tile_cache->invalidate();
+		}
 		svg_file.reload();
+		batches_valid = false;
 		glutPostRedisplay();
 	}
 }
 
-// Draws a line between (x1,y1) - (x2,y2) with a start thickness of t1 and
-// end thickness t2.
-void draw_line(float x1, float y1, float x2, float y2, float t1, float t2)
+void follow_timer(int value)
+{
+	if (file_watcher->changed()) {
+		// The tiles are rendered from svg_file, which must not change
+		// while they are, so they are dropped only when it will.
+		bool tiles_dropped = false;
+		auto drop_tiles = [&tiles_dropped]
+		{
+			if (tile_cache) {
+				tile_cache->invalidate();
+				tiles_dropped = true;
+			}
+		};
+		if (svg_file.load_appended(drop_tiles) || tiles_dropped) {
+			batches_valid = false;
+			glutPostRedisplay();
+		}
+	}
+	glutTimerFunc(follow_interval, follow_timer, 0);
+}
+
+void tile_timer(int value)
+{
+	tile_timer_running = false;
+	glutPostRedisplay();
+}
+
+void prefetch_idle()
+{
+	if (!scene_store->prefetch()) {
+		glutIdleFunc(0);
+	}
+}
+
+// Draws the vertices from first to end of the triangles.
+void draw_triangles(const TriangleBatch::Triangles& triangles, size_t first, size_t end)
+{
+	if (first >= end) {
+		return;
+	}
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, &triangles.vertices[0]);
+	glColorPointer(4, GL_UNSIGNED_BYTE, 0, &triangles.colors[0]);
+	glDrawArrays(GL_TRIANGLES, GLint(first), GLsizei(end - first));
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+void draw_triangles(const TriangleBatch::Triangles& triangles)
+{
+	draw_triangles(triangles, 0, triangles.num_vertices());
+}
+
+// The first vertex from first on of triangles given in order of depth
+// whose depth is at least depth.
+size_t first_vertex_at(const TriangleBatch::Triangles& triangles, float depth, size_t first)
+{
+	size_t begin = first / 3;
+	size_t end = triangles.num_vertices() / 3;
+	while (begin < end) {
+		size_t middle = begin + (end - begin) / 2;
+		if (triangles.vertices[9 * middle + 2] < depth) {
+			begin = middle + 1;
+		}
+		else {
+			end = middle;
+		}
+	}
+	return 3 * begin;
+}
+
+// The part of the SVG in view.
+Rect current_view()
+{
+	using namespace std;
+	return Rect(min(view_left, view_right), min(view_bottom, view_top),
+	            max(view_left, view_right), max(view_bottom, view_top));
+}
+
+// Whether use i of a symbol is in view and has opaque or translucent
+// triangles.
+bool use_drawn(size_t i, bool opaque, const Rect& view)
+{
+	const SymbolBatches& symbol = symbol_batches[svg_file.uses[i].symbol];
+	bool has_triangles = opaque ?
+		symbol.fills.opaque.num_vertices() + symbol.strokes.opaque.num_vertices() > 0 :
+		symbol.fills.translucent.num_vertices() + symbol.strokes.translucent.num_vertices() > 0;
+	return has_triangles && use_boxes[i].intersects(view);
+}
+
+// Draws the opaque or the translucent triangles of the symbol for use i,
+// moved into place and to the depth of the use by the model view matrix.
+void draw_use(size_t i, bool opaque)
+{
+	const Transform& t = svg_file.uses[i].transform;
+	const SymbolBatches& symbol = symbol_batches[svg_file.uses[i].symbol];
+	GLfloat matrix[16] = {GLfloat(t.a), GLfloat(t.b), 0, 0,
+	                      GLfloat(t.c), GLfloat(t.d), 0, 0,
+	                      0, 0, 1, 0,
+	                      GLfloat(t.e), GLfloat(t.f), use_depths[i], 1};
+	glPushMatrix();
+	glMultMatrixf(matrix);
+	if (opaque) {
+		draw_triangles(symbol.strokes.opaque);
+		draw_triangles(symbol.fills.opaque);
+	}
+	else {
+		draw_triangles(symbol.fills.translucent);
+		draw_triangles(symbol.strokes.translucent);
+	}
+	glPopMatrix();
+}
+
+// Whether a chunk of svg_file.indexed_lines is in view and opaque or
+// translucent.
+bool chunk_drawn(const IndexedLines::Chunk& chunk, bool opaque, const Rect& view)
+{
+	const IndexedLines::Style& style = svg_file.indexed_lines.styles[chunk.style];
+	uint8_t color[4];
+	color_bytes(style.r, style.g, style.b, style.a, color);
+	return color[3] != 0 && (color[3] == 255) == opaque &&
+	       chunk.bounding_box.intersects(view);
+}
+
+// Draws the lines of a chunk of svg_file.indexed_lines. Lines narrower
+// than max_hairline_width pixels are drawn by OpenGL from the shared end
+// points, at the depth of the last line of the chunk; wider ones are made
+// into triangles like other lines.
+const float max_hairline_width = 2.0f;
+void draw_chunk(const IndexedLines::Chunk& chunk, bool opaque, float pixels_per_unit)
+{
+	using namespace std;
+
+	const IndexedLines& lines = svg_file.indexed_lines;
+	static TriangleBatch wide_lines;
+	static std::vector<Line> chunk_lines;
+
+	const IndexedLines::Style& style = lines.styles[chunk.style];
+	float pixel_width = style.width * pixels_per_unit;
+	if (pixel_width < max_hairline_width) {
+		uint8_t color[4];
+		color_bytes(style.r, style.g, style.b, style.a, color);
+		glLineWidth(max(pixel_width, 1.0f));
+		glColor4ubv(color);
+		glPushMatrix();
+		glTranslatef(0, 0, stroke_depth(chunk.order + (chunk.end - chunk.first) - 1));
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glVertexPointer(2, GL_FLOAT, 0, &lines.vertices[0]);
+		glDrawElements(GL_LINES, GLsizei(2 * (chunk.end - chunk.first)),
+		               GL_UNSIGNED_INT, &lines.indices[2 * chunk.first]);
+		glDisableClientState(GL_VERTEX_ARRAY);
+		glPopMatrix();
+	}
+	else {
+		chunk_lines.clear();
+		for (uint32_t i = chunk.first; i < chunk.end; ++i) {
+			chunk_lines.push_back(lines.line(i));
+		}
+		wide_lines.clear();
+		add_lines(chunk_lines, &wide_lines);
+		draw_triangles(opaque ? wide_lines.opaque : wide_lines.translucent);
+	}
+}
+
+// Draws the batches and the uses of symbols and chunks of indexed lines of
+// svg_file. Opaque triangles are drawn first without blending, and the
+// depth test keeps the nearest. Translucent triangles are then blended on
+// top, behind the opaque ones covering them, in order of depth: those of
+// the batches from translucent, which holds them merged, with every use and
+// chunk drawn between the triangles before and after it. Nothing else is
+// drawn at the depths of a use or a chunk.
+void draw_layers(const std::vector<const TriangleBatch*>& batches,
+                 const TriangleBatch::Triangles& translucent)
 {
-	float angle = std::atan2(y2 - y1, x2 - x1);
-	float t2sina1 = t1 / 2 * std::sin(angle);
-	float t2cosa1 = t1 / 2 * std::cos(angle);
-	float t2sina2 = t2 / 2 * std::sin(angle);
-	float t2cosa2 = t2 / 2 * std::cos(angle);
-
-	glBegin(GL_TRIANGLES);
-	glVertex2f(x1 + t2sina1, y1 - t2cosa1);
-	glVertex2f(x2 + t2sina2, y2 - t2cosa2);
-	glVertex2f(x2 - t2sina2, y2 + t2cosa2);
-	glVertex2f(x2 - t2sina2, y2 + t2cosa2);
-	glVertex2f(x1 - t2sina1, y1 + t2cosa1);
-	glVertex2f(x1 + t2sina1, y1 - t2cosa1);
+	const IndexedLines& lines = svg_file.indexed_lines;
+	Rect view = current_view();
+	float window_width = float(glutGet(GLUT_WINDOW_WIDTH));
+	float pixels_per_unit = window_width / (view.x_max - view.x_min);
+
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+	glDisable(GL_BLEND);
+	glDepthMask(GL_TRUE);
+	for (auto batch : batches) {
+		draw_triangles(batch->opaque);
+	}
+	for (size_t i = 0; i < svg_file.uses.size(); ++i) {
+		if (use_drawn(i, true, view)) {
+			draw_use(i, true);
+		}
+	}
+	for (auto& chunk : lines.chunks) {
+		if (chunk_drawn(chunk, true, view)) {
+			draw_chunk(chunk, true, pixels_per_unit);
+		}
+	}
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthMask(GL_FALSE);
+	// The uses are in document order and the chunks are visited so.
+	size_t drawn = 0;
+	size_t u = 0;
+	size_t c = 0;
+	while (u < svg_file.uses.size() || c < chunk_order.size()) {
+		const IndexedLines::Chunk* chunk = c < chunk_order.size() ?
+		                                   &lines.chunks[chunk_order[c]] : 0;
+		bool use_next = !chunk || (u < svg_file.uses.size() &&
+		                           svg_file.uses[u].order < chunk->order);
+		if (use_next) {
+			if (use_drawn(u, false, view)) {
+				size_t end = first_vertex_at(translucent, use_depths[u], drawn);
+				draw_triangles(translucent, drawn, end);
+				drawn = end;
+				draw_use(u, false);
+			}
+			u++;
+		}
+		else {
+			if (chunk_drawn(*chunk, false, view)) {
+				size_t end = first_vertex_at(translucent, stroke_depth(chunk->order), drawn);
+				draw_triangles(translucent, drawn, end);
+				drawn = end;
+				draw_chunk(*chunk, false, pixels_per_unit);
+			}
+			c++;
+		}
+	}
+	draw_triangles(translucent, drawn, translucent.num_vertices());
+	glDepthMask(GL_TRUE);
+	glDisable(GL_BLEND);
+	glDisable(GL_DEPTH_TEST);
+}
+
+// Tolerance for flattening curves at the current zoom, about a quarter of
+// a pixel. It is rounded down to a power of two so that the paths are not
+// flattened again for every small change of zoom.
+float current_path_tolerance()
+{
+	float window_width = float(glutGet(GLUT_WINDOW_WIDTH));
+	float units_per_pixel = std::abs(view_right - view_left) / window_width;
+	return std::pow(2.0f, std::floor(std::log2(units_per_pixel / 4)));
+}
+
+// Draws the tile with the given key, or the part of the nearest rendered
+// tile above it covering the same region, if any. Textures are made for
+// tiles when first drawn.
+void draw_tile(const TileKey& key)
+{
+	TileKey source = key;
+	Tile* tile = tile_cache->find(source);
+	while (!tile && source.level > 0) {
+		source = source.parent();
+		tile = tile_cache->find(source);
+	}
+	if (!tile) {
+		return;
+	}
+
+	if (tile->texture == 0) {
+		glGenTextures(1, &tile->texture);
+		glBindTexture(GL_TEXTURE_2D, tile->texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tile->image.width, tile->image.height, 0,
+		             GL_RGBA, GL_UNSIGNED_BYTE, &tile->image.pixels[0]);
+	}
+	else {
+		glBindTexture(GL_TEXTURE_2D, tile->texture);
+	}
+
+	// The image rows go from the top, as the y axis of the SVG.
+	Rect region = tile_cache->tile_region(key);
+	Rect source_region = tile_cache->tile_region(source);
+	float width = source_region.x_max - source_region.x_min;
+	float height = source_region.y_max - source_region.y_min;
+	float u0 = (region.x_min - source_region.x_min) / width;
+	float u1 = (region.x_max - source_region.x_min) / width;
+	float v0 = (region.y_min - source_region.y_min) / height;
+	float v1 = (region.y_max - source_region.y_min) / height;
+	glBegin(GL_QUADS);
+	glTexCoord2f(u0, v0);
+	glVertex2f(region.x_min, region.y_min);
+	glTexCoord2f(u1, v0);
+	glVertex2f(region.x_max, region.y_min);
+	glTexCoord2f(u1, v1);
+	glVertex2f(region.x_max, region.y_max);
+	glTexCoord2f(u0, v1);
+	glVertex2f(region.x_min, region.y_max);
 	glEnd();
 }
 
+// Draws the tiles in view at the level with at least one tile pixel per
+// window pixel. The tiles in view are requested first, then the ones
+// around the view, the ones of the level above and the ones of the level
+// below at the center of the view, so that panning and zooming find
+// them rendered.
+void draw_tiles()
+{
+	using namespace std;
+
+	tile_cache->collect();
+	auto& released = tile_cache->released_textures;
+	if (!released.empty()) {
+		glDeleteTextures(GLsizei(released.size()), &released[0]);
+		released.clear();
+	}
+
+	Rect view(min(view_left, view_right), min(view_bottom, view_top),
+	          max(view_left, view_right), max(view_bottom, view_top));
+	float window_width = float(glutGet(GLUT_WINDOW_WIDTH));
+	int level = tile_cache->level_for(window_width / (view.x_max - view.x_min));
+	int num_tiles = TileCache::tiles_per_side(level);
+	Rect first_tile = tile_cache->tile_region(TileKey(level, 0, 0));
+	double tile_extent = first_tile.x_max - first_tile.x_min;
+	auto tile_index = [&](float coordinate)
+	{
+		double index = std::floor(coordinate / tile_extent);
+		return int(max(0.0, min(double(num_tiles - 1), index)));
+	};
+	int x0 = tile_index(view.x_min);
+	int y0 = tile_index(view.y_min);
+	int x1 = tile_index(view.x_max);
+	int y1 = tile_index(view.y_max);
+
+	vector<TileKey> wanted;
+	glEnable(GL_TEXTURE_2D);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+	for (int y = y0; y <= y1; ++y) {
+		for (int x = x0; x <= x1; ++x) {
+			wanted.push_back(TileKey(level, x, y));
+			draw_tile(wanted.back());
+		}
+	}
+	glDisable(GL_TEXTURE_2D);
+
+	for (int y = max(0, y0 - 1); y <= min(num_tiles - 1, y1 + 1); ++y) {
+		for (int x = max(0, x0 - 1); x <= min(num_tiles - 1, x1 + 1); ++x) {
+			if (x < x0 || x > x1 || y < y0 || y > y1) {
+				wanted.push_back(TileKey(level, x, y));
+			}
+		}
+	}
+	if (level > 0) {
+		for (int y = y0 / 2; y <= y1 / 2; ++y) {
+			for (int x = x0 / 2; x <= x1 / 2; ++x) {
+				wanted.push_back(TileKey(level - 1, x, y));
+			}
+		}
+	}
+	if (level < TileCache::max_level) {
+		int center_x = tile_index((view.x_min + view.x_max) / 2);
+		int center_y = tile_index((view.y_min + view.y_max) / 2);
+		for (int k = 0; k < 4; ++k) {
+			wanted.push_back(TileKey(level + 1, 2 * center_x + k % 2, 2 * center_y + k / 2));
+		}
+	}
+	tile_cache->request(wanted);
+
+	if (tile_cache->busy() && !tile_timer_running) {
+		tile_timer_running = true;
+		glutTimerFunc(tile_interval, tile_timer, 0);
+	}
+}
+
 void display(void)
 {
 	using namespace std;
@@ -178,31 +594,151 @@ void display(void)
 	double start_time, end_time;
 	start_time = ::omp_get_wtime();
 
-	glClear(GL_COLOR_BUFFER_BIT);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	glDisable(GL_TEXTURE_2D);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glEnable( GL_LINE_SMOOTH );
 	glEnable( GL_POLYGON_SMOOTH );
 	glHint( GL_LINE_SMOOTH_HINT, GL_NICEST );
 	glHint( GL_POLYGON_SMOOTH_HINT, GL_NICEST );
 
-	for (auto& polygon : svg_file.polygons) {
-		glBegin(GL_POLYGON);
-		glColor3d(polygon.r, polygon.g, polygon.b);
-		for (auto& point : polygon.points) {
-			glVertex2d(point.first, point.second);
+	if (scene_store) {
+		scene_store->update_view(Rect(min(view_left, view_right),
+		                              min(view_bottom, view_top),
+		                              max(view_left, view_right),
+		                              max(view_bottom, view_top)));
+		static TriangleBatch fills, strokes;
+		static TriangleBatch::Triangles translucent;
+		fills.clear();
+		strokes.clear();
+		float tolerance = current_path_tolerance();
+		for (auto tile : scene_store->visible_tiles()) {
+			add_polygons(tile->polygons, &fills, &strokes);
+			add_rectangles(tile->rectangles, &fills, &strokes);
+			add_ellipses(tile->ellipses, tolerance, &fills, &strokes);
+			add_paths(tile->paths, tolerance, &fills, &strokes);
+			add_polylines(tile->polylines, &fills, &strokes);
+			add_lines(tile->lines, &strokes);
 		}
-		glEnd();
+		std::vector<const TriangleBatch*> batches;
+		batches.push_back(&fills);
+		batches.push_back(&strokes);
+		merge_translucent(batches, &translucent);
+		depth_range = 2.0f * scene_store->get_num_orders() + 1;
+		set_projection();
+		draw_layers(batches, translucent);
+		glutIdleFunc(prefetch_idle);
 	}
-
-	for (auto& line : svg_file.lines) {
-		glColor3d(line.r, line.g, line.b);
-		draw_line(line.x1, line.y1, line.x2, line.y2, line.width, line.width);
+	else if (tile_cache) {
+		set_projection();
+		draw_tiles();
+	}
+	else {
+		// Every element is drawn at the depths of its position in
+		// document order, whatever batch it is in.
+		if (!batches_valid) {
+			// The polygons are drawn first, from batches of their own.
+			const size_t num_levels = svg_file.polygon_levels.levels.size() + 1;
+			polygon_fill_batches.resize(num_levels);
+			polygon_stroke_batches.resize(num_levels);
+			polygon_batches_built.assign(num_levels, false);
+			fill_batch.clear();
+			stroke_batch.clear();
+			add_rectangles(svg_file.rectangles, &fill_batch, &stroke_batch);
+			add_polylines(svg_file.polylines, &fill_batch, &stroke_batch);
+			add_lines(svg_file.lines, &stroke_batch);
+
+			const std::vector<IndexedLines::Chunk>& chunks = svg_file.indexed_lines.chunks;
+			chunk_order.resize(chunks.size());
+			for (size_t k = 0; k < chunks.size(); ++k) {
+				chunk_order[k] = k;
+			}
+			sort(chunk_order.begin(), chunk_order.end(),
+				[&chunks](size_t a, size_t b)
+				{
+					return chunks[a].order < chunks[b].order;
+				});
+
+			// The elements of a symbol are drawn at the depths of the
+			// positions the use takes.
+			symbol_batches.resize(svg_file.symbols.size());
+			for (size_t s = 0; s < symbol_batches.size(); ++s) {
+				symbol_batches[s].max_scale = 0;
+				symbol_batches[s].bounding_box = svg_file.symbols[s].bounding_box();
+			}
+			use_depths.resize(svg_file.uses.size());
+			use_boxes.resize(svg_file.uses.size());
+			for (size_t i = 0; i < svg_file.uses.size(); ++i) {
+				const SymbolUse& use = svg_file.uses[i];
+				SymbolBatches& batches = symbol_batches[use.symbol];
+				batches.max_scale = std::max(batches.max_scale, float(use.transform.scale()));
+				use_boxes[i] = use.bounding_box(batches.bounding_box);
+				use_depths[i] = fill_depth(use.order);
+			}
+			depth_range = 2.0f * svg_file.num_orders() + 1;
+			path_tolerance = 0;
+			translucent_level = -1;
+			batches_valid = true;
+		}
+		float tolerance = current_path_tolerance();
+		// Polygons are simplified by at most half a pixel.
+		int level = svg_file.polygon_levels.level_for(2 * tolerance) + 1;
+		TriangleBatch& polygon_fills = polygon_fill_batches[level];
+		TriangleBatch& polygon_strokes = polygon_stroke_batches[level];
+		if (!polygon_batches_built[level]) {
+			polygon_fills.clear();
+			polygon_strokes.clear();
+			if (level == 0) {
+				add_polygons(svg_file.polygons, &polygon_fills, &polygon_strokes);
+			}
+			else {
+				add_polygons(svg_file.polygons, svg_file.polygon_levels.levels[level - 1],
+				             &polygon_fills, &polygon_strokes);
+			}
+			polygon_batches_built[level] = true;
+		}
+		if (tolerance != path_tolerance) {
+			curve_fill_batch.clear();
+			curve_stroke_batch.clear();
+			add_ellipses(svg_file.ellipses, tolerance,
+			             &curve_fill_batch, &curve_stroke_batch);
+			add_paths(svg_file.paths, tolerance,
+			          &curve_fill_batch, &curve_stroke_batch);
+
+			// Symbols are flattened finely enough for their largest use.
+			for (size_t s = 0; s < symbol_batches.size(); ++s) {
+				const Symbol& symbol = svg_file.symbols[s];
+				SymbolBatches& batches = symbol_batches[s];
+				float symbol_tolerance = batches.max_scale > 0 ?
+				                         tolerance / batches.max_scale : tolerance;
+				batches.fills.clear();
+				batches.strokes.clear();
+				add_polygons(symbol.polygons, &batches.fills, &batches.strokes);
+				add_rectangles(symbol.rectangles, &batches.fills, &batches.strokes);
+				add_ellipses(symbol.ellipses, symbol_tolerance,
+				             &batches.fills, &batches.strokes);
+				add_paths(symbol.paths, symbol_tolerance,
+				          &batches.fills, &batches.strokes);
+				add_polylines(symbol.polylines, &batches.fills, &batches.strokes);
+				add_lines(symbol.lines, &batches.strokes);
+			}
+			path_tolerance = tolerance;
+			translucent_level = -1;
+		}
+		std::vector<const TriangleBatch*> batches;
+		batches.push_back(&polygon_fills);
+		batches.push_back(&polygon_strokes);
+		batches.push_back(&fill_batch);
+		batches.push_back(&stroke_batch);
+		batches.push_back(&curve_fill_batch);
+		batches.push_back(&curve_stroke_batch);
+		if (translucent_level != level) {
+			merge_translucent(batches, &translucent_triangles);
+			translucent_level = level;
+		}
+		set_projection();
+		draw_layers(batches, translucent_triangles);
 	}
-
-	glDisable(GL_BLEND); //restore blending options
 
 	end_time = ::omp_get_wtime();
 	if (first_time) {
@@ -218,30 +754,166 @@ void main_function(int argc, char** argv)
 {
 	using namespace std;
 
-	if (argc <= 1) {
-		svg_file.load("example.svg");
+	string filename = "example.svg";
+	string convert_filename;
+	bool use_store = false;
+	bool use_tiles = false;
+	string export_directory;
+	int max_level = -1;
+	string export_filename;
+	int export_width = 0;
+	size_t memory_budget = 512;
+	bool follow = false;
+	bool use_region = false;
+	Rect region;
+	size_t stride = 1;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--follow") == 0) {
+			follow = true;
+		}
+		else if (strcmp(argv[i], "--region") == 0 && i + 1 < argc) {
+			use_region = true;
+			if (sscanf(argv[++i], "%f,%f,%f,%f", &region.x_min, &region.y_min,
+			                                     &region.x_max, &region.y_max) != 4) {
+				throw runtime_error("--region expects x_min,y_min,x_max,y_max.");
+			}
+		}
+		else if (strcmp(argv[i], "--stride") == 0 && i + 1 < argc) {
+			stride = size_t(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--convert") == 0 && i + 1 < argc) {
+			convert_filename = argv[++i];
+		}
+		else if (strcmp(argv[i], "--remove-duplicates") == 0) {
+			svg_file.options.remove_duplicates = true;
+		}
+		else if (strcmp(argv[i], "--spatial-order") == 0) {
+			svg_file.options.spatial_order = true;
+		}
+		else if (strcmp(argv[i], "--simplify-polygons") == 0) {
+			svg_file.options.simplify_polygons = true;
+		}
+		else if (strcmp(argv[i], "--chain-lines") == 0) {
+			svg_file.options.chain_lines = true;
+		}
+		else if (strcmp(argv[i], "--index-lines") == 0) {
+			svg_file.options.index_lines = true;
+		}
+		else if (strcmp(argv[i], "--lenient") == 0) {
+			svg_file.options.lenient = true;
+		}
+		else if (strcmp(argv[i], "--huge-pages") == 0) {
+			svg_file.options.huge_pages = true;
+		}
+		else if (strcmp(argv[i], "--store") == 0) {
+			use_store = true;
+		}
+		else if (strcmp(argv[i], "--export-tiles") == 0 && i + 1 < argc) {
+			export_directory = argv[++i];
+		}
+		else if (strcmp(argv[i], "--export-image") == 0 && i + 1 < argc) {
+			export_filename = argv[++i];
+		}
+		else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc) {
+			export_width = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--max-level") == 0 && i + 1 < argc) {
+			max_level = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--tiles") == 0) {
+			use_tiles = true;
+		}
+		else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+			memory_budget = size_t(atoi(argv[++i]));
+		}
+		else {
+			filename = argv[i];
+		}
+	}
+
+	if (!convert_filename.empty()) {
+		convert_to_scene_store(filename, convert_filename);
+		return;
+	}
+
+	double svg_width, svg_height;
+	if (use_store) {
+		scene_store = new SceneStore(filename, memory_budget << 20);
+	}
+	else if (follow) {
+		svg_file.load_partial(filename);
+		file_watcher = new FileWatcher(filename);
+	}
+	else if (use_region) {
+		svg_file.load_region(filename, region, stride);
 	}
 	else {
-		svg_file.load(argv[1]);
+		svg_file.load(filename);
+	}
+
+	if (!export_directory.empty()) {
+		if (max_level < 0) {
+			max_level = default_max_level(svg_file);
+		}
+		double start_time = ::omp_get_wtime();
+		size_t num_tiles = export_tile_pyramid(svg_file, export_directory, max_level);
+		double end_time = ::omp_get_wtime();
+		std::cerr << "Exported " << num_tiles << " tiles of levels 0 to " << max_level
+		          << " in " << end_time - start_time << " seconds.\n";
+		return;
+	}
+
+	if (!export_filename.empty()) {
+		if (export_width <= 0) {
+			export_width = int(std::ceil(svg_file.get_width()));
+		}
+		double start_time = ::omp_get_wtime();
+		int export_height = export_image(svg_file, export_filename, export_width);
+		double end_time = ::omp_get_wtime();
+		std::cerr << "Exported a " << export_width << " x " << export_height << " image in "
+		          << end_time - start_time << " seconds.\n";
+		return;
+	}
+
+	if (use_tiles && !scene_store) {
+		tile_cache = new TileCache(svg_file, memory_budget << 20);
+	}
+
+	if (scene_store) {
+		svg_width = scene_store->get_width();
+		svg_height = scene_store->get_height();
+	}
+	else {
+		svg_width = svg_file.get_width();
+		svg_height = svg_file.get_height();
 	}
 
 	// From the beginning, look at the entire SVG.
 	view_left   = 0;
-	view_right  = svg_file.get_width();
-	view_bottom = svg_file.get_height();
+	view_right  = svg_width;
+	view_bottom = svg_height;
 	view_top    = 0;
 
+	if (use_region) {
+		view_left   = region.x_min;
+		view_right  = region.x_max;
+		view_bottom = region.y_max;
+		view_top    = region.y_min;
+	}
+
 	// Start OpenGL.
 	glutInit(&argc,argv);
-	glutInitDisplayMode (GLUT_DOUBLE | GLUT_RGBA );
+	glutInitDisplayMode (GLUT_DOUBLE | GLUT_RGBA | GLUT_DEPTH);
 	glutInitWindowSize(500,500);
 	glutCreateWindow("RapidSVG");
 	glutDisplayFunc(display);
 	glutKeyboardFunc(keyboard);
 	glutMouseFunc(mouse);
 	glutMotionFunc(mouse_move);
-	glLoadIdentity ();
-	glOrtho(view_left, view_right, view_bottom, view_top, 0.0, 1.0);
+	if (file_watcher) {
+		glutTimerFunc(follow_interval, follow_timer, 0);
+	}
+	set_projection();
 	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 	glutMainLoop();
 }
@@ -251,7 +923,14 @@ void main_function(int argc, char** argv)
 int main(int argc, char** argv)
 {
 	if (argc == 1) {
-		std::cerr << "Usage: " << argv[0] << " <filename>\n";
+		std::cerr << "Usage: " << argv[0] << " [--follow] [--remove-duplicates] [--spatial-order] "
+		          << "[--simplify-polygons] [--chain-lines] [--index-lines] [--huge-pages] [--lenient] "
+		          << "[--tiles [--budget megabytes]] "
+		          << "[--region x_min,y_min,x_max,y_max [--stride n]] <filename>\n"
+		          << "       " << argv[0] << " --export-tiles <directory> [--max-level z] <filename>\n"
+		          << "       " << argv[0] << " --export-image <png> [--width pixels] <filename>\n"
+		          << "       " << argv[0] << " --convert <store> <filename>\n"
+		          << "       " << argv[0] << " --store [--budget megabytes] <store>\n";
 		return 0;
 	}
 	try {
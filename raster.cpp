@@ -0,0 +1,381 @@
+// Petter Strandmark 2013.
+
+#include <algorithm>
+#include <cmath>
+
+#include "raster.h"
+#include "svg_file.h"
+
+namespace rapidsvg {
+
+namespace
+{
+	// Triangles overlapping more grid cells than this are not put in the
+	// cells but checked for every region drawn.
+	const int max_cells_per_triangle = 64;
+	// Number of samples along each side of a pixel, and the sample mask
+	// of a pixel with all of them.
+	const int samples_per_side = 4;
+	const std::uint16_t all_samples = 0xffff;
+
+	// Blends color with the given alpha in [0, 1] over pixel.
+	void blend(const std::uint8_t* color, float alpha, std::uint8_t* pixel)
+	{
+		if (alpha >= 1) {
+			pixel[0] = color[0];
+			pixel[1] = color[1];
+			pixel[2] = color[2];
+			pixel[3] = 255;
+			return;
+		}
+		for (int c = 0; c < 3; ++c) {
+			pixel[c] = std::uint8_t(pixel[c] + (color[c] - pixel[c]) * alpha + 0.5f);
+		}
+		pixel[3] = std::uint8_t(pixel[3] + (255 - pixel[3]) * alpha + 0.5f);
+	}
+
+	// Adds the samples of every pixel inside a triangle, given in pixel
+	// coordinates, to the sample masks of an image of the given size.
+	// Pixels whose masks were empty are added to touched.
+	void cover_triangle(const double* xy, int width, int height,
+	                    std::vector<std::uint16_t>* masks, std::vector<std::uint32_t>* touched)
+	{
+		double x[3] = {xy[0], xy[2], xy[4]};
+		double y[3] = {xy[1], xy[3], xy[5]};
+		double area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+		if (area == 0) {
+			return;
+		}
+		if (area < 0) {
+			std::swap(x[1], x[2]);
+			std::swap(y[1], y[2]);
+		}
+
+		// The pixels of the bounding box within the image.
+		auto clamp = [](double value, int size)
+		{
+			return int(std::max(0.0, std::min(double(size), value)));
+		};
+		int x_begin = clamp(std::floor(std::min(x[0], std::min(x[1], x[2]))), width);
+		int y_begin = clamp(std::floor(std::min(y[0], std::min(y[1], y[2]))), height);
+		int x_end = clamp(std::ceil(std::max(x[0], std::max(x[1], x[2]))), width);
+		int y_end = clamp(std::ceil(std::max(y[0], std::max(y[1], y[2]))), height);
+
+		// The edge functions a * x + b * y + c are positive inside. Within
+		// a pixel they change by at most radius from the center.
+		double a[3], b[3], c[3], radius[3];
+		for (int i = 0; i < 3; ++i) {
+			int j = (i + 1) % 3;
+			a[i] = -(y[j] - y[i]);
+			b[i] = x[j] - x[i];
+			c[i] = -(a[i] * x[i] + b[i] * y[i]);
+			radius[i] = 0.5 * (std::abs(a[i]) + std::abs(b[i]));
+		}
+
+		for (int py = y_begin; py < y_end; ++py) {
+			double cy = py + 0.5;
+			for (int px = x_begin; px < x_end; ++px) {
+				double cx = px + 0.5;
+				bool inside = true;
+				bool outside = false;
+				for (int i = 0; i < 3; ++i) {
+					double e = a[i] * cx + b[i] * cy + c[i];
+					inside = inside && e >= radius[i];
+					outside = outside || e < -radius[i];
+				}
+				if (outside) {
+					continue;
+				}
+				std::uint16_t mask = all_samples;
+				if (!inside) {
+					mask = 0;
+					for (int sy = 0; sy < samples_per_side; ++sy) {
+						double sample_y = py + (sy + 0.5) / samples_per_side;
+						for (int sx = 0; sx < samples_per_side; ++sx) {
+							double sample_x = px + (sx + 0.5) / samples_per_side;
+							if (a[0] * sample_x + b[0] * sample_y + c[0] >= 0 &&
+							    a[1] * sample_x + b[1] * sample_y + c[1] >= 0 &&
+							    a[2] * sample_x + b[2] * sample_y + c[2] >= 0) {
+								mask |= std::uint16_t(1 << (sy * samples_per_side + sx));
+							}
+						}
+					}
+				}
+				if (mask != 0) {
+					std::uint32_t pixel = std::uint32_t(py) * width + px;
+					if ((*masks)[pixel] == 0) {
+						touched->push_back(pixel);
+					}
+					(*masks)[pixel] |= mask;
+				}
+			}
+		}
+	}
+
+	int count_samples(std::uint16_t mask)
+	{
+		int count = 0;
+		for (; mask != 0; mask &= mask - 1) {
+			++count;
+		}
+		return count;
+	}
+}
+
+void Image::clear(int width_, int height_)
+{
+	width = width_;
+	height = height_;
+	pixels.assign(4 * size_t(width) * height, 255);
+}
+
+SceneRaster::SceneRaster(const SVGFile& file, float tolerance) : side(1)
+{
+	// The same stacking as in the viewer: the elements in document order,
+	// every stroke above its fill.
+	TriangleBatch fills, strokes;
+	int level = file.polygon_levels.level_for(2 * tolerance);
+	if (level < 0) {
+		add_polygons(file.polygons, &fills, &strokes);
+	}
+	else {
+		add_polygons(file.polygons, file.polygon_levels.levels[level], &fills, &strokes);
+	}
+	add_rectangles(file.rectangles, &fills, &strokes);
+	add_polylines(file.polylines, &fills, &strokes);
+	add_lines(file.lines, &strokes);
+	std::vector<Line> chunk_lines;
+	for (auto& chunk : file.indexed_lines.chunks) {
+		chunk_lines.clear();
+		for (std::uint32_t i = chunk.first; i < chunk.end; ++i) {
+			chunk_lines.push_back(file.indexed_lines.line(i));
+		}
+		add_lines(chunk_lines, &strokes);
+	}
+	add_ellipses(file.ellipses, tolerance, &fills, &strokes);
+	add_paths(file.paths, tolerance, &fills, &strokes);
+	add_triangles(fills);
+	add_triangles(strokes);
+
+	// Every symbol is flattened once, finely enough for its largest use.
+	std::vector<float> max_scales(file.symbols.size(), 0);
+	for (auto& use : file.uses) {
+		max_scales[use.symbol] = std::max(max_scales[use.symbol],
+		                                  float(use.transform.scale()));
+	}
+	std::vector<TriangleBatch> symbol_fills(file.symbols.size());
+	std::vector<TriangleBatch> symbol_strokes(file.symbols.size());
+	for (size_t s = 0; s < file.symbols.size(); ++s) {
+		const Symbol& symbol = file.symbols[s];
+		float symbol_tolerance = max_scales[s] > 0 ? tolerance / max_scales[s] : tolerance;
+		TriangleBatch* symbol_fill = &symbol_fills[s];
+		TriangleBatch* symbol_stroke = &symbol_strokes[s];
+		add_polygons(symbol.polygons, symbol_fill, symbol_stroke);
+		add_rectangles(symbol.rectangles, symbol_fill, symbol_stroke);
+		add_ellipses(symbol.ellipses, symbol_tolerance, symbol_fill, symbol_stroke);
+		add_paths(symbol.paths, symbol_tolerance, symbol_fill, symbol_stroke);
+		add_polylines(symbol.polylines, symbol_fill, symbol_stroke);
+		add_lines(symbol.lines, symbol_stroke);
+	}
+	// The elements of a symbol are numbered from zero, so they are moved
+	// to the positions of the use.
+	for (auto& use : file.uses) {
+		add_triangles(symbol_fills[use.symbol], &use.transform, fill_depth(use.order));
+		add_triangles(symbol_strokes[use.symbol], &use.transform, fill_depth(use.order));
+	}
+
+	std::stable_sort(triangles.begin(), triangles.end(),
+		[](const Triangle& a, const Triangle& b)
+		{
+			return a.depth < b.depth;
+		});
+	build_index();
+}
+
+void SceneRaster::add_triangles(const TriangleBatch& batch, const Transform* transform,
+                                float depth)
+{
+	const TriangleBatch::Triangles* parts[2] = {&batch.opaque, &batch.translucent};
+	for (auto part : parts) {
+		for (size_t v = 0; v + 2 < part->num_vertices(); v += 3) {
+			Triangle triangle;
+			for (int k = 0; k < 3; ++k) {
+				triangle.xy[2 * k] = part->vertices[3 * (v + k)];
+				triangle.xy[2 * k + 1] = part->vertices[3 * (v + k) + 1];
+			}
+			if (transform) {
+				transform->apply(triangle.xy, 3);
+			}
+			triangle.depth = part->vertices[3 * v + 2] + depth;
+			std::copy(&part->colors[4 * v], &part->colors[4 * v] + 4, triangle.color);
+			triangles.push_back(triangle);
+		}
+	}
+}
+
+void SceneRaster::build_index()
+{
+	if (triangles.empty()) {
+		cell_starts.assign(2, 0);
+		return;
+	}
+	auto triangle_box = [](const Triangle& t)
+	{
+		Rect box(t.xy[0], t.xy[1], t.xy[0], t.xy[1]);
+		box.add(t.xy[2], t.xy[3]);
+		box.add(t.xy[4], t.xy[5]);
+		return box;
+	};
+	bounds = triangle_box(triangles[0]);
+	for (auto& triangle : triangles) {
+		Rect box = triangle_box(triangle);
+		bounds.add(box.x_min, box.y_min);
+		bounds.add(box.x_max, box.y_max);
+	}
+	// About four triangles per cell.
+	side = std::max(1, std::min(1024, int(std::sqrt(triangles.size() / 4.0))));
+	float cell_width = std::max(bounds.x_max - bounds.x_min, 1e-30f) / side;
+	float cell_height = std::max(bounds.y_max - bounds.y_min, 1e-30f) / side;
+	auto cell_range = [&](const Rect& box, int* x0, int* y0, int* x1, int* y1)
+	{
+		*x0 = std::min(side - 1, int((box.x_min - bounds.x_min) / cell_width));
+		*y0 = std::min(side - 1, int((box.y_min - bounds.y_min) / cell_height));
+		*x1 = std::min(side - 1, int((box.x_max - bounds.x_min) / cell_width));
+		*y1 = std::min(side - 1, int((box.y_max - bounds.y_min) / cell_height));
+	};
+
+	// Counted first, then filled in order, so every cell lists its
+	// triangles in order of depth.
+	cell_starts.assign(size_t(side) * side + 1, 0);
+	for (int pass = 0; pass < 2; ++pass) {
+		std::vector<std::uint32_t> fill(cell_starts.begin(), cell_starts.end() - 1);
+		for (size_t t = 0; t < triangles.size(); ++t) {
+			int x0, y0, x1, y1;
+			cell_range(triangle_box(triangles[t]), &x0, &y0, &x1, &y1);
+			if ((x1 - x0 + 1) * (y1 - y0 + 1) > max_cells_per_triangle) {
+				if (pass == 1) {
+					large_triangles.push_back(std::uint32_t(t));
+				}
+				continue;
+			}
+			for (int y = y0; y <= y1; ++y) {
+				for (int x = x0; x <= x1; ++x) {
+					size_t cell = size_t(y) * side + x;
+					if (pass == 0) {
+						cell_starts[cell + 1]++;
+					}
+					else {
+						cell_triangles[fill[cell]++] = std::uint32_t(t);
+					}
+				}
+			}
+		}
+		if (pass == 0) {
+			for (size_t cell = 0; cell + 1 < cell_starts.size(); ++cell) {
+				cell_starts[cell + 1] += cell_starts[cell];
+			}
+			cell_triangles.resize(cell_starts.back());
+		}
+	}
+}
+
+size_t SceneRaster::memory_bytes() const
+{
+	return triangles.size() * sizeof(Triangle) +
+	       (cell_starts.size() + cell_triangles.size() + large_triangles.size()) *
+	       sizeof(std::uint32_t);
+}
+
+void SceneRaster::cell_range(const Rect& region, int* x0, int* y0, int* x1, int* y1) const
+{
+	float cell_width = std::max(bounds.x_max - bounds.x_min, 1e-30f) / side;
+	float cell_height = std::max(bounds.y_max - bounds.y_min, 1e-30f) / side;
+	auto cell = [&](float offset, float size)
+	{
+		return int(std::max(0.0f, std::min(float(side - 1), offset / size)));
+	};
+	*x0 = cell(region.x_min - bounds.x_min, cell_width);
+	*y0 = cell(region.y_min - bounds.y_min, cell_height);
+	*x1 = cell(region.x_max - bounds.x_min, cell_width);
+	*y1 = cell(region.y_max - bounds.y_min, cell_height);
+}
+
+bool SceneRaster::overlaps(const Rect& region) const
+{
+	if (triangles.empty() || !region.intersects(bounds)) {
+		return false;
+	}
+	for (auto t : large_triangles) {
+		const Triangle& triangle = triangles[t];
+		Rect box(triangle.xy[0], triangle.xy[1], triangle.xy[0], triangle.xy[1]);
+		box.add(triangle.xy[2], triangle.xy[3]);
+		box.add(triangle.xy[4], triangle.xy[5]);
+		if (box.intersects(region)) {
+			return true;
+		}
+	}
+	int x0, y0, x1, y1;
+	cell_range(region, &x0, &y0, &x1, &y1);
+	for (int y = y0; y <= y1; ++y) {
+		size_t row = size_t(y) * side;
+		if (cell_starts[row + x1 + 1] > cell_starts[row + x0]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void SceneRaster::render(const Rect& region, Image* image) const
+{
+	image->clear(image->width, image->height);
+	if (triangles.empty() || !region.intersects(bounds)) {
+		return;
+	}
+
+	// The triangles in the cells overlapping the region, in order.
+	int x0, y0, x1, y1;
+	cell_range(region, &x0, &y0, &x1, &y1);
+	std::vector<std::uint32_t> candidates(large_triangles);
+	for (int y = y0; y <= y1; ++y) {
+		for (int x = x0; x <= x1; ++x) {
+			size_t i = size_t(y) * side + x;
+			candidates.insert(candidates.end(), cell_triangles.begin() + cell_starts[i],
+			                  cell_triangles.begin() + cell_starts[i + 1]);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+	// The triangles of an element have the same depth and color. Their
+	// samples are gathered before the element is blended, so that no seams
+	// show where they meet.
+	double scale_x = image->width / (double(region.x_max) - region.x_min);
+	double scale_y = image->height / (double(region.y_max) - region.y_min);
+	std::vector<std::uint16_t> masks(size_t(image->width) * image->height, 0);
+	std::vector<std::uint32_t> touched;
+	for (size_t k = 0; k < candidates.size(); ++k) {
+		const Triangle& triangle = triangles[candidates[k]];
+		double xy[6];
+		for (int v = 0; v < 3; ++v) {
+			xy[2 * v] = (triangle.xy[2 * v] - double(region.x_min)) * scale_x;
+			xy[2 * v + 1] = (triangle.xy[2 * v + 1] - double(region.y_min)) * scale_y;
+		}
+		cover_triangle(xy, image->width, image->height, &masks, &touched);
+
+		const Triangle* next = k + 1 < candidates.size() ? &triangles[candidates[k + 1]] : 0;
+		if (next && next->depth == triangle.depth &&
+		    std::equal(triangle.color, triangle.color + 4, next->color)) {
+			continue;
+		}
+		const float alpha = triangle.color[3] / 255.0f;
+		const int num_samples = samples_per_side * samples_per_side;
+		for (auto pixel : touched) {
+			blend(triangle.color, alpha * count_samples(masks[pixel]) / num_samples,
+			      &image->pixels[4 * size_t(pixel)]);
+			masks[pixel] = 0;
+		}
+		touched.clear();
+	}
+}
+
+}
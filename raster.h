@@ -0,0 +1,90 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_RASTER_H
+#define RAPIDSVG_RASTER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "rect.h"
+#include "render_batch.h"
+
+namespace rapidsvg {
+
+class SVGFile;
+
+// An RGBA image with 8 bits per channel, stored row by row from the top.
+class Image
+{
+public:
+	Image() : width(0), height(0)
+	{ }
+	int width, height;
+	std::vector<std::uint8_t> pixels;
+
+	// Resizes the image and makes every pixel opaque white.
+	void clear(int width, int height);
+	size_t memory_bytes() const { return pixels.size(); }
+};
+
+// The triangles of a file, flattened for drawing at one scale, with a
+// grid index so that small parts of the file can be drawn without
+// looking at every triangle. The triangles are drawn in software, so
+// that parts can be drawn by several threads at once or without a
+// window.
+class SceneRaster
+{
+public:
+	// Curves are flattened with the given tolerance and polygons are taken
+	// from the coarsest level of detail within twice of it. The elements
+	// are stacked as the viewer stacks them. The file is not used after
+	// construction.
+	SceneRaster(const SVGFile& file, float tolerance);
+
+	// Draws the part of the SVG in region into image, scaled to fill the
+	// image, over opaque white. Edges are antialiased with 16 samples per
+	// pixel, gathered for all triangles of an element before it is
+	// blended. May be called from several threads at once.
+	void render(const Rect& region, Image* image) const;
+	// Whether any triangle may overlap region. Regions for which this is
+	// false are drawn blank.
+	bool overlaps(const Rect& region) const;
+
+	size_t num_triangles() const { return triangles.size(); }
+	size_t memory_bytes() const;
+
+private:
+	SceneRaster(const SceneRaster&);
+	SceneRaster& operator=(const SceneRaster&);
+
+	// A triangle with the depth and the color of its element.
+	struct Triangle
+	{
+		float xy[6];
+		float depth;
+		std::uint8_t color[4];
+	};
+
+	// Adds the triangles of batch, moved by the transform if given.
+	void add_triangles(const TriangleBatch& batch, const Transform* transform = 0,
+	                   float depth = 0);
+	void build_index();
+	// The cells overlapping region, which must intersect bounds.
+	void cell_range(const Rect& region, int* x0, int* y0, int* x1, int* y1) const;
+
+	// In order of increasing depth.
+	std::vector<Triangle> triangles;
+	// The grid covers bounds with side x side cells. Cell i holds the
+	// triangles [cell_starts[i], cell_starts[i + 1]) of cell_triangles.
+	// Triangles overlapping many cells are kept in large_triangles
+	// instead.
+	Rect bounds;
+	int side;
+	std::vector<std::uint32_t> cell_starts;
+	std::vector<std::uint32_t> cell_triangles;
+	std::vector<std::uint32_t> large_triangles;
+};
+
+}
+
+#endif
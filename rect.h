@@ -0,0 +1,39 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_RECT_H
+#define RAPIDSVG_RECT_H
+
+#include <algorithm>
+
+namespace rapidsvg {
+
+// Axis-aligned rectangle in SVG coordinates.
+class Rect
+{
+public:
+	Rect() : x_min(0), y_min(0), x_max(0), y_max(0)
+	{ }
+	Rect(float x_min_, float y_min_, float x_max_, float y_max_) :
+		x_min(x_min_), y_min(y_min_), x_max(x_max_), y_max(y_max_)
+	{ }
+	float x_min, y_min, x_max, y_max;
+
+	bool intersects(const Rect& other) const
+	{
+		return x_min <= other.x_max && other.x_min <= x_max &&
+		       y_min <= other.y_max && other.y_min <= y_max;
+	}
+
+	// Grows the rectangle to contain the point.
+	void add(float x, float y)
+	{
+		x_min = std::min(x_min, x);
+		x_max = std::max(x_max, x);
+		y_min = std::min(y_min, y);
+		y_max = std::max(y_max, y);
+	}
+};
+
+}
+
+#endif
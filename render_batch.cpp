@@ -0,0 +1,547 @@
+// Petter Strandmark 2013.
+
+#include <algorithm>
+#include <cmath>
+
+#include "render_batch.h"
+
+namespace rapidsvg {
+
+void TriangleBatch::Triangles::resize(size_t num_vertices)
+{
+	vertices.resize(3 * num_vertices);
+	colors.resize(4 * num_vertices);
+}
+
+void TriangleBatch::Triangles::set_vertex(size_t index, float x, float y, float z,
+                                          const std::uint8_t* color)
+{
+	vertices[3 * index] = x;
+	vertices[3 * index + 1] = y;
+	vertices[3 * index + 2] = z;
+	for (int i = 0; i < 4; ++i) {
+		colors[4 * index + i] = color[i];
+	}
+}
+
+void TriangleBatch::clear()
+{
+	opaque.vertices.clear();
+	opaque.colors.clear();
+	translucent.vertices.clear();
+	translucent.colors.clear();
+	depth = 0;
+}
+
+size_t TriangleBatch::num_vertices() const
+{
+	return opaque.num_vertices() + translucent.num_vertices();
+}
+
+TriangleBatch::Triangles* TriangleBatch::triangles_for(const std::uint8_t* color)
+{
+	if (color[3] == 0) {
+		return 0;
+	}
+	return color[3] == 255 ? &opaque : &translucent;
+}
+
+void color_bytes(float r, float g, float b, float a, std::uint8_t* bytes)
+{
+	float components[4] = {r, g, b, a};
+	for (int i = 0; i < 4; ++i) {
+		float c = components[i] < 0 ? 0 : components[i] > 1 ? 1 : components[i];
+		bytes[i] = std::uint8_t(c * 255 + 0.5f);
+	}
+}
+
+bool TriangleBatch::set_color(float r, float g, float b, float a)
+{
+	color_bytes(r, g, b, a, color);
+	current = triangles_for(color);
+	return current != 0;
+}
+
+namespace
+{
+	// Writes the two triangles covering a line of the given width as six
+	// points to xy. Returns false if the line covers nothing.
+	bool line_triangles(float x1, float y1, float x2, float y2, float width,
+	                    float* xy)
+	{
+		float dx = x2 - x1;
+		float dy = y2 - y1;
+		float length = std::sqrt(dx * dx + dy * dy);
+		if (length == 0 || width <= 0) {
+			return false;
+		}
+		// Offset perpendicular to the line.
+		float ox = dy / length * width / 2;
+		float oy = -dx / length * width / 2;
+		float points[12] = {x1 + ox, y1 + oy, x2 + ox, y2 + oy, x2 - ox, y2 - oy,
+		                    x2 - ox, y2 - oy, x1 - ox, y1 - oy, x1 + ox, y1 + oy};
+		for (int i = 0; i < 12; ++i) {
+			xy[i] = points[i];
+		}
+		return true;
+	}
+}
+
+void TriangleBatch::add_vertex(float x, float y)
+{
+	current->vertices.push_back(x);
+	current->vertices.push_back(y);
+	current->vertices.push_back(depth);
+	current->colors.insert(current->colors.end(), color, color + 4);
+}
+
+void TriangleBatch::add_line(float x1, float y1, float x2, float y2, float width,
+                             float r, float g, float b, float a)
+{
+	float xy[12];
+	if (set_color(r, g, b, a) && line_triangles(x1, y1, x2, y2, width, xy)) {
+		for (int i = 0; i < 6; ++i) {
+			add_vertex(xy[2 * i], xy[2 * i + 1]);
+		}
+	}
+}
+
+void TriangleBatch::add_polyline(const float* xy, size_t num_points, float width,
+                                 float r, float g, float b, float a)
+{
+	for (size_t i = 1; i < num_points; ++i) {
+		add_line(xy[2 * i - 2], xy[2 * i - 1], xy[2 * i], xy[2 * i + 1],
+		         width, r, g, b, a);
+	}
+}
+
+namespace
+{
+	// Longest miter allowed, relative to the stroke width.
+	const float miter_limit = 4;
+}
+
+void TriangleBatch::add_outline(const float* xy, size_t num_points, bool closed,
+                                float width, float r, float g, float b, float a)
+{
+	if (width <= 0 || !set_color(r, g, b, a)) {
+		return;
+	}
+	// Repeated points would give segments without direction.
+	outline_indices.clear();
+	for (size_t i = 0; i < num_points; ++i) {
+		if (outline_indices.empty() ||
+		    xy[2 * i] != xy[2 * outline_indices.back()] ||
+		    xy[2 * i + 1] != xy[2 * outline_indices.back() + 1]) {
+			outline_indices.push_back(std::uint32_t(i));
+		}
+	}
+	if (closed && outline_indices.size() > 1 &&
+	    xy[2 * outline_indices[0]] == xy[2 * outline_indices.back()] &&
+	    xy[2 * outline_indices[0] + 1] == xy[2 * outline_indices.back() + 1]) {
+		outline_indices.pop_back();
+	}
+	const size_t n = outline_indices.size();
+	if (n < 2) {
+		return;
+	}
+
+	const size_t num_segments = closed ? n : n - 1;
+	for (size_t i = 0; i < num_segments; ++i) {
+		const float* p = &xy[2 * outline_indices[i]];
+		const float* q = &xy[2 * outline_indices[(i + 1) % n]];
+		add_line(p[0], p[1], q[0], q[1], width, r, g, b, a);
+	}
+
+	// Corners between consecutive segments.
+	const float half_width = width / 2;
+	for (size_t i = closed ? 0 : 1; i < (closed ? n : n - 1); ++i) {
+		const float* p = &xy[2 * outline_indices[(i + n - 1) % n]];
+		const float* v = &xy[2 * outline_indices[i]];
+		const float* q = &xy[2 * outline_indices[(i + 1) % n]];
+		float dx0 = v[0] - p[0];
+		float dy0 = v[1] - p[1];
+		float dx1 = q[0] - v[0];
+		float dy1 = q[1] - v[1];
+		float turn = dx0 * dy1 - dy0 * dx1;
+		if (turn == 0) {
+			continue;
+		}
+		// Offsets of the two lines on the outside of the corner, as in
+		// line_triangles.
+		float side = turn > 0 ? half_width : -half_width;
+		float length0 = std::sqrt(dx0 * dx0 + dy0 * dy0);
+		float length1 = std::sqrt(dx1 * dx1 + dy1 * dy1);
+		float ox0 = dy0 / length0 * side;
+		float oy0 = -dx0 / length0 * side;
+		float ox1 = dy1 / length1 * side;
+		float oy1 = -dx1 / length1 * side;
+
+		// The miter tip lies along the sum of the offsets, at a distance
+		// of half_width / cos of half the angle between them.
+		float mx = ox0 + ox1;
+		float my = oy0 + oy1;
+		float m2 = mx * mx + my * my;
+		float cos_half = std::sqrt(m2) / (2 * half_width);
+		if (cos_half > 0 && 1 / cos_half <= miter_limit) {
+			float scale = half_width / cos_half / std::sqrt(m2);
+			float tip_x = v[0] + mx * scale;
+			float tip_y = v[1] + my * scale;
+			add_vertex(v[0], v[1]);
+			add_vertex(v[0] + ox0, v[1] + oy0);
+			add_vertex(tip_x, tip_y);
+			add_vertex(v[0], v[1]);
+			add_vertex(tip_x, tip_y);
+			add_vertex(v[0] + ox1, v[1] + oy1);
+		}
+		else {
+			add_vertex(v[0], v[1]);
+			add_vertex(v[0] + ox0, v[1] + oy0);
+			add_vertex(v[0] + ox1, v[1] + oy1);
+		}
+	}
+}
+
+namespace
+{
+	float cross(const float* xy, std::uint32_t a, std::uint32_t b, std::uint32_t c)
+	{
+		return (xy[2 * b] - xy[2 * a]) * (xy[2 * c + 1] - xy[2 * a + 1]) -
+		       (xy[2 * b + 1] - xy[2 * a + 1]) * (xy[2 * c] - xy[2 * a]);
+	}
+}
+
+void TriangleBatch::add_polygon(const float* xy, size_t num_points,
+                                float r, float g, float b, float a)
+{
+	if (!set_color(r, g, b, a)) {
+		return;
+	}
+	// A repeated first point does not add anything.
+	if (num_points > 1 && xy[0] == xy[2 * num_points - 2] &&
+	                      xy[1] == xy[2 * num_points - 1]) {
+		num_points--;
+	}
+	if (num_points < 3) {
+		return;
+	}
+
+	// Twice the signed area gives the orientation.
+	float area = 0;
+	for (size_t i = 0, j = num_points - 1; i < num_points; j = i++) {
+		area += xy[2 * j] * xy[2 * i + 1] - xy[2 * i] * xy[2 * j + 1];
+	}
+	if (area == 0) {
+		return;
+	}
+	float orientation = area > 0 ? 1.0f : -1.0f;
+
+	bool convex = true;
+	for (size_t i = 0; i < num_points && convex; ++i) {
+		std::uint32_t a = std::uint32_t(i);
+		std::uint32_t b1 = std::uint32_t((i + 1) % num_points);
+		std::uint32_t c = std::uint32_t((i + 2) % num_points);
+		convex = orientation * cross(xy, a, b1, c) >= 0;
+	}
+	if (convex) {
+		for (size_t i = 2; i < num_points; ++i) {
+			add_vertex(xy[0], xy[1]);
+			add_vertex(xy[2 * i - 2], xy[2 * i - 1]);
+			add_vertex(xy[2 * i], xy[2 * i + 1]);
+		}
+		return;
+	}
+
+	std::uint32_t end = std::uint32_t(num_points);
+	triangulator.triangulate(xy, &end, 1, false, &triangle_indices);
+	for (auto index : triangle_indices) {
+		add_vertex(xy[2 * index], xy[2 * index + 1]);
+	}
+}
+
+void TriangleBatch::add_polygon(const float* xy, const std::uint32_t* ring_ends,
+                                size_t num_rings, bool even_odd,
+                                float r, float g, float b, float a)
+{
+	if (num_rings == 1) {
+		add_polygon(xy, ring_ends[0], r, g, b, a);
+		return;
+	}
+	if (num_rings == 0 || !set_color(r, g, b, a)) {
+		return;
+	}
+	triangulator.triangulate(xy, ring_ends, num_rings, even_odd, &triangle_indices);
+	for (auto index : triangle_indices) {
+		add_vertex(xy[2 * index], xy[2 * index + 1]);
+	}
+}
+
+void merge_translucent(const std::vector<const TriangleBatch*>& batches,
+                       TriangleBatch::Triangles* merged)
+{
+	// The depth, batch and first vertex of every triangle. Triangles of
+	// the same depth come from the same element and keep their order.
+	struct Key
+	{
+		float depth;
+		std::uint32_t batch;
+		std::uint32_t vertex;
+		bool operator<(const Key& other) const
+		{
+			if (depth != other.depth) {
+				return depth < other.depth;
+			}
+			if (batch != other.batch) {
+				return batch < other.batch;
+			}
+			return vertex < other.vertex;
+		}
+	};
+	std::vector<Key> keys;
+	for (size_t b = 0; b < batches.size(); ++b) {
+		const TriangleBatch::Triangles& triangles = batches[b]->translucent;
+		for (size_t v = 0; v + 2 < triangles.num_vertices(); v += 3) {
+			Key key = {triangles.vertices[3 * v + 2], std::uint32_t(b), std::uint32_t(v)};
+			keys.push_back(key);
+		}
+	}
+	std::sort(keys.begin(), keys.end());
+
+	merged->resize(3 * keys.size());
+	size_t index = 0;
+	for (auto& key : keys) {
+		const TriangleBatch::Triangles& triangles = batches[key.batch]->translucent;
+		for (size_t v = key.vertex; v < key.vertex + 3; ++v) {
+			merged->set_vertex(index++, triangles.vertices[3 * v],
+			                   triangles.vertices[3 * v + 1],
+			                   triangles.vertices[3 * v + 2], &triangles.colors[4 * v]);
+		}
+	}
+}
+
+void add_lines(const std::vector<Line>& lines, TriangleBatch* batch)
+{
+	for (auto& line : lines) {
+		batch->depth = stroke_depth(line.order);
+		batch->add_line(line.x1, line.y1, line.x2, line.y2, line.width,
+		                line.r, line.g, line.b, line.a);
+	}
+}
+
+namespace
+{
+	void add_polygon(const Polygon& polygon, const float* points, size_t num_points,
+	                 TriangleBatch* fills, TriangleBatch* strokes)
+	{
+		fills->depth = fill_depth(polygon.order);
+		strokes->depth = stroke_depth(polygon.order);
+		if (num_points > 0) {
+			fills->add_polygon(points, num_points,
+			                   polygon.r, polygon.g, polygon.b, polygon.a);
+			if (polygon.has_stroke()) {
+				strokes->add_outline(points, num_points, true, polygon.stroke_width,
+				                     polygon.stroke_r, polygon.stroke_g, polygon.stroke_b,
+				                     polygon.stroke_a);
+			}
+		}
+	}
+}
+
+void add_polygons(const std::vector<Polygon>& polygons,
+                  TriangleBatch* fills, TriangleBatch* strokes)
+{
+	for (auto& polygon : polygons) {
+		add_polygon(polygon, polygon.points.empty() ? 0 : &polygon.points[0].first,
+		            polygon.points.size(), fills, strokes);
+	}
+}
+
+void add_polygons(const std::vector<Polygon>& polygons,
+                  const PolygonLevels::Level& level,
+                  TriangleBatch* fills, TriangleBatch* strokes)
+{
+	for (size_t i = 0; i < polygons.size(); ++i) {
+		size_t num_points = 0;
+		const float* points = level.polygon_points(polygons, i, &num_points);
+		add_polygon(polygons[i], points, num_points, fills, strokes);
+	}
+}
+
+void add_paths(const std::vector<Path>& paths, float tolerance,
+               TriangleBatch* fills, TriangleBatch* strokes)
+{
+	std::vector<float> xy;
+	std::vector<std::uint32_t> subpath_ends;
+	for (auto& path : paths) {
+		const ShapeStyle& style = path.style;
+		fills->depth = fill_depth(path.order);
+		strokes->depth = stroke_depth(path.order);
+		if (style.has_fill() || style.has_stroke()) {
+			xy.clear();
+			subpath_ends.clear();
+			path.flatten(tolerance, &xy, &subpath_ends);
+		}
+
+		if (style.has_fill() && !subpath_ends.empty()) {
+			fills->add_polygon(&xy[0], &subpath_ends[0], subpath_ends.size(), style.even_odd,
+			                   style.r, style.g, style.b, style.a);
+		}
+		std::uint32_t start = 0;
+		for (auto end : subpath_ends) {
+			const float* points = &xy[2 * start];
+			size_t num_points = end - start;
+			if (style.has_stroke()) {
+				strokes->add_polyline(points, num_points, style.stroke_width,
+				                      style.stroke_r, style.stroke_g, style.stroke_b,
+				                      style.stroke_a);
+			}
+			start = end;
+		}
+		subpath_ends.clear();
+	}
+}
+
+void add_polylines(const std::vector<Polyline>& polylines,
+                   TriangleBatch* fills, TriangleBatch* strokes)
+{
+	for (auto& polyline : polylines) {
+		const ShapeStyle& style = polyline.style;
+		fills->depth = fill_depth(polyline.order);
+		strokes->depth = stroke_depth(polyline.order);
+		if (!polyline.points.empty()) {
+			const float* points = &polyline.points[0].first;
+			size_t num_points = polyline.points.size();
+			if (style.has_fill()) {
+				fills->add_polygon(points, num_points,
+				                   style.r, style.g, style.b, style.a);
+			}
+			if (style.has_stroke()) {
+				strokes->add_outline(points, num_points, false, style.stroke_width,
+				                     style.stroke_r, style.stroke_g, style.stroke_b,
+				                     style.stroke_a);
+			}
+		}
+	}
+}
+
+void add_rectangles(const std::vector<Rectangle>& rectangles,
+                    TriangleBatch* fills, TriangleBatch* strokes)
+{
+	for (auto& rectangle : rectangles) {
+		const ShapeStyle& style = rectangle.style;
+		fills->depth = fill_depth(rectangle.order);
+		strokes->depth = stroke_depth(rectangle.order);
+		// The corners and the first corner again, to close the outline.
+		float xy[10];
+		rectangle.corners(xy);
+		xy[8] = xy[0];
+		xy[9] = xy[1];
+		if (style.has_fill()) {
+			fills->add_polygon(xy, 4, style.r, style.g, style.b, style.a);
+		}
+		if (style.has_stroke()) {
+			strokes->add_polyline(xy, 5, style.stroke_width,
+			                      style.stroke_r, style.stroke_g, style.stroke_b,
+			                      style.stroke_a);
+		}
+	}
+}
+
+void add_ellipses(const std::vector<Ellipse>& ellipses, float tolerance,
+                  TriangleBatch* fills, TriangleBatch* strokes)
+{
+	// Every ellipse is a fan of n triangles and its stroke n quads. The
+	// number of vertices of every ellipse is counted first, so that all
+	// of them can be written to their own part of the batches in parallel.
+	struct Placement
+	{
+		int segments;
+		std::uint8_t fill_color[4], stroke_color[4];
+		TriangleBatch::Triangles* fill;
+		TriangleBatch::Triangles* stroke;
+		size_t fill_start, stroke_start;
+	};
+	const int num_ellipses = int(ellipses.size());
+	std::vector<Placement> placements(num_ellipses);
+	size_t fill_counts[2] = {fills->opaque.num_vertices(),
+	                         fills->translucent.num_vertices()};
+	size_t stroke_counts[2] = {strokes->opaque.num_vertices(),
+	                           strokes->translucent.num_vertices()};
+	for (int i = 0; i < num_ellipses; ++i) {
+		const ShapeStyle& style = ellipses[i].style;
+		Placement& placement = placements[i];
+		placement.segments = ellipses[i].num_segments(tolerance);
+		color_bytes(style.r, style.g, style.b, style.a, placement.fill_color);
+		color_bytes(style.stroke_r, style.stroke_g, style.stroke_b, style.stroke_a,
+		            placement.stroke_color);
+		placement.fill = style.has_fill() ? fills->triangles_for(placement.fill_color) : 0;
+		placement.stroke = style.has_stroke() ?
+		                   strokes->triangles_for(placement.stroke_color) : 0;
+		if (placement.fill) {
+			size_t& count = fill_counts[placement.fill == &fills->opaque ? 0 : 1];
+			placement.fill_start = count;
+			count += 3 * placement.segments;
+		}
+		if (placement.stroke) {
+			size_t& count = stroke_counts[placement.stroke == &strokes->opaque ? 0 : 1];
+			placement.stroke_start = count;
+			count += 6 * placement.segments;
+		}
+	}
+	fills->opaque.resize(fill_counts[0]);
+	fills->translucent.resize(fill_counts[1]);
+	strokes->opaque.resize(stroke_counts[0]);
+	strokes->translucent.resize(stroke_counts[1]);
+
+	#pragma omp parallel for schedule(dynamic, 1024)
+	for (int i = 0; i < num_ellipses; ++i) {
+		const Ellipse& ellipse = ellipses[i];
+		const ShapeStyle& style = ellipse.style;
+		const Placement& placement = placements[i];
+		const int n = placement.segments;
+		const float step = 2 * 3.14159265358979323846f / n;
+		const float fill_z = fill_depth(ellipse.order);
+		const float stroke_z = stroke_depth(ellipse.order);
+		size_t fill_index = placement.fill_start;
+		size_t stroke_index = placement.stroke_start;
+		float previous_x = ellipse.cx + ellipse.ux;
+		float previous_y = ellipse.cy + ellipse.uy;
+		for (int k = 1; k <= n; ++k) {
+			float c = std::cos(k * step);
+			float s = std::sin(k * step);
+			float x = ellipse.cx + c * ellipse.ux + s * ellipse.vx;
+			float y = ellipse.cy + c * ellipse.uy + s * ellipse.vy;
+			if (placement.fill) {
+				auto fill = placement.fill;
+				const std::uint8_t* color = placement.fill_color;
+				fill->set_vertex(fill_index++, ellipse.cx, ellipse.cy, fill_z, color);
+				fill->set_vertex(fill_index++, previous_x, previous_y, fill_z, color);
+				fill->set_vertex(fill_index++, x, y, fill_z, color);
+			}
+			if (placement.stroke) {
+				float quad[12];
+				if (!line_triangles(previous_x, previous_y, x, y,
+				                    style.stroke_width, quad)) {
+					// The vertices were counted already; write empty
+					// triangles.
+					for (int j = 0; j < 12; j += 2) {
+						quad[j] = x;
+						quad[j + 1] = y;
+					}
+				}
+				for (int j = 0; j < 6; ++j) {
+					placement.stroke->set_vertex(stroke_index++, quad[2 * j], quad[2 * j + 1],
+					                             stroke_z, placement.stroke_color);
+				}
+			}
+			previous_x = x;
+			previous_y = y;
+		}
+	}
+	if (num_ellipses > 0) {
+		fills->depth = fill_depth(ellipses.back().order);
+		strokes->depth = stroke_depth(ellipses.back().order);
+	}
+}
+
+}
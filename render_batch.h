@@ -0,0 +1,137 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_RENDER_BATCH_H
+#define RAPIDSVG_RENDER_BATCH_H
+
+#include <cstdint>
+#include <vector>
+
+#include "line.h"
+#include "path.h"
+#include "polygon.h"
+#include "polygon_levels.h"
+#include "shapes.h"
+#include "triangulation.h"
+
+namespace rapidsvg {
+
+// Depths of the fill and of the stroke of the element at the given
+// position in document order. Every element is drawn above the ones before
+// it, and its stroke above its fill.
+inline float fill_depth(std::uint32_t order) { return 2.0f * order; }
+inline float stroke_depth(std::uint32_t order) { return 2.0f * order + 1; }
+
+// Flat triangle storage, kept apart by opacity so that opaque triangles
+// can be drawn without blending. Every vertex has a position, a depth and
+// a color. The depth orders the elements: one drawn later in the file has
+// a larger depth and covers the earlier ones when drawn with a depth test,
+// whatever order the triangles are drawn in. Translucent triangles must
+// still be blended in order of depth.
+class TriangleBatch
+{
+public:
+	// Triangles that are drawn with a single call.
+	class Triangles
+	{
+	public:
+		// Vertex positions and depths as x0, y0, z0, x1, y1, z1, ...
+		std::vector<float> vertices;
+		// Vertex colors as r0, g0, b0, a0, r1, g1, b1, a1, ...
+		std::vector<std::uint8_t> colors;
+
+		size_t num_vertices() const { return vertices.size() / 3; }
+		void resize(size_t num_vertices);
+		// Sets a vertex already made room for. Different vertices may be
+		// set in parallel.
+		void set_vertex(size_t index, float x, float y, float z,
+		                const std::uint8_t* color);
+	};
+
+	TriangleBatch() : depth(0), current(0)
+	{ }
+
+	Triangles opaque;
+	Triangles translucent;
+	// Depth of the triangles added next. The functions adding a vector of
+	// elements below set it from the position of every element in
+	// document order.
+	float depth;
+
+	// Removes all triangles and sets the depth to 0.
+	void clear();
+	size_t num_vertices() const;
+	// The triangles for elements with the given color, or null if the
+	// color is fully transparent.
+	Triangles* triangles_for(const std::uint8_t* color);
+
+	// Adds a line of the given width as two triangles.
+	void add_line(float x1, float y1, float x2, float y2, float width,
+	              float r, float g, float b, float a);
+	// Adds a filled polygon given as num_points points x0, y0, x1, y1, ...
+	// Convex polygons are drawn as a fan and others are triangulated by
+	// ear clipping.
+	void add_polygon(const float* xy, size_t num_points,
+	                 float r, float g, float b, float a);
+	// Adds a filled shape made of several rings, such as the subpaths of a
+	// path, given as for Triangulator::triangulate. Rings inside others
+	// are holes or filled by the fill rule.
+	void add_polygon(const float* xy, const std::uint32_t* ring_ends, size_t num_rings,
+	                 bool even_odd, float r, float g, float b, float a);
+	// Adds every segment of a polyline as a line.
+	void add_polyline(const float* xy, size_t num_points, float width,
+	                  float r, float g, float b, float a);
+	// Adds the outline of a polygon, or of a polyline if closed is false,
+	// as a line for every segment and triangles filling the corners
+	// between them. Corners are mitered, or beveled where the miter would
+	// exceed the SVG default miter limit.
+	void add_outline(const float* xy, size_t num_points, bool closed, float width,
+	                 float r, float g, float b, float a);
+
+private:
+	// Sets the color of the vertices added next. Returns false if it is
+	// fully transparent.
+	bool set_color(float r, float g, float b, float a);
+	void add_vertex(float x, float y);
+
+	Triangulator triangulator;
+	std::vector<std::uint32_t> triangle_indices;
+	std::vector<std::uint32_t> outline_indices;
+	Triangles* current;
+	std::uint8_t color[4];
+};
+
+// Converts a color with components in [0, 1] to bytes.
+void color_bytes(float r, float g, float b, float a, std::uint8_t* bytes);
+
+// Replaces merged by the translucent triangles of the batches, in order of
+// increasing depth, which is the order they are blended in.
+void merge_translucent(const std::vector<const TriangleBatch*>& batches,
+                       TriangleBatch::Triangles* merged);
+
+void add_lines(const std::vector<Line>& lines, TriangleBatch* batch);
+// The functions below add the fills of the shapes to fills and their
+// strokes to strokes.
+
+void add_polygons(const std::vector<Polygon>& polygons,
+                  TriangleBatch* fills, TriangleBatch* strokes);
+// Adds the polygons with the points they have at a level of detail.
+void add_polygons(const std::vector<Polygon>& polygons,
+                  const PolygonLevels::Level& level,
+                  TriangleBatch* fills, TriangleBatch* strokes);
+
+// Flattens the paths with the given tolerance. The subpaths of a path are
+// filled together by its fill rule.
+void add_paths(const std::vector<Path>& paths, float tolerance,
+               TriangleBatch* fills, TriangleBatch* strokes);
+void add_polylines(const std::vector<Polyline>& polylines,
+                   TriangleBatch* fills, TriangleBatch* strokes);
+void add_rectangles(const std::vector<Rectangle>& rectangles,
+                    TriangleBatch* fills, TriangleBatch* strokes);
+// Approximates the ellipses by polygons with no point further than
+// tolerance from them. The ellipses are tessellated in parallel.
+void add_ellipses(const std::vector<Ellipse>& ellipses, float tolerance,
+                  TriangleBatch* fills, TriangleBatch* strokes);
+
+}
+
+#endif
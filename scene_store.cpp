@@ -0,0 +1,796 @@
+// Petter Strandmark 2013.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#include "scene_store.h"
+#include "svg_file.h"
+
+namespace rapidsvg {
+
+namespace
+{
+	const char store_magic[8] = {'R', 'S', 'V', 'G', 'S', 'T', 'O', 'R'};
+	const std::uint32_t store_version = 7;
+	// Tiles start on page boundaries so they can be paged independently.
+	const std::uint64_t page_size = 4096;
+	// Stores with more tiles along a side are taken to be damaged.
+	const std::uint32_t max_tiles_per_side = 1 << 16;
+
+	struct StoreHeader
+	{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t tiles_x, tiles_y;
+		// Number of positions in document order of the elements.
+		std::uint32_t num_orders;
+		double width, height;
+	};
+
+	// Tiles are located by their offset and size in the store. memory is
+	// the memory used by their elements when decoded.
+	struct StoreTileEntry
+	{
+		std::uint64_t offset, size, memory;
+		std::uint32_t num_elements[NumElementTypes];
+		float x_min, y_min, x_max, y_max;
+	};
+
+	template<typename T>
+	void put(std::vector<char>* buffer, const T& value)
+	{
+		const char* bytes = reinterpret_cast<const char*>(&value);
+		buffer->insert(buffer->end(), bytes, bytes + sizeof(T));
+	}
+
+	template<typename T>
+	T get(const char** data)
+	{
+		T value;
+		std::memcpy(&value, *data, sizeof(T));
+		*data += sizeof(T);
+		return value;
+	}
+
+	// Every element type has a record of record_size bytes, written by
+	// encode and read by decode. memory_size is the memory used by a
+	// decoded element. The records are stored after the position of the
+	// element in document order, see stored_size.
+
+	// A line is stored as x1, y1, x2, y2, width, r, g, b, a.
+	size_t record_size(const Line&)
+	{
+		return 9 * sizeof(float);
+	}
+
+	void encode(const Line& line, std::vector<char>* buffer)
+	{
+		put(buffer, line.x1);
+		put(buffer, line.y1);
+		put(buffer, line.x2);
+		put(buffer, line.y2);
+		put(buffer, line.width);
+		put(buffer, line.r);
+		put(buffer, line.g);
+		put(buffer, line.b);
+		put(buffer, line.a);
+	}
+
+	void decode(const char** data, Line* line)
+	{
+		line->x1 = get<float>(data);
+		line->y1 = get<float>(data);
+		line->x2 = get<float>(data);
+		line->y2 = get<float>(data);
+		line->width = get<float>(data);
+		line->r = get<float>(data);
+		line->g = get<float>(data);
+		line->b = get<float>(data);
+		line->a = get<float>(data);
+	}
+
+	size_t memory_size(const Line&)
+	{
+		return sizeof(Line);
+	}
+
+	// Points are stored as their number followed by the coordinates.
+	size_t points_size(const PointVector& points)
+	{
+		return sizeof(std::uint32_t) + 2 * sizeof(float) * points.size();
+	}
+
+	void encode_points(const PointVector& points,
+	                   std::vector<char>* buffer)
+	{
+		put(buffer, std::uint32_t(points.size()));
+		for (auto& point : points) {
+			put(buffer, point.first);
+			put(buffer, point.second);
+		}
+	}
+
+	void decode_points(const char** data, PointVector* points)
+	{
+		points->resize(get<std::uint32_t>(data));
+		for (auto& point : *points) {
+			point.first = get<float>(data);
+			point.second = get<float>(data);
+		}
+	}
+
+	// A polygon is stored as r, g, b, a, a word that is 1 if it is
+	// stroked, the stroke color and width if so, and its points.
+	size_t record_size(const Polygon& polygon)
+	{
+		return 4 * sizeof(float) + sizeof(std::uint32_t) +
+		       (polygon.stroked ? 5 * sizeof(float) : 0) +
+		       points_size(polygon.points);
+	}
+
+	void encode(const Polygon& polygon, std::vector<char>* buffer)
+	{
+		put(buffer, polygon.r);
+		put(buffer, polygon.g);
+		put(buffer, polygon.b);
+		put(buffer, polygon.a);
+		put(buffer, std::uint32_t(polygon.stroked ? 1 : 0));
+		if (polygon.stroked) {
+			put(buffer, polygon.stroke_r);
+			put(buffer, polygon.stroke_g);
+			put(buffer, polygon.stroke_b);
+			put(buffer, polygon.stroke_a);
+			put(buffer, polygon.stroke_width);
+		}
+		encode_points(polygon.points, buffer);
+	}
+
+	void decode(const char** data, Polygon* polygon)
+	{
+		polygon->r = get<float>(data);
+		polygon->g = get<float>(data);
+		polygon->b = get<float>(data);
+		polygon->a = get<float>(data);
+		polygon->stroked = get<std::uint32_t>(data) != 0;
+		if (polygon->stroked) {
+			polygon->stroke_r = get<float>(data);
+			polygon->stroke_g = get<float>(data);
+			polygon->stroke_b = get<float>(data);
+			polygon->stroke_a = get<float>(data);
+			polygon->stroke_width = get<float>(data);
+		}
+		decode_points(data, &polygon->points);
+	}
+
+	size_t memory_size(const Polygon& polygon)
+	{
+		return sizeof(Polygon) + sizeof(polygon.points[0]) * polygon.points.size();
+	}
+
+	// A style is stored as the fill color, the stroke color, the stroke
+	// width and a word of flags. The colors include their opacity.
+	const size_t style_size = 9 * sizeof(float) + sizeof(std::uint32_t);
+
+	void encode_style(const ShapeStyle& style, std::vector<char>* buffer)
+	{
+		put(buffer, style.r);
+		put(buffer, style.g);
+		put(buffer, style.b);
+		put(buffer, style.a);
+		put(buffer, style.stroke_r);
+		put(buffer, style.stroke_g);
+		put(buffer, style.stroke_b);
+		put(buffer, style.stroke_a);
+		put(buffer, style.stroke_width);
+		put(buffer, std::uint32_t((style.filled ? 1 : 0) | (style.stroked ? 2 : 0) |
+		                          (style.even_odd ? 4 : 0)));
+	}
+
+	void decode_style(const char** data, ShapeStyle* style)
+	{
+		style->r = get<float>(data);
+		style->g = get<float>(data);
+		style->b = get<float>(data);
+		style->a = get<float>(data);
+		style->stroke_r = get<float>(data);
+		style->stroke_g = get<float>(data);
+		style->stroke_b = get<float>(data);
+		style->stroke_a = get<float>(data);
+		style->stroke_width = get<float>(data);
+		std::uint32_t flags = get<std::uint32_t>(data);
+		style->filled = (flags & 1) != 0;
+		style->stroked = (flags & 2) != 0;
+		style->even_odd = (flags & 4) != 0;
+	}
+
+	// A path is stored as its style, the numbers of commands and
+	// coordinates, the commands and the coordinates.
+	size_t record_size(const Path& path)
+	{
+		return style_size + 2 * sizeof(std::uint32_t) +
+		       path.commands.size() + sizeof(float) * path.coordinates.size();
+	}
+
+	void encode(const Path& path, std::vector<char>* buffer)
+	{
+		encode_style(path.style, buffer);
+		put(buffer, std::uint32_t(path.commands.size()));
+		put(buffer, std::uint32_t(path.coordinates.size()));
+		buffer->insert(buffer->end(), path.commands.begin(), path.commands.end());
+		for (auto coordinate : path.coordinates) {
+			put(buffer, coordinate);
+		}
+	}
+
+	void decode(const char** data, Path* path)
+	{
+		decode_style(data, &path->style);
+		std::uint32_t num_commands = get<std::uint32_t>(data);
+		path->coordinates.resize(get<std::uint32_t>(data));
+		path->commands.assign(*data, *data + num_commands);
+		*data += num_commands;
+		for (auto& coordinate : path->coordinates) {
+			coordinate = get<float>(data);
+		}
+	}
+
+	size_t memory_size(const Path& path)
+	{
+		return sizeof(Path) + path.commands.size() +
+		       sizeof(float) * path.coordinates.size();
+	}
+
+	// A polyline is stored as its style and its points.
+	size_t record_size(const Polyline& polyline)
+	{
+		return style_size + points_size(polyline.points);
+	}
+
+	void encode(const Polyline& polyline, std::vector<char>* buffer)
+	{
+		encode_style(polyline.style, buffer);
+		encode_points(polyline.points, buffer);
+	}
+
+	void decode(const char** data, Polyline* polyline)
+	{
+		decode_style(data, &polyline->style);
+		decode_points(data, &polyline->points);
+	}
+
+	size_t memory_size(const Polyline& polyline)
+	{
+		return sizeof(Polyline) + sizeof(polyline.points[0]) * polyline.points.size();
+	}
+
+	// Rects and ellipses are stored as their style and six floats.
+	size_t record_size(const Rectangle&)
+	{
+		return style_size + 6 * sizeof(float);
+	}
+
+	void encode(const Rectangle& rectangle, std::vector<char>* buffer)
+	{
+		encode_style(rectangle.style, buffer);
+		put(buffer, rectangle.x);
+		put(buffer, rectangle.y);
+		put(buffer, rectangle.ux);
+		put(buffer, rectangle.uy);
+		put(buffer, rectangle.vx);
+		put(buffer, rectangle.vy);
+	}
+
+	void decode(const char** data, Rectangle* rectangle)
+	{
+		decode_style(data, &rectangle->style);
+		rectangle->x = get<float>(data);
+		rectangle->y = get<float>(data);
+		rectangle->ux = get<float>(data);
+		rectangle->uy = get<float>(data);
+		rectangle->vx = get<float>(data);
+		rectangle->vy = get<float>(data);
+	}
+
+	size_t memory_size(const Rectangle&)
+	{
+		return sizeof(Rectangle);
+	}
+
+	size_t record_size(const Ellipse&)
+	{
+		return style_size + 6 * sizeof(float);
+	}
+
+	void encode(const Ellipse& ellipse, std::vector<char>* buffer)
+	{
+		encode_style(ellipse.style, buffer);
+		put(buffer, ellipse.cx);
+		put(buffer, ellipse.cy);
+		put(buffer, ellipse.ux);
+		put(buffer, ellipse.uy);
+		put(buffer, ellipse.vx);
+		put(buffer, ellipse.vy);
+	}
+
+	void decode(const char** data, Ellipse* ellipse)
+	{
+		decode_style(data, &ellipse->style);
+		ellipse->cx = get<float>(data);
+		ellipse->cy = get<float>(data);
+		ellipse->ux = get<float>(data);
+		ellipse->uy = get<float>(data);
+		ellipse->vx = get<float>(data);
+		ellipse->vy = get<float>(data);
+	}
+
+	size_t memory_size(const Ellipse&)
+	{
+		return sizeof(Ellipse);
+	}
+
+	// Size of an element in the store: its position in document order and
+	// its record.
+	template<typename Element>
+	size_t stored_size(const Element& element)
+	{
+		return sizeof(std::uint32_t) + record_size(element);
+	}
+
+	// Decodes num_elements elements and returns the memory they use.
+	template<typename Element>
+	size_t decode_elements(const char** data, std::uint32_t num_elements,
+	                       std::vector<Element>* elements)
+	{
+		size_t bytes = 0;
+		elements->resize(num_elements);
+		for (auto& element : *elements) {
+			element.order = get<std::uint32_t>(data);
+			decode(data, &element);
+			bytes += memory_size(element);
+		}
+		return bytes;
+	}
+
+	// Tile of the grid containing the center of the box.
+	size_t tile_index(const Rect& box, double width, double height,
+	                  int tiles_x, int tiles_y)
+	{
+		double x = (box.x_min + box.x_max) / 2;
+		double y = (box.y_min + box.y_max) / 2;
+		int tx = int(x / width * tiles_x);
+		int ty = int(y / height * tiles_y);
+		tx = std::max(0, std::min(tiles_x - 1, tx));
+		ty = std::max(0, std::min(tiles_y - 1, ty));
+		return size_t(ty) * tiles_x + tx;
+	}
+
+	// Partitions the elements of an SVG into tiles. The SVG is streamed
+	// twice: the first pass measures the tiles and the second writes the
+	// elements.
+	class StoreWriter
+	{
+	public:
+		StoreWriter(int tiles_x_, int tiles_y_) :
+			tiles_x(tiles_x_), tiles_y(tiles_y_),
+			width(1), height(1), num_orders(0),
+			entries(size_t(tiles_x_) * tiles_y_),
+			tile_empty(entries.size(), true),
+			cursors(entries.size() * NumElementTypes),
+			buffers(entries.size() * NumElementTypes),
+			fout(0)
+		{
+			for (auto& entry : entries) {
+				std::memset(&entry, 0, sizeof(entry));
+			}
+		}
+
+		// First pass.
+		template<typename Element>
+		void measure(const Element& element, ElementType type)
+		{
+			Rect box = element.bounding_box();
+			size_t index = tile_index(box, width, height, tiles_x, tiles_y);
+			auto& entry = entries[index];
+			if (tile_empty[index]) {
+				entry.x_min = box.x_min;
+				entry.y_min = box.y_min;
+				entry.x_max = box.x_max;
+				entry.y_max = box.y_max;
+				tile_empty[index] = false;
+			}
+			entry.x_min = std::min(entry.x_min, box.x_min);
+			entry.y_min = std::min(entry.y_min, box.y_min);
+			entry.x_max = std::max(entry.x_max, box.x_max);
+			entry.y_max = std::max(entry.y_max, box.y_max);
+			entry.size += stored_size(element);
+			entry.memory += memory_size(element);
+			entry.num_elements[type]++;
+			// Until the layout, the cursors hold the bytes of every type.
+			cursors[index * NumElementTypes + type] += stored_size(element);
+			num_orders = std::max(num_orders, element.order + 1);
+		}
+
+		// Places the tiles in the store. The elements of a tile are
+		// stored by type. Returns the size of the store.
+		std::uint64_t layout()
+		{
+			std::uint64_t offset = sizeof(StoreHeader) +
+			                       entries.size() * sizeof(StoreTileEntry);
+			for (size_t i = 0; i < entries.size(); ++i) {
+				offset = (offset + page_size - 1) / page_size * page_size;
+				entries[i].offset = offset;
+				for (int t = 0; t < NumElementTypes; ++t) {
+					std::uint64_t bytes = cursors[i * NumElementTypes + t];
+					cursors[i * NumElementTypes + t] = offset;
+					offset += bytes;
+				}
+			}
+			return offset;
+		}
+
+		// Second pass. Every tile gathers its records in small buffers,
+		// so the store is written in large pieces.
+		template<typename Element>
+		void write(const Element& element, ElementType type)
+		{
+			const size_t flush_size = 64 * 1024;
+			size_t index = tile_index(element.bounding_box(), width, height,
+			                          tiles_x, tiles_y);
+			size_t buffer = index * NumElementTypes + type;
+			put(&buffers[buffer], element.order);
+			encode(element, &buffers[buffer]);
+			if (buffers[buffer].size() >= flush_size) {
+				flush(buffer);
+			}
+		}
+
+		void flush(size_t buffer)
+		{
+			if (buffers[buffer].empty()) {
+				return;
+			}
+			fout->seekp(cursors[buffer]);
+			fout->write(&buffers[buffer][0], buffers[buffer].size());
+			cursors[buffer] += buffers[buffer].size();
+			buffers[buffer].clear();
+		}
+
+		const int tiles_x, tiles_y;
+		double width, height;
+		std::uint32_t num_orders;
+		std::vector<StoreTileEntry> entries;
+		std::vector<bool> tile_empty;
+		std::vector<std::uint64_t> cursors;
+		std::vector<std::vector<char> > buffers;
+		std::ofstream* fout;
+	};
+}
+
+void convert_to_scene_store(const std::string& svg_filename,
+                            const std::string& store_filename,
+                            int tiles_per_side)
+{
+	using namespace std;
+
+	const int tiles_x = max(1, min(int(max_tiles_per_side), tiles_per_side));
+	const int tiles_y = tiles_x;
+	StoreWriter writer(tiles_x, tiles_y);
+
+	StreamCallbacks measure;
+	measure.on_size = [&](double svg_width, double svg_height)
+	{
+		writer.width = svg_width;
+		writer.height = svg_height;
+	};
+	measure.on_line = [&](Line& e) { writer.measure(e, LineElement); };
+	measure.on_polygon = [&](Polygon& e) { writer.measure(e, PolygonElement); };
+	measure.on_path = [&](Path& e) { writer.measure(e, PathElement); };
+	measure.on_polyline = [&](Polyline& e) { writer.measure(e, PolylineElement); };
+	measure.on_rectangle = [&](Rectangle& e) { writer.measure(e, RectangleElement); };
+	measure.on_ellipse = [&](Ellipse& e) { writer.measure(e, EllipseElement); };
+	stream_svg_file(svg_filename, measure);
+	uint64_t store_size = writer.layout();
+
+	ofstream fout(store_filename, ios::binary | ios::out | ios::trunc);
+	if (!fout) {
+		throw runtime_error("Could not create scene store.");
+	}
+	writer.fout = &fout;
+
+	StoreHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, store_magic, sizeof(store_magic));
+	header.version = store_version;
+	header.tiles_x = tiles_x;
+	header.tiles_y = tiles_y;
+	header.num_orders = writer.num_orders;
+	header.width = writer.width;
+	header.height = writer.height;
+	fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	fout.write(reinterpret_cast<const char*>(&writer.entries[0]),
+	           writer.entries.size() * sizeof(StoreTileEntry));
+
+	StreamCallbacks write;
+	write.on_line = [&](Line& e) { writer.write(e, LineElement); };
+	write.on_polygon = [&](Polygon& e) { writer.write(e, PolygonElement); };
+	write.on_path = [&](Path& e) { writer.write(e, PathElement); };
+	write.on_polyline = [&](Polyline& e) { writer.write(e, PolylineElement); };
+	write.on_rectangle = [&](Rectangle& e) { writer.write(e, RectangleElement); };
+	write.on_ellipse = [&](Ellipse& e) { writer.write(e, EllipseElement); };
+	stream_svg_file(svg_filename, write);
+	for (size_t i = 0; i < writer.buffers.size(); ++i) {
+		writer.flush(i);
+	}
+
+	if (!fout) {
+		throw runtime_error("Failed to write scene store.");
+	}
+	cerr << "Wrote " << tiles_x << " x " << tiles_y << " tiles ("
+	     << store_size << " bytes) to " << store_filename << ".\n";
+}
+
+SceneStore::SceneStore(const std::string& filename_in, size_t memory_budget_in) :
+	filename(filename_in),
+	file_descriptor(-1),
+	mapping(0),
+	mapping_size(0),
+	width(1),
+	height(1),
+	num_orders(0),
+	memory_budget(memory_budget_in),
+	resident_bytes(0),
+	num_updates(0)
+{
+	using namespace std;
+
+	ifstream fin(filename, ios::binary | ios::in);
+	if (!fin) {
+		throw runtime_error("Could not open scene store.");
+	}
+	StoreHeader header;
+	if (!fin.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+	    memcmp(header.magic, store_magic, sizeof(store_magic)) != 0) {
+		throw runtime_error("Not a scene store.");
+	}
+	if (header.version != store_version) {
+		throw runtime_error("Unsupported scene store version.");
+	}
+	width = header.width;
+	height = header.height;
+	num_orders = header.num_orders;
+
+	// The counts are checked against the size of the store before
+	// anything is allocated for them.
+	if (header.tiles_x == 0 || header.tiles_y == 0 ||
+	    header.tiles_x > max_tiles_per_side || header.tiles_y > max_tiles_per_side) {
+		throw runtime_error("Scene store has an invalid number of tiles.");
+	}
+	fin.seekg(0, ios::end);
+	uint64_t store_size = uint64_t(fin.tellg());
+	fin.seekg(sizeof(header), ios::beg);
+	uint64_t num_tiles = uint64_t(header.tiles_x) * header.tiles_y;
+	if (sizeof(header) + num_tiles * sizeof(StoreTileEntry) > store_size) {
+		throw runtime_error("Scene store is truncated.");
+	}
+	vector<StoreTileEntry> entries(num_tiles);
+	if (!fin.read(reinterpret_cast<char*>(&entries[0]),
+	              num_tiles * sizeof(StoreTileEntry))) {
+		throw runtime_error("Scene store is truncated.");
+	}
+	for (auto& entry : entries) {
+		size_t num_elements = 0;
+		for (int t = 0; t < NumElementTypes; ++t) {
+			num_elements += entry.num_elements[t];
+		}
+		if (num_elements == 0) {
+			continue;
+		}
+		if (entry.offset > store_size || entry.size > store_size - entry.offset) {
+			throw runtime_error("Scene store is truncated.");
+		}
+		SceneTile tile;
+		tile.bounds = Rect(entry.x_min, entry.y_min, entry.x_max, entry.y_max);
+		tile.offset = entry.offset;
+		tile.size = entry.size;
+		tile.memory = entry.memory;
+		for (int t = 0; t < NumElementTypes; ++t) {
+			tile.num_elements[t] = entry.num_elements[t];
+		}
+		tiles.push_back(tile);
+	}
+
+	#ifndef _WIN32
+		file_descriptor = open(filename.c_str(), O_RDONLY);
+		if (file_descriptor < 0) {
+			throw runtime_error("Could not open scene store.");
+		}
+		struct stat info;
+		fstat(file_descriptor, &info);
+		mapping_size = info.st_size;
+		void* address = mmap(0, mapping_size, PROT_READ, MAP_SHARED,
+		                     file_descriptor, 0);
+		if (address == MAP_FAILED) {
+			close(file_descriptor);
+			throw runtime_error("Could not map scene store.");
+		}
+		mapping = static_cast<char*>(address);
+	#endif
+
+	cerr << "Scene store has " << tiles.size() << " non-empty tiles.\n";
+}
+
+SceneStore::~SceneStore()
+{
+	#ifndef _WIN32
+		munmap(mapping, mapping_size);
+		close(file_descriptor);
+	#endif
+}
+
+void SceneStore::tiles_intersecting(const Rect& view,
+                                    std::vector<SceneTile*>* result)
+{
+	result->clear();
+	for (auto& tile : tiles) {
+		if (tile.bounds.intersects(view)) {
+			result->push_back(&tile);
+		}
+	}
+}
+
+void SceneStore::page_in(SceneTile* tile)
+{
+	if (tile->resident) {
+		return;
+	}
+
+	#ifndef _WIN32
+		const char* data = mapping + tile->offset;
+	#else
+		std::vector<char> buffer(tile->size);
+		std::ifstream fin(filename, std::ios::binary | std::ios::in);
+		fin.seekg(tile->offset);
+		fin.read(&buffer[0], buffer.size());
+		const char* data = &buffer[0];
+	#endif
+
+	size_t bytes = 0;
+	bytes += decode_elements(&data, tile->num_elements[LineElement], &tile->lines);
+	bytes += decode_elements(&data, tile->num_elements[PolygonElement], &tile->polygons);
+	bytes += decode_elements(&data, tile->num_elements[PathElement], &tile->paths);
+	bytes += decode_elements(&data, tile->num_elements[PolylineElement], &tile->polylines);
+	bytes += decode_elements(&data, tile->num_elements[RectangleElement], &tile->rectangles);
+	bytes += decode_elements(&data, tile->num_elements[EllipseElement], &tile->ellipses);
+
+	#ifndef _WIN32
+		// The decoded geometry is what counts against the budget, so the
+		// mapped pages are handed back to the kernel.
+		madvise(mapping + tile->offset, tile->size, MADV_DONTNEED);
+	#endif
+
+	tile->resident = true;
+	tile->bytes = bytes;
+	resident_bytes += tile->bytes;
+}
+
+void SceneStore::page_out(SceneTile* tile)
+{
+	if (!tile->resident) {
+		return;
+	}
+	std::vector<Line>().swap(tile->lines);
+	std::vector<Polygon>().swap(tile->polygons);
+	std::vector<Path>().swap(tile->paths);
+	std::vector<Polyline>().swap(tile->polylines);
+	std::vector<Rectangle>().swap(tile->rectangles);
+	std::vector<Ellipse>().swap(tile->ellipses);
+	tile->resident = false;
+	resident_bytes -= tile->bytes;
+	tile->bytes = 0;
+}
+
+void SceneStore::enforce_budget()
+{
+	if (resident_bytes <= memory_budget) {
+		return;
+	}
+
+	std::vector<SceneTile*> candidates;
+	for (auto& tile : tiles) {
+		if (tile.resident && tile.last_used != num_updates) {
+			candidates.push_back(&tile);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(),
+		[](const SceneTile* a, const SceneTile* b)
+		{
+			return a->last_used < b->last_used;
+		});
+	for (auto tile : candidates) {
+		if (resident_bytes <= memory_budget) {
+			break;
+		}
+		page_out(tile);
+	}
+}
+
+void SceneStore::update_view(const Rect& view)
+{
+	num_updates++;
+
+	tiles_intersecting(view, &visible);
+	for (auto tile : visible) {
+		tile->last_used = num_updates;
+		page_in(tile);
+	}
+	enforce_budget();
+
+	// Prefetch the area one view ahead in the direction of the pan.
+	float dx = (view.x_min + view.x_max) - (last_view.x_min + last_view.x_max);
+	float dy = (view.y_min + view.y_max) - (last_view.y_min + last_view.y_max);
+	bool same_size = view.x_max - view.x_min == last_view.x_max - last_view.x_min &&
+	                 view.y_max - view.y_min == last_view.y_max - last_view.y_min;
+	last_view = view;
+	if (num_updates == 1 || !same_size || (dx == 0 && dy == 0)) {
+		return;
+	}
+
+	float view_width = view.x_max - view.x_min;
+	float view_height = view.y_max - view.y_min;
+	float length = std::sqrt(dx * dx + dy * dy);
+	float shift_x = dx / length * view_width;
+	float shift_y = dy / length * view_height;
+	Rect ahead(view.x_min + shift_x, view.y_min + shift_y,
+	           view.x_max + shift_x, view.y_max + shift_y);
+
+	std::vector<SceneTile*> ahead_tiles;
+	tiles_intersecting(ahead, &ahead_tiles);
+	for (auto tile : ahead_tiles) {
+		if (!tile->resident && !tile->queued) {
+			tile->queued = true;
+			prefetch_queue.push_back(tile);
+			#ifndef _WIN32
+				// Let the kernel start reading the pages right away.
+				madvise(mapping + tile->offset / page_size * page_size,
+				        tile->size + tile->offset % page_size, MADV_WILLNEED);
+			#endif
+		}
+	}
+}
+
+bool SceneStore::prefetch()
+{
+	while (!prefetch_queue.empty()) {
+		SceneTile* tile = prefetch_queue.front();
+		prefetch_queue.pop_front();
+		tile->queued = false;
+		if (tile->resident) {
+			continue;
+		}
+		// Prefetched tiles must not push visible tiles out.
+		if (resident_bytes + tile->memory > memory_budget) {
+			for (auto queued_tile : prefetch_queue) {
+				queued_tile->queued = false;
+			}
+			prefetch_queue.clear();
+			return false;
+		}
+		tile->last_used = num_updates;
+		page_in(tile);
+		return true;
+	}
+	return false;
+}
+
+}
@@ -0,0 +1,117 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_SCENE_STORE_H
+#define RAPIDSVG_SCENE_STORE_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "group.h"
+#include "line.h"
+#include "path.h"
+#include "polygon.h"
+#include "rect.h"
+#include "shapes.h"
+
+namespace rapidsvg {
+
+// Converts an SVG file into an out-of-core scene store. The elements are
+// partitioned into a grid of tiles, each stored in its own page-aligned
+// block of the store. The SVG is streamed and never held in memory.
+void convert_to_scene_store(const std::string& svg_filename,
+                            const std::string& store_filename,
+                            int tiles_per_side = 32);
+
+// A tile of a scene store.
+class SceneTile
+{
+public:
+	SceneTile() : offset(0), size(0), memory(0),
+	              resident(false), queued(false), last_used(0), bytes(0)
+	{
+		for (int t = 0; t < NumElementTypes; ++t) {
+			num_elements[t] = 0;
+		}
+	}
+	// Union of the bounding boxes of the elements in the tile.
+	Rect bounds;
+	// Location of the tile in the store.
+	std::uint64_t offset, size;
+	// Memory used by the geometry when paged in.
+	std::uint64_t memory;
+	// Number of elements of every type.
+	std::uint32_t num_elements[NumElementTypes];
+
+	// Whether the geometry is paged in.
+	bool resident;
+	// Whether the tile is waiting to be prefetched.
+	bool queued;
+	// View update the tile was last visible in.
+	size_t last_used;
+	// Memory used by the paged-in geometry.
+	size_t bytes;
+	std::vector<Line> lines;
+	std::vector<Polygon> polygons;
+	std::vector<Path> paths;
+	std::vector<Polyline> polylines;
+	std::vector<Rectangle> rectangles;
+	std::vector<Ellipse> ellipses;
+};
+
+// A scene stored out of core. Tiles are paged in from the memory-mapped
+// store as they come into view and paged out, least recently used first,
+// when the resident geometry exceeds the memory budget.
+class SceneStore
+{
+public:
+	SceneStore(const std::string& filename, size_t memory_budget);
+	~SceneStore();
+
+	double get_width() const { return width; }
+	double get_height() const { return height; }
+	// Number of positions in document order of the elements, which are
+	// drawn in that order.
+	size_t get_num_orders() const { return num_orders; }
+
+	// Pages in the tiles intersecting the view and schedules the tiles
+	// ahead of it, in the direction it moved, for prefetching.
+	void update_view(const Rect& view);
+	// Pages in one scheduled tile. Returns false if none are left.
+	bool prefetch();
+
+	// Resident tiles intersecting the last view.
+	const std::vector<SceneTile*>& visible_tiles() const { return visible; }
+	size_t get_resident_bytes() const { return resident_bytes; }
+
+private:
+	SceneStore(const SceneStore&);
+	SceneStore& operator=(const SceneStore&);
+
+	void tiles_intersecting(const Rect& view, std::vector<SceneTile*>* result);
+	void page_in(SceneTile* tile);
+	void page_out(SceneTile* tile);
+	// Pages out tiles not in view until the budget is met.
+	void enforce_budget();
+
+	std::string filename;
+	int file_descriptor;
+	char* mapping;
+	size_t mapping_size;
+
+	double width, height;
+	std::uint32_t num_orders;
+	std::vector<SceneTile> tiles;
+	std::vector<SceneTile*> visible;
+	std::deque<SceneTile*> prefetch_queue;
+
+	size_t memory_budget;
+	size_t resident_bytes;
+	size_t num_updates;
+	Rect last_view;
+};
+
+}
+
+#endif
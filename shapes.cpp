@@ -0,0 +1,149 @@
+// Petter Strandmark 2013.
+
+#include <algorithm>
+#include <cmath>
+
+#include "number_parser.h"
+#include "shapes.h"
+
+namespace rapidsvg {
+
+namespace
+{
+	// Grows box by half of the stroke width, if stroked.
+	Rect add_stroke(Rect box, const ShapeStyle& style)
+	{
+		if (style.stroked) {
+			float radius = style.stroke_width / 2;
+			box.x_min -= radius;
+			box.y_min -= radius;
+			box.x_max += radius;
+			box.y_max += radius;
+		}
+		return box;
+	}
+
+	// Applies the linear part of the transform to the vector (x, y).
+	void transform_vector(const Transform& transform, float* x, float* y)
+	{
+		float new_x = float(transform.a * *x + transform.c * *y);
+		float new_y = float(transform.b * *x + transform.d * *y);
+		*x = new_x;
+		*y = new_y;
+	}
+}
+
+void Polyline::parse_points(const char* points)
+{
+	// Points grow in place, so their exact number is reserved up front.
+	this->points.reserve(this->points.size() + count_numbers(points) / 2);
+	const char* ptr = points;
+	std::pair<float, float> point;
+	while (true) {
+		ptr = skip_separators(ptr);
+		if (!parse_number(&ptr, &point.first)) {
+			break;
+		}
+		ptr = skip_separators(ptr);
+		if (!parse_number(&ptr, &point.second)) {
+			break;
+		}
+		this->points.push_back(point);
+	}
+}
+
+void Polyline::transform(const Transform& transform)
+{
+	if (!points.empty()) {
+		transform.apply(&points[0].first, points.size());
+	}
+	style.stroke_width *= float(transform.scale());
+}
+
+Rect Polyline::bounding_box() const
+{
+	if (points.empty()) {
+		return Rect();
+	}
+	Rect box(points[0].first, points[0].second,
+	         points[0].first, points[0].second);
+	for (auto& point : points) {
+		box.add(point.first, point.second);
+	}
+	return add_stroke(box, style);
+}
+
+void Rectangle::corners(float* xy) const
+{
+	xy[0] = x;
+	xy[1] = y;
+	xy[2] = x + ux;
+	xy[3] = y + uy;
+	xy[4] = x + ux + vx;
+	xy[5] = y + uy + vy;
+	xy[6] = x + vx;
+	xy[7] = y + vy;
+}
+
+void Rectangle::transform(const Transform& transform)
+{
+	transform.apply(&x, 1);
+	transform_vector(transform, &ux, &uy);
+	transform_vector(transform, &vx, &vy);
+	style.stroke_width *= float(transform.scale());
+}
+
+Rect Rectangle::bounding_box() const
+{
+	float xy[8];
+	corners(xy);
+	Rect box(xy[0], xy[1], xy[0], xy[1]);
+	for (int i = 1; i < 4; ++i) {
+		box.add(xy[2 * i], xy[2 * i + 1]);
+	}
+	return add_stroke(box, style);
+}
+
+float Ellipse::max_radius() const
+{
+	// Semi-major axis of the ellipse spanned by the conjugate
+	// semi-diameters u and v.
+	double uu = double(ux) * ux + double(uy) * uy;
+	double vv = double(vx) * vx + double(vy) * vy;
+	double uv = double(ux) * vx + double(uy) * vy;
+	double half_difference = (uu - vv) / 2;
+	return float(std::sqrt((uu + vv) / 2 +
+	                       std::sqrt(half_difference * half_difference + uv * uv)));
+}
+
+int Ellipse::num_segments(float tolerance) const
+{
+	// A chord spanning the angle 2 pi / n is at most r (1 - cos(pi / n))
+	// from a circle of radius r.
+	const int min_segments = 4;
+	const int max_segments = 1024;
+	float radius = max_radius();
+	if (radius <= tolerance) {
+		return min_segments;
+	}
+	double n = std::ceil(3.14159265358979323846 / std::acos(1.0 - tolerance / radius));
+	return int(std::min(std::max(n, double(min_segments)), double(max_segments)));
+}
+
+void Ellipse::transform(const Transform& transform)
+{
+	transform.apply(&cx, 1);
+	transform_vector(transform, &ux, &uy);
+	transform_vector(transform, &vx, &vy);
+	style.stroke_width *= float(transform.scale());
+}
+
+Rect Ellipse::bounding_box() const
+{
+	float half_width = std::sqrt(ux * ux + vx * vx);
+	float half_height = std::sqrt(uy * uy + vy * vy);
+	return add_stroke(Rect(cx - half_width, cy - half_height,
+	                       cx + half_width, cy + half_height), style);
+}
+
+}
@@ -0,0 +1,96 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_SHAPES_H
+#define RAPIDSVG_SHAPES_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "arena.h"
+#include "rect.h"
+#include "style.h"
+#include "transform.h"
+
+namespace rapidsvg {
+
+// Represents a polyline in the SVG file.
+class Polyline
+{
+public:
+	Polyline() : order(0)
+	{ }
+	PointVector points;
+	ShapeStyle style;
+	// Position of the element in the document, as Line::order.
+	std::uint32_t order;
+
+	// Parses a string of points and adds them to the polyline.
+	void parse_points(const char* points);
+
+	// Transforms all points and scales the stroke width.
+	void transform(const Transform& transform);
+
+	// Returns the rectangle covered by the polyline, including its stroke.
+	Rect bounding_box() const;
+};
+
+// Represents a rect in the SVG file. It is stored as a corner and the two
+// edges leaving it, so that it stays a Rectangle under any transform.
+class Rectangle
+{
+public:
+	Rectangle() : x(0), y(0), ux(0), uy(0), vx(0), vy(0), order(0)
+	{ }
+	Rectangle(float x_, float y_, float width, float height) :
+		x(x_), y(y_), ux(width), uy(0), vx(0), vy(height), order(0)
+	{ }
+	float x, y;
+	// The corners are (x, y), (x, y) + u, (x, y) + u + v and (x, y) + v.
+	float ux, uy, vx, vy;
+	ShapeStyle style;
+	std::uint32_t order;
+
+	// Writes the four corners as x0, y0, ..., x3, y3.
+	void corners(float* xy) const;
+
+	// Transforms the corner and the edges and scales the stroke width.
+	void transform(const Transform& transform);
+
+	// Returns the rectangle covered by the rect, including its stroke.
+	Rect bounding_box() const;
+};
+
+// Represents a circle or an ellipse in the SVG file. The points of the
+// ellipse are (cx, cy) + cos(t) * u + sin(t) * v, so that it stays an
+// Ellipse under any transform.
+class Ellipse
+{
+public:
+	Ellipse() : cx(0), cy(0), ux(0), uy(0), vx(0), vy(0), order(0)
+	{ }
+	Ellipse(float cx_, float cy_, float rx, float ry) :
+		cx(cx_), cy(cy_), ux(rx), uy(0), vx(0), vy(ry), order(0)
+	{ }
+	float cx, cy;
+	float ux, uy, vx, vy;
+	ShapeStyle style;
+	std::uint32_t order;
+
+	// Largest distance from the center to the ellipse.
+	float max_radius() const;
+
+	// Number of segments needed to approximate the ellipse with no point
+	// further than tolerance from it.
+	int num_segments(float tolerance) const;
+
+	// Transforms the center and the axes and scales the stroke width.
+	void transform(const Transform& transform);
+
+	// Returns the rectangle covered by the ellipse, including its stroke.
+	Rect bounding_box() const;
+};
+
+}
+
+#endif
@@ -0,0 +1,229 @@
+// Petter Strandmark 2013.
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+#ifdef USE_OPENMP
+	#include <omp.h>
+#else
+	#include <ctime>
+	namespace
+	{
+		double omp_get_wtime()
+		{
+			return std::time(0);
+		}
+		int omp_get_max_threads()
+		{
+			return 1;
+		}
+	}
+#endif
+
+#include "spatial_order.h"
+
+namespace rapidsvg {
+
+namespace
+{
+	// Hilbert key and original index of an element.
+	typedef std::pair<std::uint32_t, std::uint32_t> KeyIndex;
+
+	// Ranges shorter than this are sorted by a single thread.
+	const std::ptrdiff_t parallel_sort_size = 100000;
+
+	// Position of (x, y) in [0, 65535]^2 along a Hilbert curve.
+	std::uint32_t hilbert_index(std::uint32_t x, std::uint32_t y)
+	{
+		const std::uint32_t n = 1u << 16;
+		std::uint32_t d = 0;
+		for (std::uint32_t s = n / 2; s > 0; s /= 2) {
+			std::uint32_t rx = (x & s) > 0;
+			std::uint32_t ry = (y & s) > 0;
+			d += s * s * ((3 * rx) ^ ry);
+			// Rotate the quadrant.
+			if (ry == 0) {
+				if (rx == 1) {
+					x = n - 1 - x;
+					y = n - 1 - y;
+				}
+				std::swap(x, y);
+			}
+		}
+		return d;
+	}
+
+	// Sorts chunks in parallel and merges them pairwise.
+	void parallel_sort(KeyIndex* begin, KeyIndex* end)
+	{
+		int num_chunks = omp_get_max_threads();
+		if (num_chunks <= 1 || end - begin < parallel_sort_size) {
+			std::sort(begin, end);
+			return;
+		}
+
+		std::vector<KeyIndex*> bounds(num_chunks + 1);
+		for (int c = 0; c <= num_chunks; ++c) {
+			bounds[c] = begin + (end - begin) * c / num_chunks;
+		}
+
+		#pragma omp parallel for
+		for (int c = 0; c < num_chunks; ++c) {
+			std::sort(bounds[c], bounds[c + 1]);
+		}
+
+		for (int width = 1; width < num_chunks; width *= 2) {
+			#pragma omp parallel for
+			for (int c = 0; c < num_chunks; c += 2 * width) {
+				if (c + width < num_chunks) {
+					std::inplace_merge(bounds[c], bounds[c + width],
+					                   bounds[std::min(c + 2 * width, num_chunks)]);
+				}
+			}
+		}
+	}
+
+	bool same_style(const Line& a, const Line& b)
+	{
+		return a.width == b.width && a.r == b.r && a.g == b.g && a.b == b.b &&
+		       a.a == b.a;
+	}
+
+	bool same_style(const Polygon& a, const Polygon& b)
+	{
+		if (a.r != b.r || a.g != b.g || a.b != b.b || a.a != b.a ||
+		    a.stroked != b.stroked) {
+			return false;
+		}
+		return !a.stroked ||
+		       (a.stroke_r == b.stroke_r && a.stroke_g == b.stroke_g &&
+		        a.stroke_b == b.stroke_b && a.stroke_a == b.stroke_a &&
+		        a.stroke_width == b.stroke_width);
+	}
+
+	// Whether the elements take consecutive positions in document order,
+	// in any order, so that nothing else is drawn between them.
+	template<typename Element>
+	bool is_contiguous(const Element* begin, const Element* end)
+	{
+		std::uint32_t min_order = begin->order;
+		std::uint32_t max_order = begin->order;
+		for (const Element* element = begin; element != end; ++element) {
+			min_order = std::min(min_order, element->order);
+			max_order = std::max(max_order, element->order);
+		}
+		return size_t(max_order - min_order) + 1 == size_t(end - begin);
+	}
+
+	// Sorts every run of equally styled elements by Hilbert key. Runs
+	// never cross the given boundaries, and runs with other elements
+	// drawn between their elements are left as they are. Returns the
+	// number of runs sorted.
+	template<typename Element>
+	size_t sort_runs(std::vector<Element>* elements, std::vector<int> boundaries)
+	{
+		int n = int(elements->size());
+		if (n == 0) {
+			return 0;
+		}
+
+		std::vector<Rect> boxes(n);
+		#pragma omp parallel for
+		for (int i = 0; i < n; ++i) {
+			boxes[i] = (*elements)[i].bounding_box();
+		}
+		Rect extent = boxes[0];
+		for (auto& box : boxes) {
+			extent.add(box.x_min, box.y_min);
+			extent.add(box.x_max, box.y_max);
+		}
+
+		std::vector<KeyIndex> keys(n);
+		#pragma omp parallel for
+		for (int i = 0; i < n; ++i) {
+			keys[i] = KeyIndex(hilbert_key(boxes[i], extent), std::uint32_t(i));
+		}
+
+		std::sort(boundaries.begin(), boundaries.end());
+		auto boundary = boundaries.begin();
+		std::vector<int> run_starts(1, 0);
+		for (int i = 1; i < n; ++i) {
+			while (boundary != boundaries.end() && *boundary < i) {
+				++boundary;
+			}
+			bool at_boundary = boundary != boundaries.end() && *boundary == i;
+			if (at_boundary || !same_style((*elements)[i - 1], (*elements)[i])) {
+				run_starts.push_back(i);
+			}
+		}
+		run_starts.push_back(n);
+		std::vector<int> runs;
+		for (size_t run = 0; run + 1 < run_starts.size(); ++run) {
+			const Element* begin = &(*elements)[0] + run_starts[run];
+			const Element* end = &(*elements)[0] + run_starts[run + 1];
+			if (is_contiguous(begin, end)) {
+				runs.push_back(run_starts[run]);
+				runs.push_back(run_starts[run + 1]);
+			}
+		}
+		int num_runs = int(runs.size()) / 2;
+
+		// Short runs are sorted in parallel with each other and long runs
+		// are sorted in parallel one at a time.
+		#pragma omp parallel for schedule(dynamic)
+		for (int run = 0; run < num_runs; ++run) {
+			if (runs[2 * run + 1] - runs[2 * run] < parallel_sort_size) {
+				std::sort(&keys[0] + runs[2 * run], &keys[0] + runs[2 * run + 1]);
+			}
+		}
+		for (int run = 0; run < num_runs; ++run) {
+			if (runs[2 * run + 1] - runs[2 * run] >= parallel_sort_size) {
+				parallel_sort(&keys[0] + runs[2 * run], &keys[0] + runs[2 * run + 1]);
+			}
+		}
+
+		std::vector<Element> sorted(n);
+		#pragma omp parallel for
+		for (int i = 0; i < n; ++i) {
+			sorted[i] = std::move((*elements)[keys[i].second]);
+		}
+		elements->swap(sorted);
+		return num_runs;
+	}
+}
+
+std::uint32_t hilbert_key(const Rect& box, const Rect& extent)
+{
+	double width = std::max(double(extent.x_max) - extent.x_min, 1e-30);
+	double height = std::max(double(extent.y_max) - extent.y_min, 1e-30);
+	double x = ((box.x_min + box.x_max) / 2 - extent.x_min) / width;
+	double y = ((box.y_min + box.y_max) / 2 - extent.y_min) / height;
+	x = std::max(0.0, std::min(1.0, x));
+	y = std::max(0.0, std::min(1.0, y));
+	return hilbert_index(std::uint32_t(x * 65535), std::uint32_t(y * 65535));
+}
+
+void sort_spatially(const std::vector<Group>& groups,
+                    std::vector<Line>* lines,
+                    std::vector<Polygon>* polygons)
+{
+	double start_time = ::omp_get_wtime();
+
+	std::vector<int> line_boundaries, polygon_boundaries;
+	for (auto& group : groups) {
+		line_boundaries.push_back(int(group.first[LineElement]));
+		line_boundaries.push_back(int(group.end[LineElement]));
+		polygon_boundaries.push_back(int(group.first[PolygonElement]));
+		polygon_boundaries.push_back(int(group.end[PolygonElement]));
+	}
+
+	size_t line_runs = sort_runs(lines, line_boundaries);
+	size_t polygon_runs = sort_runs(polygons, polygon_boundaries);
+	double end_time = ::omp_get_wtime();
+	std::cerr << "Sorted spatially in " << end_time - start_time << " seconds ("
+	          << line_runs << " line runs, " << polygon_runs
+	          << " polygon runs).\n";
+}
+
+}
@@ -0,0 +1,34 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_SPATIAL_ORDER_H
+#define RAPIDSVG_SPATIAL_ORDER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "group.h"
+#include "line.h"
+#include "polygon.h"
+#include "rect.h"
+
+namespace rapidsvg {
+
+// Position of the center of box along a Hilbert curve covering extent.
+std::uint32_t hilbert_key(const Rect& box, const Rect& extent);
+
+// Sorts the lines and polygons along a Hilbert curve, so that elements
+// close to each other in the plane are close in memory. Elements keep
+// their positions in document order, which they are drawn in. Only runs
+// of consecutive elements with identical style and nothing else drawn
+// between them are reordered, so that they can still be drawn as one,
+// e.g. as chunks of indexed lines. Runs are also split at group
+// boundaries, so the ranges of the groups stay valid. The curve covers
+// the bounding box of the elements of each type, so the size of the SVG
+// does not matter.
+void sort_spatially(const std::vector<Group>& groups,
+                    std::vector<Line>* lines,
+                    std::vector<Polygon>* polygons);
+
+}
+
+#endif
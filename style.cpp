@@ -0,0 +1,307 @@
+// Petter Strandmark 2013.
+
+#include <cstdlib>
+#include <cstring>
+
+#include "color.h"
+#include "line.h"
+#include "polygon.h"
+#include "style.h"
+
+namespace rapidsvg {
+
+namespace
+{
+	bool is_space(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f';
+	}
+
+	// Removes leading and trailing white space by moving the start and
+	// terminating the string early.
+	char* trim(char* text)
+	{
+		while (is_space(*text)) {
+			text++;
+		}
+		char* end = text + std::strlen(text);
+		while (end > text && is_space(end[-1])) {
+			end--;
+		}
+		*end = '\0';
+		return text;
+	}
+
+	// Whether value is keyword, ignoring trailing white space.
+	bool is_keyword(const char* value, const char* keyword)
+	{
+		size_t length = std::strlen(keyword);
+		if (std::strncmp(value, keyword, length) != 0) {
+			return false;
+		}
+		for (value += length; is_space(*value); ++value) {
+		}
+		return *value == '\0';
+	}
+
+	// Whether value asks for the default of a property. There is no
+	// inheritance from groups and no color property, so inherit and
+	// currentColor both mean the default.
+	bool is_default(const char* value)
+	{
+		return is_keyword(value, "inherit") || is_keyword(value, "currentColor") ||
+		       is_keyword(value, "currentcolor");
+	}
+
+	// Parses a fill or stroke: none, a color or a url() reference with an
+	// optional fallback. Paint servers such as gradients are not
+	// supported, so references are painted with their fallback, or not at
+	// all without one. Returns false if the paint is invalid.
+	bool parse_paint(const char* value, bool* painted,
+	                 float* r, float* g, float* b, float* alpha)
+	{
+		if (std::strncmp(value, "url(", 4) == 0) {
+			const char* end = std::strchr(value, ')');
+			if (!end) {
+				return false;
+			}
+			for (value = end + 1; is_space(*value); ++value) {
+			}
+			if (*value == '\0') {
+				*painted = false;
+				return true;
+			}
+		}
+		bool painted_value = !is_keyword(value, "none");
+		if (painted_value && !parse_color(value, r, g, b, alpha)) {
+			return false;
+		}
+		*painted = painted_value;
+		return true;
+	}
+}
+
+bool StyleProperties::parse_property(const char* name, const char* value)
+{
+	using namespace std;
+
+	while (is_space(*value)) {
+		value++;
+	}
+	Property property;
+	if (strcmp(name, "fill") == 0) {
+		property = Fill;
+	}
+	else if (strcmp(name, "stroke") == 0) {
+		property = Stroke;
+	}
+	else if (strcmp(name, "stroke-width") == 0) {
+		property = StrokeWidth;
+	}
+	else if (strcmp(name, "fill-opacity") == 0) {
+		property = FillOpacity;
+	}
+	else if (strcmp(name, "stroke-opacity") == 0) {
+		property = StrokeOpacity;
+	}
+	else if (strcmp(name, "opacity") == 0) {
+		property = Opacity;
+	}
+	else if (strcmp(name, "fill-rule") == 0) {
+		property = FillRule;
+	}
+	else {
+		return true;
+	}
+	if (is_default(value)) {
+		set_default(property);
+		return true;
+	}
+
+	bool valid = true;
+	switch (property) {
+	case Fill:
+		valid = parse_paint(value, &filled, &r, &g, &b, &fill_alpha);
+		break;
+	case Stroke:
+		valid = parse_paint(value, &stroked, &stroke_r, &stroke_g, &stroke_b,
+		                    &stroke_alpha);
+		break;
+	case StrokeWidth:
+		stroke_width = float(std::atof(value));
+		break;
+	case FillOpacity:
+		valid = parse_opacity(value, &fill_opacity);
+		break;
+	case StrokeOpacity:
+		valid = parse_opacity(value, &stroke_opacity);
+		break;
+	case Opacity:
+		valid = parse_opacity(value, &opacity);
+		break;
+	case FillRule:
+		even_odd = is_keyword(value, "evenodd");
+		valid = even_odd || is_keyword(value, "nonzero");
+		break;
+	}
+	// Invalid values are left at the value read before, if any.
+	if (valid) {
+		set(property);
+	}
+	return valid;
+}
+
+const char* StyleProperties::parse_style(char* style_string)
+{
+	const char* invalid = 0;
+	char* entry = style_string;
+	while (entry) {
+		char* semicolon = std::strchr(entry, ';');
+		if (semicolon) {
+			*semicolon = '\0';
+		}
+		char* colon = std::strchr(entry, ':');
+		if (colon) {
+			*colon = '\0';
+			char* value = trim(colon + 1);
+			if (!parse_property(trim(entry), value) && !invalid) {
+				invalid = value;
+			}
+		}
+		entry = semicolon ? semicolon + 1 : 0;
+	}
+	return invalid;
+}
+
+void StyleProperties::add(const StyleProperties& other)
+{
+	unsigned given = other.properties;
+	properties = (properties & ~other.defaults) | given;
+	defaults = (defaults & ~given) | other.defaults;
+	if (given & Fill) {
+		filled = other.filled;
+		r = other.r;
+		g = other.g;
+		b = other.b;
+		fill_alpha = other.fill_alpha;
+	}
+	if (given & Stroke) {
+		stroked = other.stroked;
+		stroke_r = other.stroke_r;
+		stroke_g = other.stroke_g;
+		stroke_b = other.stroke_b;
+		stroke_alpha = other.stroke_alpha;
+	}
+	if (given & StrokeWidth) {
+		stroke_width = other.stroke_width;
+	}
+	if (given & FillOpacity) {
+		fill_opacity = other.fill_opacity;
+	}
+	if (given & StrokeOpacity) {
+		stroke_opacity = other.stroke_opacity;
+	}
+	if (given & Opacity) {
+		opacity = other.opacity;
+	}
+	if (given & FillRule) {
+		even_odd = other.even_odd;
+	}
+}
+
+void StyleProperties::set(Property property)
+{
+	properties |= property;
+	defaults &= ~property;
+}
+
+void StyleProperties::set_default(Property property)
+{
+	properties &= ~property;
+	defaults |= property;
+}
+
+float StyleProperties::fill_a() const
+{
+	float a = properties & Opacity ? opacity : 1;
+	if (properties & FillOpacity) {
+		a *= fill_opacity;
+	}
+	if (properties & Fill) {
+		a *= filled ? fill_alpha : 0;
+	}
+	return a;
+}
+
+float StyleProperties::stroke_a() const
+{
+	float a = properties & Opacity ? opacity : 1;
+	if (properties & StrokeOpacity) {
+		a *= stroke_opacity;
+	}
+	if (properties & Stroke) {
+		a *= stroked ? stroke_alpha : 0;
+	}
+	return a;
+}
+
+void StyleProperties::apply(Line* line) const
+{
+	if (properties & Stroke) {
+		line->r = stroke_r;
+		line->g = stroke_g;
+		line->b = stroke_b;
+	}
+	if (properties & StrokeWidth) {
+		line->width = stroke_width;
+	}
+	line->a = stroke_a();
+}
+
+void StyleProperties::apply(Polygon* polygon) const
+{
+	if (properties & Fill) {
+		polygon->r = r;
+		polygon->g = g;
+		polygon->b = b;
+	}
+	if (properties & Stroke) {
+		polygon->stroked = stroked;
+		polygon->stroke_r = stroke_r;
+		polygon->stroke_g = stroke_g;
+		polygon->stroke_b = stroke_b;
+	}
+	if (properties & StrokeWidth) {
+		polygon->stroke_width = stroke_width;
+	}
+	polygon->a = fill_a();
+	polygon->stroke_a = stroke_a();
+	polygon->stroked = polygon->stroked && polygon->stroke_width > 0 &&
+	                   polygon->stroke_a > 0;
+}
+
+void StyleProperties::apply(ShapeStyle* shape_style) const
+{
+	if (properties & Fill) {
+		shape_style->filled = filled;
+		shape_style->r = r;
+		shape_style->g = g;
+		shape_style->b = b;
+	}
+	if (properties & Stroke) {
+		shape_style->stroked = stroked;
+		shape_style->stroke_r = stroke_r;
+		shape_style->stroke_g = stroke_g;
+		shape_style->stroke_b = stroke_b;
+	}
+	if (properties & StrokeWidth) {
+		shape_style->stroke_width = stroke_width;
+	}
+	if (properties & FillRule) {
+		shape_style->even_odd = even_odd;
+	}
+	shape_style->a = fill_a();
+	shape_style->stroke_a = stroke_a();
+}
+
+}
@@ -0,0 +1,97 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_STYLE_H
+#define RAPIDSVG_STYLE_H
+
+namespace rapidsvg {
+
+class Line;
+class Polygon;
+
+// Fill and stroke of a shape that can have both. As in SVG, shapes are
+// filled with black and not stroked unless styled otherwise.
+class ShapeStyle
+{
+public:
+	ShapeStyle() : filled(true), r(0), g(0), b(0), a(1),
+	               stroked(false), stroke_r(0), stroke_g(0), stroke_b(0), stroke_a(1),
+	               stroke_width(1), even_odd(false)
+	{ }
+
+	// The opacities a and stroke_a are the alpha of the color times the
+	// opacity properties.
+	bool filled;
+	float r, g, b, a;
+	bool stroked;
+	float stroke_r, stroke_g, stroke_b, stroke_a;
+	float stroke_width;
+	// Whether the fill-rule is evenodd rather than nonzero.
+	bool even_odd;
+
+	// Whether the fill covers anything.
+	bool has_fill() const { return filled && a > 0; }
+	// Whether the stroke covers anything.
+	bool has_stroke() const { return stroked && stroke_width > 0 && stroke_a > 0; }
+};
+
+// The presentation properties of an element, read from its attributes,
+// the style sheet and its style attribute, in that order, or given by
+// style sheet rules. Every element type is styled through this class.
+// Like in CSS, a property read again replaces the value read before, and
+// the opacities and the alpha of the colors are only multiplied together
+// when the properties are applied. Properties that are never given keep
+// the defaults of the element they are applied to.
+class StyleProperties
+{
+public:
+	StyleProperties() : properties(0), defaults(0),
+	                    filled(true), r(0), g(0), b(0), fill_alpha(1),
+	                    stroked(false), stroke_r(0), stroke_g(0), stroke_b(0),
+	                    stroke_alpha(1), stroke_width(1),
+	                    fill_opacity(1), stroke_opacity(1), opacity(1), even_odd(false)
+	{ }
+
+	// Properties that are set. defaults are the properties explicitly
+	// given their default, e.g. by inherit, which replace values read
+	// before.
+	enum Property {Fill = 1, Stroke = 2, StrokeWidth = 4,
+	               FillOpacity = 8, StrokeOpacity = 16, Opacity = 32, FillRule = 64};
+	unsigned properties;
+	unsigned defaults;
+
+	// The values of the properties. The alphas are those of the colors.
+	bool filled;
+	float r, g, b, fill_alpha;
+	bool stroked;
+	float stroke_r, stroke_g, stroke_b, stroke_alpha;
+	float stroke_width;
+	float fill_opacity, stroke_opacity, opacity;
+	bool even_odd;
+
+	// Parses a single property, e.g. a fill attribute. Other properties
+	// are ignored. Returns false if the value could not be parsed.
+	bool parse_property(const char* name, const char* value);
+	// Parses a style attribute, e.g. "fill: red; stroke: blue", and also
+	// modifies the string. Returns the first value that could not be
+	// parsed and was left at its default, or null.
+	const char* parse_style(char* style);
+	// Reads the properties set in other, as if they were parsed here.
+	void add(const StyleProperties& other);
+
+	// Gives an element the properties. Lines only use the stroke, and
+	// the strokes of polygons that would not cover anything are dropped.
+	void apply(Line* line) const;
+	void apply(Polygon* polygon) const;
+	void apply(ShapeStyle* shape_style) const;
+
+private:
+	void set(Property property);
+	void set_default(Property property);
+	// The opacity of the fill and of the stroke, 0 if it is none.
+	float fill_a() const;
+	float stroke_a() const;
+};
+
+}
+
+#endif
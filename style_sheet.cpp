@@ -0,0 +1,292 @@
+// Petter Strandmark 2013.
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include "style_sheet.h"
+
+namespace rapidsvg {
+
+namespace
+{
+	bool is_space(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f';
+	}
+
+	bool is_name_char(char c)
+	{
+		return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_';
+	}
+
+	// Removes leading and trailing white space by moving the start and
+	// terminating the string early.
+	char* trim(char* text)
+	{
+		while (is_space(*text)) {
+			text++;
+		}
+		char* end = text + std::strlen(text);
+		while (end > text && is_space(end[-1])) {
+			end--;
+		}
+		*end = '\0';
+		return text;
+	}
+
+	// Replaces /* comments */ by spaces.
+	void remove_comments(char* text)
+	{
+		while ((text = std::strstr(text, "/*"))) {
+			char* end = std::strstr(text + 2, "*/");
+			char* stop = end ? end + 2 : text + std::strlen(text);
+			std::fill(text, stop, ' ');
+			text = stop;
+		}
+	}
+
+	// Reads a name such as a tag name or a class. Returns the character
+	// after it.
+	const char* read_name(const char* text, std::string* name)
+	{
+		const char* start = text;
+		while (is_name_char(*text)) {
+			text++;
+		}
+		name->assign(start, text);
+		return text;
+	}
+}
+
+void StyleSheet::add_rules(char* text, std::vector<const char*>* invalid)
+{
+	remove_comments(text);
+	// Earlier styles may not have all rules.
+	styles.clear();
+	cache.clear();
+
+	char* ptr = text;
+	std::vector<Selector> selectors;
+	while (true) {
+		while (is_space(*ptr)) {
+			ptr++;
+		}
+		if (*ptr == '\0') {
+			break;
+		}
+
+		char* open = std::strchr(ptr, '{');
+		if (*ptr == '@') {
+			// Statements end at ';' and blocks at the matching '}'.
+			char* semicolon = std::strchr(ptr, ';');
+			if (semicolon && (!open || semicolon < open)) {
+				ptr = semicolon + 1;
+				continue;
+			}
+			int level = 0;
+			while (*ptr && !(*ptr == '}' && --level == 0)) {
+				level += *ptr == '{';
+				ptr++;
+			}
+			ptr += *ptr ? 1 : 0;
+			continue;
+		}
+		if (!open) {
+			break;
+		}
+		char* close = std::strchr(open + 1, '}');
+		char* next = close ? close + 1 : open + 1 + std::strlen(open + 1);
+		*open = '\0';
+		if (close) {
+			*close = '\0';
+		}
+
+		// The selectors of the rule; those not understood are skipped.
+		selectors.clear();
+		char* selector_text = ptr;
+		while (selector_text) {
+			char* comma = std::strchr(selector_text, ',');
+			if (comma) {
+				*comma = '\0';
+			}
+			const char* s = trim(selector_text);
+			selector_text = comma ? comma + 1 : 0;
+			if (*s == '\0') {
+				continue;
+			}
+			Selector selector;
+			int num_ids = 0;
+			if (*s == '*') {
+				s++;
+			}
+			else {
+				s = read_name(s, &selector.name);
+			}
+			std::string name;
+			while ((*s == '.' || *s == '#') && is_name_char(s[1])) {
+				if (*s == '.') {
+					s = read_name(s + 1, &name);
+					selector.classes.push_back(name);
+				}
+				else {
+					s = read_name(s + 1, &selector.id);
+					num_ids++;
+				}
+			}
+			if (*s != '\0' || num_ids > 1) {
+				continue;
+			}
+			selector.specificity = (num_ids << 16) +
+			                       (int(selector.classes.size()) << 8) +
+			                       (selector.name.empty() ? 0 : 1);
+			selectors.push_back(selector);
+		}
+
+		// The declarations, checked once here.
+		size_t first = declarations.size();
+		char* declaration = open + 1;
+		while (declaration) {
+			char* semicolon = std::strchr(declaration, ';');
+			if (semicolon) {
+				*semicolon = '\0';
+			}
+			char* colon = std::strchr(declaration, ':');
+			if (colon) {
+				*colon = '\0';
+				char* name = trim(declaration);
+				char* value = colon + 1;
+				char* important = std::strstr(value, "!important");
+				if (important) {
+					*important = '\0';
+				}
+				value = trim(value);
+				StyleProperties check;
+				if (check.parse_property(name, value)) {
+					declarations.push_back(std::make_pair(std::string(name),
+					                                      std::string(value)));
+				}
+				else {
+					invalid->push_back(value);
+				}
+			}
+			declaration = semicolon ? semicolon + 1 : 0;
+		}
+
+		for (auto& selector : selectors) {
+			Rule rule = {selector, first, declarations.size()};
+			rules.push_back(rule);
+			if (!selector.id.empty()) {
+				ids.insert(std::lower_bound(ids.begin(), ids.end(), selector.id),
+				           selector.id);
+			}
+		}
+		ptr = next;
+	}
+}
+
+void StyleSheet::clear()
+{
+	rules.clear();
+	declarations.clear();
+	ids.clear();
+	styles.clear();
+	cache.clear();
+}
+
+int StyleSheet::find_style(const char* name, const char* classes, const char* id)
+{
+	// Ids without rules are left out of the key, so that elements with
+	// unique ids still share styles.
+	if (id) {
+		auto found = std::lower_bound(ids.begin(), ids.end(), id,
+			[](const std::string& a, const char* b)
+			{
+				return std::strcmp(a.c_str(), b) < 0;
+			});
+		if (found == ids.end() || *found != id) {
+			id = 0;
+		}
+	}
+	key.assign(name);
+	key.push_back('\0');
+	key.append(classes ? classes : "");
+	key.push_back('\0');
+	key.append(id ? id : "");
+
+	auto cached = cache.find(key);
+	if (cached != cache.end()) {
+		return cached->second;
+	}
+	int style = add_style(name, classes, id);
+	cache[key] = style;
+	return style;
+}
+
+int StyleSheet::add_style(const char* name, const char* classes, const char* id)
+{
+	std::vector<std::string> element_classes;
+	for (const char* c = classes; c && *c;) {
+		while (is_space(*c)) {
+			c++;
+		}
+		const char* start = c;
+		while (*c && !is_space(*c)) {
+			c++;
+		}
+		if (c > start) {
+			element_classes.push_back(std::string(start, c));
+		}
+	}
+
+	std::vector<const Rule*> matching;
+	for (auto& rule : rules) {
+		const Selector& selector = rule.selector;
+		bool matches = (selector.name.empty() || selector.name == name) &&
+		               (selector.id.empty() || (id && selector.id == id));
+		for (size_t i = 0; i < selector.classes.size() && matches; ++i) {
+			matches = std::find(element_classes.begin(), element_classes.end(),
+			                    selector.classes[i]) != element_classes.end();
+		}
+		if (matches) {
+			matching.push_back(&rule);
+		}
+	}
+	if (matching.empty()) {
+		return -1;
+	}
+
+	// Later declarations of a property replace earlier ones, with the
+	// rules ordered by specificity and then by position.
+	std::stable_sort(matching.begin(), matching.end(),
+		[](const Rule* a, const Rule* b)
+		{
+			return a->selector.specificity < b->selector.specificity;
+		});
+	std::vector<const std::pair<std::string, std::string>*> cascaded;
+	for (auto rule : matching) {
+		for (size_t i = rule->first; i < rule->end; ++i) {
+			auto& declaration = declarations[i];
+			auto same_name = std::find_if(cascaded.begin(), cascaded.end(),
+				[&](const std::pair<std::string, std::string>* other)
+				{
+					return other->first == declaration.first;
+				});
+			if (same_name != cascaded.end()) {
+				*same_name = &declaration;
+			}
+			else {
+				cascaded.push_back(&declaration);
+			}
+		}
+	}
+
+	StyleProperties style;
+	for (auto declaration : cascaded) {
+		style.parse_property(declaration->first.c_str(), declaration->second.c_str());
+	}
+	styles.push_back(style);
+	return int(styles.size()) - 1;
+}
+
+}
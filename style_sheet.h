@@ -0,0 +1,74 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_STYLE_SHEET_H
+#define RAPIDSVG_STYLE_SHEET_H
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "style.h"
+
+namespace rapidsvg {
+
+// Rules from <style> elements. Only simple selectors are understood: a
+// tag name or '*', followed by any number of .class and at most one #id,
+// e.g. "rect", ".road.major" or "path#river". Rules with other selectors,
+// such as combinators and pseudo-classes, and @-rules are ignored.
+//
+// The rules matching an element depend only on its tag name, its class
+// attribute and its id, so they are cascaded once for every distinct
+// combination of them and the result is cached.
+class StyleSheet
+{
+public:
+	// Adds the rules of a style sheet. The text is modified. Declarations
+	// with values that could not be parsed are left out and the values
+	// are added to invalid.
+	void add_rules(char* text, std::vector<const char*>* invalid);
+	bool empty() const { return rules.empty(); }
+	void clear();
+
+	// Returns the index in styles of the style for an element with the
+	// given tag name and class and id attributes, which may be null, or -1
+	// if no rule matches it. Not thread-safe.
+	int find_style(const char* name, const char* classes, const char* id);
+	// The properties that the rules give elements. Values that no rule
+	// sets are left as they are when applied.
+	std::vector<StyleProperties> styles;
+
+private:
+	struct Selector
+	{
+		// Empty for any tag name.
+		std::string name;
+		std::vector<std::string> classes;
+		std::string id;
+		// Number of ids, classes and tag names, in base 256.
+		int specificity;
+	};
+	struct Rule
+	{
+		Selector selector;
+		// Range of the declarations of the rule.
+		size_t first, end;
+	};
+
+	// Cascades the rules matching an element into a new style.
+	int add_style(const char* name, const char* classes, const char* id);
+
+	std::vector<Rule> rules;
+	// Property names and values.
+	std::vector<std::pair<std::string, std::string> > declarations;
+	// The ids in selectors, sorted. Other ids do not affect the style.
+	std::vector<std::string> ids;
+	// Index of the style for every key of tag name, class attribute and
+	// id, separated by null characters.
+	std::unordered_map<std::string, int> cache;
+	std::string key;
+};
+
+}
+
+#endif
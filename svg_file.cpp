@@ -1,10 +1,13 @@
 // Petter Strandmark 2013.
 
+#include <algorithm>
+#include <cctype>
 #include <cstring>
+#include <exception>
 #include <fstream>
 #include <iostream>
-#include <queue>
 #include <stdexcept>
+#include <utility>
 
 #ifdef USE_OPENMP
 	#include <omp.h>
@@ -21,7 +24,14 @@
 
 #include <rapidxml.hpp>
 
+#include "block_pool.h"
+#include "number_parser.h"
+#include "duplicates.h"
+#include "line_chains.h"
+#include "spatial_order.h"
+#include "style_sheet.h"
 #include "svg_file.h"
+#include "transform.h"
 
 namespace rapidsvg {
 
@@ -39,104 +49,1291 @@ void read_file_data(const std::string& file_name, std::vector<char>* data)
 	if (!fin.read(&data->at(0), file_size)) {
 		throw std::runtime_error("Failed to read file.");
 	}
+	(*data)[file_size] = 0;
 }
 
-int hex_to_dec(char d1)
+// Scans [begin, end) for tags and returns the number of bytes up to and
+// including the last complete tag. open_tags is updated with the opening
+// tags of the elements that are still open at that point. on_start_tag is
+// called with the range of every complete element start tag.
+template<typename Callback>
+size_t scan_complete_tags(const char* begin, const char* end,
+                          std::vector<std::string>* open_tags,
+                          Callback on_start_tag)
 {
-	if ('0' <= d1 && d1 <= '9') {
-		return d1 - '0';
+	using namespace std;
+
+	const char* complete = begin;
+	const char* ptr = begin;
+	while (ptr < end) {
+		const char* tag_start = static_cast<const char*>(memchr(ptr, '<', end - ptr));
+		if (!tag_start) {
+			break;
+		}
+
+		const char* tag_end = 0;
+		const char* const comment_end = "-->";
+		const char* const cdata_end = "]]>";
+		const char* const pi_end = "?>";
+		if (end - tag_start >= 4 && strncmp(tag_start, "<!--", 4) == 0) {
+			tag_end = search(tag_start + 4, end, comment_end, comment_end + 3);
+			tag_end = tag_end == end ? 0 : tag_end + 3;
+		}
+		else if (end - tag_start >= 9 && strncmp(tag_start, "<![CDATA[", 9) == 0) {
+			tag_end = search(tag_start + 9, end, cdata_end, cdata_end + 3);
+			tag_end = tag_end == end ? 0 : tag_end + 3;
+		}
+		else if (end - tag_start >= 2 && tag_start[1] == '?') {
+			tag_end = search(tag_start + 2, end, pi_end, pi_end + 2);
+			tag_end = tag_end == end ? 0 : tag_end + 2;
+		}
+		else {
+			// Element tag; '>' may appear inside quoted attribute values.
+			char quote = 0;
+			for (const char* p = tag_start + 1; p < end; ++p) {
+				if (quote) {
+					if (*p == quote) {
+						quote = 0;
+					}
+				}
+				else if (*p == '"' || *p == '\'') {
+					quote = *p;
+				}
+				else if (*p == '>') {
+					tag_end = p + 1;
+					break;
+				}
+			}
+
+			if (tag_end && tag_start[1] == '/') {
+				if (!open_tags->empty()) {
+					open_tags->pop_back();
+				}
+			}
+			else if (tag_end && tag_start[1] != '!') {
+				on_start_tag(tag_start, tag_end);
+				if (tag_end[-2] != '/') {
+					open_tags->push_back(string(tag_start, tag_end));
+				}
+			}
+		}
+
+		if (!tag_end) {
+			// The tag is not complete yet.
+			break;
+		}
+		complete = tag_end;
+		ptr = tag_end;
 	}
-	switch (d1) {
-	case 'a': case 'A': return 10;
-	case 'b': case 'B': return 11;
-	case 'c': case 'C': return 12;
-	case 'd': case 'D': return 13;
-	case 'e': case 'E': return 14;
-	case 'f': case 'F': return 15;
+	return complete - begin;
+}
+
+void ignore_start_tag(const char*, const char*)
+{
+}
+
+// Returns true if the tag starting at tag_start has the given name.
+bool tag_has_name(const char* tag_start, const char* tag_end, const char* name)
+{
+	size_t length = std::strlen(name);
+	if (tag_end - tag_start < length + 2 ||
+	    std::strncmp(tag_start + 1, name, length) != 0) {
+		return false;
 	}
-	std::string err = "Invalid hex digit :";
-	err += d1;
-	throw std::runtime_error(err);
+	char after = tag_start[length + 1];
+	return after == ' ' || after == '\t' || after == '\r' || after == '\n' ||
+	       after == '/' || after == '>';
 }
 
-void parse_color(const char* color, float* r, float* g, float* b)
+// Appends closing tags for all open tags, innermost first.
+void append_closing_tags(const std::vector<std::string>& open_tags,
+                         std::vector<char>* data)
 {
-	if (std::strcmp(color, "black") == 0) {
-		*r = 0; *g = 0; *b = 0;
+	for (auto tag = open_tags.rbegin(); tag != open_tags.rend(); ++tag) {
+		size_t name_end = tag->find_first_of(" \t\r\n/>", 1);
+		data->push_back('<');
+		data->push_back('/');
+		data->insert(data->end(), tag->begin() + 1, tag->begin() + name_end);
+		data->push_back('>');
 	}
-	else if (std::strcmp(color, "red") == 0) {
-		*r = 255; *g = 0; *b = 0;
+}
+
+// Reads the size of the SVG from its root node. Returns the transform
+// from the viewBox to the viewport.
+Transform parse_svg_root(rapidxml::xml_node<>* svg, double* width, double* height)
+{
+	using namespace std;
+
+	*width = 1;
+	*height = 1;
+	bool has_width = false, has_height = false;
+	double view_box[4];
+	bool has_view_box = false;
+
+	for (auto attr = svg->first_attribute(); attr;
+	          attr = attr->next_attribute())
+	{
+		if (strcmp(attr->name(), "width") == 0) {
+			*width = float(atof(attr->value()));
+			has_width = true;
+		}
+		else if (strcmp(attr->name(), "height") == 0) {
+			*height = float(atof(attr->value()));
+			has_height = true;
+		}
+		else if (strcmp(attr->name(), "viewBox") == 0) {
+			const char* ptr = attr->value();
+			int i = 0;
+			for (; i < 4; ++i) {
+				while (*ptr == ' ' || *ptr == ',') {
+					ptr++;
+				}
+				char* end;
+				view_box[i] = strtod(ptr, &end);
+				if (end == ptr) {
+					break;
+				}
+				ptr = end;
+			}
+			has_view_box = i == 4 && view_box[2] > 0 && view_box[3] > 0;
+		}
 	}
-	else if (std::strcmp(color, "green") == 0) {
-		*r = 0; *g = 255; *b = 0;
+
+	if (!has_view_box) {
+		return Transform();
 	}
-	else if (std::strcmp(color, "blue") == 0) {
-		*r = 0; *g = 0; *b = 255;
+	if (!has_width) {
+		*width = view_box[2];
 	}
-	else if (std::strcmp(color, "yellow") == 0) {
-		*r = 255; *g = 255; *b = 0;
+	if (!has_height) {
+		*height = view_box[3];
 	}
-	else if (strlen(color) == 7 && color[0] == '#') {
-		// Hexadecimal color.
-		*r = float(15 * hex_to_dec(color[1]) + hex_to_dec(color[2])) / 255.0f;
-		*g = float(15 * hex_to_dec(color[3]) + hex_to_dec(color[4])) / 255.0f;
-		*b = float(15 * hex_to_dec(color[5]) + hex_to_dec(color[6])) / 255.0f;
+
+	// The default preserveAspectRatio, "xMidYMid meet": uniform scaling
+	// that fits the viewBox, centered in the viewport.
+	double scale = min(*width / view_box[2], *height / view_box[3]);
+	double offset_x = (*width - scale * view_box[2]) / 2;
+	double offset_y = (*height - scale * view_box[3]) / 2;
+	return Transform(scale, 0, 0, scale,
+	                 offset_x - scale * view_box[0],
+	                 offset_y - scale * view_box[1]);
+}
+
+// Reads the transform attribute of a node, if any. Returns the attribute
+// value if it could not be parsed, or null.
+const char* parse_node_transform(rapidxml::xml_node<>* node, Transform* transform)
+{
+	auto attr = node->first_attribute("transform");
+	if (!attr) {
+		*transform = Transform();
+		return 0;
 	}
-	else if (strlen(color) == 5 && color[0] == '#' && color[1] == ' ') {
-		// ?
-		*r = 0;
-		*g = 0;
-		*b = 0;
+	return parse_transform(attr->value(), transform) ? 0 : attr->value();
+}
+
+// Reads a number attribute. Units are ignored.
+float parse_number_attribute(const char* value)
+{
+	float number = 0;
+	parse_number(&value, &number);
+	return number;
+}
+
+// Reads the attributes of an element. on_attribute gets every attribute
+// and returns false for those that are not part of the geometry; they are
+// read as presentation attributes. Then the properties from the style
+// sheet, css, are read, if any, and last the style attribute, each
+// replacing the properties read before. Every element type goes through
+// here, so they all see the same precedence.
+//
+// The parse_element functions return the first value that could not be
+// parsed and was left at its default, or null.
+template<typename Callback>
+const char* parse_attributes(rapidxml::xml_node<>* node, const StyleProperties* css,
+                             StyleProperties* properties, Callback on_attribute)
+{
+	using namespace std;
+	using namespace rapidxml;
+
+	const char* invalid = 0;
+	char* style_value = 0;
+	for (xml_attribute<> *attr = node->first_attribute();
+			attr; attr = attr->next_attribute())
+	{
+		if (strcmp(attr->name(), "style") == 0) {
+			style_value = attr->value();
+		}
+		else if (!on_attribute(attr->name(), attr->value())) {
+			if (!properties->parse_property(attr->name(), attr->value()) && !invalid) {
+				invalid = attr->value();
+			}
+		}
 	}
-	else {
-		std::string err = "Invalid color : ";
-		err += color;
-		throw std::runtime_error(err);
+	if (css) {
+		properties->add(*css);
 	}
+	if (style_value) {
+		const char* style_invalid = properties->parse_style(style_value);
+		invalid = invalid ? invalid : style_invalid;
+	}
+	return invalid;
+}
+
+// Reads the attributes of a shape element with a fill and a stroke.
+template<typename Callback>
+const char* parse_shape_attributes(rapidxml::xml_node<>* node, const StyleProperties* css,
+                                   ShapeStyle* style, Callback on_attribute)
+{
+	StyleProperties properties;
+	const char* invalid = parse_attributes(node, css, &properties, on_attribute);
+	properties.apply(style);
+	return invalid;
+}
+
+// Reads a <line> element.
+const char* parse_element(rapidxml::xml_node<>* node, const StyleProperties* css,
+                          Line* line)
+{
+	StyleProperties properties;
+	const char* invalid = parse_attributes(node, css, &properties,
+		[line](const char* name, const char* value)
+		{
+			using namespace std;
+			if (strcmp(name, "x1") == 0) {
+				line->x1 = float(atof(value));
+			}
+			else if (strcmp(name, "x2") == 0) {
+				line->x2 = float(atof(value));
+			}
+			else if (strcmp(name, "y1") == 0) {
+				line->y1 = float(atof(value));
+			}
+			else if (strcmp(name, "y2") == 0) {
+				line->y2 = float(atof(value));
+			}
+			else {
+				return false;
+			}
+			return true;
+		});
+	properties.apply(line);
+	return invalid;
+}
+
+// Reads a <polygon> element.
+const char* parse_element(rapidxml::xml_node<>* node, const StyleProperties* css,
+                          Polygon* polygon)
+{
+	StyleProperties properties;
+	const char* invalid = parse_attributes(node, css, &properties,
+		[polygon](const char* name, char* value)
+		{
+			if (std::strcmp(name, "points") != 0) {
+				return false;
+			}
+			polygon->parse_points(value);
+			return true;
+		});
+	properties.apply(polygon);
+	return invalid;
+}
+
+// Reads a <path> element.
+const char* parse_element(rapidxml::xml_node<>* node, const StyleProperties* css,
+                          Path* path)
+{
+	return parse_shape_attributes(node, css, &path->style,
+		[path](const char* name, const char* value)
+		{
+			if (std::strcmp(name, "d") != 0) {
+				return false;
+			}
+			path->parse_data(value);
+			return true;
+		});
+}
+
+// Reads a <polyline> element.
+const char* parse_element(rapidxml::xml_node<>* node, const StyleProperties* css,
+                          Polyline* polyline)
+{
+	return parse_shape_attributes(node, css, &polyline->style,
+		[polyline](const char* name, const char* value)
+		{
+			if (std::strcmp(name, "points") != 0) {
+				return false;
+			}
+			polyline->parse_points(value);
+			return true;
+		});
+}
+
+// Reads a <rect> element. Rounded corners are not supported.
+const char* parse_element(rapidxml::xml_node<>* node, const StyleProperties* css,
+                          Rectangle* rectangle)
+{
+	return parse_shape_attributes(node, css, &rectangle->style,
+		[rectangle](const char* name, const char* value)
+		{
+			using namespace std;
+			if (strcmp(name, "x") == 0) {
+				rectangle->x = parse_number_attribute(value);
+			}
+			else if (strcmp(name, "y") == 0) {
+				rectangle->y = parse_number_attribute(value);
+			}
+			else if (strcmp(name, "width") == 0) {
+				rectangle->ux = parse_number_attribute(value);
+			}
+			else if (strcmp(name, "height") == 0) {
+				rectangle->vy = parse_number_attribute(value);
+			}
+			else {
+				return false;
+			}
+			return true;
+		});
+}
+
+// Reads a <circle> or an <ellipse> element.
+const char* parse_element(rapidxml::xml_node<>* node, const StyleProperties* css,
+                          Ellipse* ellipse)
+{
+	return parse_shape_attributes(node, css, &ellipse->style,
+		[ellipse](const char* name, const char* value)
+		{
+			using namespace std;
+			if (strcmp(name, "cx") == 0) {
+				ellipse->cx = parse_number_attribute(value);
+			}
+			else if (strcmp(name, "cy") == 0) {
+				ellipse->cy = parse_number_attribute(value);
+			}
+			else if (strcmp(name, "r") == 0) {
+				ellipse->ux = parse_number_attribute(value);
+				ellipse->vy = ellipse->ux;
+			}
+			else if (strcmp(name, "rx") == 0) {
+				ellipse->ux = parse_number_attribute(value);
+			}
+			else if (strcmp(name, "ry") == 0) {
+				ellipse->vy = parse_number_attribute(value);
+			}
+			else {
+				return false;
+			}
+			return true;
+		});
+}
+
+// Type of the elements with the given tag name, or -1 if they are not
+// drawn.
+int element_type(const char* name)
+{
+	using namespace std;
+
+	switch (name[0]) {
+	case 'l':
+		return strcmp(name, "line") == 0 ? LineElement : -1;
+	case 'p':
+		return strcmp(name, "polygon") == 0 ? PolygonElement :
+		       strcmp(name, "path") == 0 ? PathElement :
+		       strcmp(name, "polyline") == 0 ? PolylineElement : -1;
+	case 'r':
+		return strcmp(name, "rect") == 0 ? RectangleElement : -1;
+	case 'c':
+		return strcmp(name, "circle") == 0 ? EllipseElement : -1;
+	case 'e':
+		return strcmp(name, "ellipse") == 0 ? EllipseElement : -1;
+	}
+	return -1;
+}
+
+// Counts the opening tags of every element type, of groups and of style
+// sheets in a null-terminated buffer, skipping from '<' to '<' with
+// memchr. Tags in comments and nested in other elements are counted too,
+// so the counts are upper bounds.
+void count_tags(const char* data, size_t counts[NumElementTypes], size_t* num_groups,
+                size_t* num_styles)
+{
+	std::fill(counts, counts + NumElementTypes, size_t(0));
+	*num_groups = 0;
+	*num_styles = 0;
+	const char* end = data + std::strlen(data);
+	const char* ptr = data;
+	while ((ptr = static_cast<const char*>(std::memchr(ptr, '<', end - ptr)))) {
+		ptr++;
+		// No element name is longer than "polyline".
+		char name[10];
+		size_t length = 0;
+		while (length < sizeof(name) - 1 && ptr + length < end &&
+		       std::isalpha(static_cast<unsigned char>(ptr[length]))) {
+			name[length] = ptr[length];
+			length++;
+		}
+		name[length] = 0;
+		if (length == 1 && name[0] == 'g') {
+			++*num_groups;
+		}
+		else if (length == 5 && std::strcmp(name, "style") == 0) {
+			++*num_styles;
+		}
+		else {
+			int type = element_type(name);
+			if (type >= 0) {
+				counts[type]++;
+			}
+		}
+	}
+}
+
+// The last child of node, or null. rapidxml only keeps the last child of
+// nodes that have children; for others it may point anywhere.
+rapidxml::xml_node<>* last_child(rapidxml::xml_node<>* node)
+{
+	return node->first_node() ? node->last_node() : 0;
+}
+
+// Adds the <style> elements below node, in document order, to styles.
+void find_style_nodes(rapidxml::xml_node<>* node,
+                      std::vector<rapidxml::xml_node<>*>* styles)
+{
+	std::vector<rapidxml::xml_node<>*> stack(1, node);
+	while (!stack.empty()) {
+		node = stack.back();
+		stack.pop_back();
+		if (std::strcmp(node->name(), "style") == 0) {
+			styles->push_back(node);
+			continue;
+		}
+		// Children are pushed last to first, to be visited first to last.
+		for (auto child = last_child(node); child; child = child->previous_sibling()) {
+			if (child->type() == rapidxml::node_element) {
+				stack.push_back(child);
+			}
+		}
+	}
+}
+
+// Resets an element, making its vectors allocate from arena.
+template<typename Element>
+void reset_element(Element* element, Arena*)
+{
+	*element = Element();
+}
+
+void reset_element(Polygon* polygon, Arena* arena)
+{
+	*polygon = Polygon();
+	polygon->points = PointVector(PointVector::allocator_type(arena));
+}
+
+void reset_element(Path* path, Arena* arena)
+{
+	*path = Path();
+	path->commands = decltype(path->commands)(ArenaAllocator<std::uint8_t>(arena));
+	path->coordinates = decltype(path->coordinates)(ArenaAllocator<float>(arena));
+}
+
+void reset_element(Polyline* polyline, Arena* arena)
+{
+	*polyline = Polyline();
+	polyline->points = PointVector(PointVector::allocator_type(arena));
+}
+
+// Parses an element at the given position in document order and applies
+// its accumulated transform. Without an arena, the vectors of the element
+// use the heap. css is the style from the style sheet, if any.
+template<typename Element>
+const char* parse_element(rapidxml::xml_node<>* node, const Transform& transform,
+                          std::uint32_t order, Arena* arena, const StyleProperties* css,
+                          Element* element)
+{
+	reset_element(element, arena);
+	element->order = order;
+	const char* invalid = parse_element(node, css, element);
+	if (!transform.is_identity()) {
+		element->transform(transform);
+	}
+	return invalid;
 }
 
 SVGFile::SVGFile() :
+	num_errors(0),
 	width(0),
-	height(0)
+	height(0),
+	next_order(0),
+	document(new rapidxml::xml_document<>),
+	load_mode(LoadFull),
+	loaded_bytes(0),
+	region_stride(1),
+	buffer_start(0),
+	buffer_offset(0)
+{
+	document->set_allocator(block_pool_allocate, block_pool_free);
+}
+
+SVGFile::~SVGFile()
 {
+	delete document;
 }
 
 void SVGFile::clear()
 {
 	this->lines.clear();
+	this->indexed_lines.clear();
 	this->polygons.clear();
+	this->polygon_levels.clear();
+	this->paths.clear();
+	this->polylines.clear();
+	this->rectangles.clear();
+	this->ellipses.clear();
+	this->groups.clear();
+	this->symbols.clear();
+	this->uses.clear();
+	this->symbol_ids.clear();
+	this->style_sheet.clear();
+	this->errors.clear();
+	this->num_errors = 0;
+	this->next_order = 0;
+	// No element refers to the arena any longer.
+	arena.reset();
+}
+
+size_t SVGFile::num_elements() const
+{
+	return lines.size() + indexed_lines.num_lines() + polygons.size() +
+	       paths.size() + polylines.size() + rectangles.size() + ellipses.size();
+}
+
+void SVGFile::print_counts() const
+{
+	std::cerr << "Found " << lines.size() + indexed_lines.num_lines() << " lines.\n";
+	std::cerr << "Found " << polygons.size() << " polygons.\n";
+	std::cerr << "Found " << paths.size() << " paths.\n";
+	std::cerr << "Found " << polylines.size() << " polylines.\n";
+	std::cerr << "Found " << rectangles.size() << " rects.\n";
+	std::cerr << "Found " << ellipses.size() << " circles and ellipses.\n";
+	if (!uses.empty()) {
+		std::cerr << "Found " << uses.size() << " uses of " << symbols.size()
+		          << " symbols.\n";
+	}
+	if (num_errors > 0) {
+		std::cerr << "Replaced " << num_errors << " invalid values by defaults, "
+		          << "the first at byte " << errors[0].offset << ".\n";
+	}
+}
+
+void SVGFile::add_error(ParseError::Code code, const char* value)
+{
+	ParseError error;
+	error.code = code;
+	error.offset = buffer_offset + (value - buffer_start);
+	if (!options.lenient) {
+		std::string message = code == ParseError::InvalidColor ?
+		                      "Invalid color" : "Invalid transform";
+		message += " at byte " + std::to_string(error.offset) + " : " + value;
+		throw std::runtime_error(message);
+	}
+
+	// The errors are kept as a heap with the last one first, so that the
+	// first ones are kept whatever the order they are found in.
+	#pragma omp critical(parse_errors)
+	{
+		num_errors++;
+		errors.push_back(error);
+		std::push_heap(errors.begin(), errors.end());
+		if (errors.size() > options.max_errors) {
+			std::pop_heap(errors.begin(), errors.end());
+			errors.pop_back();
+		}
+	}
 }
 
 void SVGFile::reload()
 {
-	if (this->filename.length() > 0) {
-		this->load(this->filename);
+	if (this->filename.length() == 0) {
+		throw std::runtime_error("No file previously loaded.");
+	}
+	else if (this->load_mode == LoadPartial) {
+		this->load_partial(this->filename);
+	}
+	else if (this->load_mode == LoadRegion) {
+		this->load_region(this->filename, this->region, this->region_stride);
 	}
 	else {
-		throw std::runtime_error("No file previously loaded.");
+		this->load(this->filename);
 	}
 }
 
 void SVGFile::load(const std::string& input_filename)
+{
+	double start_time, end_time;
+
+	this->filename = input_filename;
+	this->load_mode = LoadFull;
+	this->clear();
+
+	start_time = ::omp_get_wtime();
+	const char* old_buffer = file_data.empty() ? 0 : &file_data[0];
+	read_file_data(filename, &file_data);
+	bool buffer_reused = &file_data[0] == old_buffer;
+
+	end_time = ::omp_get_wtime();
+	std::cerr << "Read file in " << end_time - start_time << " seconds.\n";
+
+	size_t reused_blocks = block_pool_reused_blocks();
+	size_t reused_arena_blocks = arena.get_reused_blocks();
+	size_t new_arena_blocks = arena.get_allocated_blocks();
+	if (!parse_buffer(&file_data[0], std::vector<int>())) {
+		this->clear();
+		throw std::runtime_error("No <svg> node.");
+	}
+	reused_blocks = block_pool_reused_blocks() - reused_blocks;
+	reused_arena_blocks = arena.get_reused_blocks() - reused_arena_blocks;
+	new_arena_blocks = arena.get_allocated_blocks() - new_arena_blocks;
+	finish_load();
+
+	std::cerr << "SVG is " << this->width << " x " << this->height << "\n";
+	print_counts();
+	std::cerr << "Reused " << (buffer_reused ? "the" : "no") << " file buffer, "
+	          << reused_blocks << " parser blocks and " << reused_arena_blocks
+	          << " arena blocks; allocated " << new_arena_blocks
+	          << " new arena blocks (" << arena.get_reserved_bytes() / (1 << 20)
+	          << " MB reserved).\n";
+}
+
+void SVGFile::load_partial(const std::string& input_filename)
+{
+	this->filename = input_filename;
+	this->load_mode = LoadPartial;
+	this->clear();
+
+	std::vector<char>& data = file_data;
+	read_file_data(filename, &data);
+	size_t file_size = data.size() - 1;
+
+	open_tags.clear();
+	loaded_bytes = scan_complete_tags(&data[0], &data[0] + file_size,
+	                                  &open_tags, ignore_start_tag);
+	data.resize(loaded_bytes);
+	append_closing_tags(open_tags, &data);
+	data.push_back(0);
+
+	if (!parse_buffer(&data[0], std::vector<int>())) {
+		// The <svg> tag has not been written yet; start over next time.
+		loaded_bytes = 0;
+		open_tags.clear();
+	}
+	find_open_groups();
+	finish_load();
+
+	print_counts();
+}
+
+bool SVGFile::load_appended(const std::function<void()>& before_change)
+{
+	if (this->load_mode != LoadPartial) {
+		throw std::runtime_error("File was not loaded with load_partial.");
+	}
+
+	std::ifstream fin(filename, std::ios::binary | std::ios::in);
+	if (!fin) {
+		// The file may be in the middle of being replaced.
+		return false;
+	}
+	fin.seekg(0, std::ios::end);
+	size_t file_size = fin.tellg();
+	if (file_size < loaded_bytes || loaded_bytes == 0) {
+		// The file has been truncated or rewritten.
+		if (before_change) {
+			before_change();
+		}
+		load_partial(filename);
+		return true;
+	}
+	if (file_size == loaded_bytes) {
+		return false;
+	}
+
+	std::vector<char> appended(file_size - loaded_bytes);
+	fin.seekg(loaded_bytes, std::ios::beg);
+	if (!fin.read(&appended[0], appended.size())) {
+		return false;
+	}
+
+	std::vector<std::string> new_open_tags = open_tags;
+	size_t complete = scan_complete_tags(&appended[0],
+	                                     &appended[0] + appended.size(),
+	                                     &new_open_tags,
+	                                     ignore_start_tag);
+	if (complete == 0) {
+		return false;
+	}
+	if (before_change) {
+		before_change();
+	}
+
+	// Replay the opening tags of the elements that are still open, so
+	// that the appended elements end up in the right context.
+	std::vector<char>& data = file_data;
+	data.clear();
+	for (auto& tag : open_tags) {
+		data.insert(data.end(), tag.begin(), tag.end());
+	}
+	size_t replayed_bytes = data.size();
+	data.insert(data.end(), appended.begin(), appended.begin() + complete);
+	append_closing_tags(new_open_tags, &data);
+	data.push_back(0);
+
+	size_t num_existing = num_elements();
+	parse_buffer(&data[0], open_groups, loaded_bytes - replayed_bytes);
+	loaded_bytes += complete;
+	open_tags.swap(new_open_tags);
+	find_open_groups();
+
+	std::cerr << "Appended " << num_elements() - num_existing << " elements.\n";
+	return num_elements() != num_existing;
+}
+
+void stream_svg_file(const std::string& filename,
+                     const StreamCallbacks& callbacks)
 {
 	using namespace std;
 	using namespace rapidxml;
+
+	std::ifstream fin(filename, std::ios::binary | std::ios::in);
+	if (!fin) {
+		throw std::runtime_error("Could not open file.");
+	}
+
+	// Each element start tag is copied out of the read buffer and parsed
+	// on its own, so only one chunk of the file is held at a time.
+	xml_document<> doc;
+	std::vector<char> element;
+	std::vector<std::string> open_tags;
+	// Accumulated transform of every open tag.
+	std::vector<Transform> transforms;
+	// Position in document order of the next element.
+	std::uint32_t order = 0;
+	const char* const transform_name = "transform";
+	// There is no error list when streaming; invalid values are errors.
+	auto check = [](const char* invalid, const char* what)
+	{
+		if (invalid) {
+			throw std::runtime_error(std::string("Invalid ") + what + " : " + invalid);
+		}
+	};
+	auto on_start_tag = [&](const char* tag_start, const char* tag_end)
+	{
+		// Entries beyond the open tags belong to closed elements.
+		transforms.resize(open_tags.size());
+		Transform current = transforms.empty() ? Transform() : transforms.back();
+		transforms.push_back(current);
+
+		// Copy the tag name to look up its type.
+		char name[16];
+		size_t name_length = 0;
+		for (const char* p = tag_start + 1; p < tag_end && name_length < 15 &&
+		     *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n' &&
+		     *p != '/' && *p != '>'; ++p) {
+			name[name_length++] = *p;
+		}
+		name[name_length] = '\0';
+
+		int type = element_type(name);
+		bool is_svg = strcmp(name, "svg") == 0;
+		bool is_group = strcmp(name, "g") == 0 &&
+		                std::search(tag_start, tag_end, transform_name,
+		                            transform_name + 9) != tag_end;
+		bool wanted = (type == LineElement && callbacks.on_line) ||
+		              (type == PolygonElement && callbacks.on_polygon) ||
+		              (type == PathElement && callbacks.on_path) ||
+		              (type == PolylineElement && callbacks.on_polyline) ||
+		              (type == RectangleElement && callbacks.on_rectangle) ||
+		              (type == EllipseElement && callbacks.on_ellipse);
+		if (!wanted && !is_svg && !is_group) {
+			return;
+		}
+
+		element.assign(tag_start, tag_end);
+		if (element[element.size() - 2] != '/') {
+			element.back() = '/';
+			element.push_back('>');
+		}
+		element.push_back(0);
+		doc.clear();
+		doc.parse<0>(&element[0]);
+		xml_node<>* node = doc.first_node();
+
+		if (is_svg) {
+			double width, height;
+			transforms.back() = current * parse_svg_root(node, &width, &height);
+			if (callbacks.on_size) {
+				callbacks.on_size(width, height);
+			}
+		}
+		else if (is_group) {
+			Transform transform;
+			check(parse_node_transform(node, &transform), "transform");
+			transforms.back() = current * transform;
+		}
+		else if (type == LineElement) {
+			Line line;
+			check(parse_element(node, current, order++, 0, 0, &line), "color");
+			callbacks.on_line(line);
+		}
+		else if (type == PolygonElement) {
+			Polygon polygon;
+			check(parse_element(node, current, order++, 0, 0, &polygon), "color");
+			callbacks.on_polygon(polygon);
+		}
+		else if (type == PathElement) {
+			Path path;
+			check(parse_element(node, current, order++, 0, 0, &path), "color");
+			callbacks.on_path(path);
+		}
+		else if (type == PolylineElement) {
+			Polyline polyline;
+			check(parse_element(node, current, order++, 0, 0, &polyline), "color");
+			callbacks.on_polyline(polyline);
+		}
+		else if (type == RectangleElement) {
+			Rectangle rectangle;
+			check(parse_element(node, current, order++, 0, 0, &rectangle), "color");
+			callbacks.on_rectangle(rectangle);
+		}
+		else {
+			Ellipse ellipse;
+			check(parse_element(node, current, order++, 0, 0, &ellipse), "color");
+			callbacks.on_ellipse(ellipse);
+		}
+	};
+
+	const size_t chunk_size = 1 << 20;
+	std::vector<char> buffer;
+	size_t buffered = 0;
+	while (fin) {
+		buffer.resize(buffered + chunk_size);
+		fin.read(&buffer[buffered], chunk_size);
+		size_t available = buffered + size_t(fin.gcount());
+		if (available == 0) {
+			break;
+		}
+		size_t complete = scan_complete_tags(&buffer[0], &buffer[0] + available,
+		                                     &open_tags, on_start_tag);
+		// Keep the incomplete tag at the end for the next chunk.
+		buffered = available - complete;
+		std::memmove(&buffer[0], &buffer[complete], buffered);
+	}
+}
+
+// Returns a callback that adds the elements intersecting region to
+// elements, keeping every stride-th of them. The elements kept are
+// numbered in document order from next_order on.
+template<typename Element>
+std::function<void(Element&)> region_filter(const Rect& region,
+                                            size_t stride,
+                                            size_t* num_elements,
+                                            size_t* num_intersecting,
+                                            std::uint32_t* next_order,
+                                            std::vector<Element>* elements)
+{
+	return [=](Element& element)
+	{
+		(*num_elements)++;
+		if (element.bounding_box().intersects(region) &&
+		    (*num_intersecting)++ % stride == 0) {
+			element.order = (*next_order)++;
+			elements->push_back(std::move(element));
+		}
+	};
+}
+
+void SVGFile::load_region(const std::string& input_filename,
+                          const Rect& input_region,
+                          size_t stride)
+{
 	double start_time, end_time;
 
 	this->filename = input_filename;
+	this->load_mode = LoadRegion;
+	this->region = input_region;
+	this->region_stride = std::max(stride, size_t(1));
 	this->clear();
+	this->width = 1;
+	this->height = 1;
 
 	start_time = ::omp_get_wtime();
-	std::vector<char> data;
-	read_file_data(filename, &data);
+
+	size_t num_elements = 0;
+	size_t num_intersecting = 0;
+	StreamCallbacks callbacks;
+	callbacks.on_size = [&](double svg_width, double svg_height)
+	{
+		this->width = svg_width;
+		this->height = svg_height;
+	};
+	callbacks.on_line = region_filter(region, region_stride, &num_elements,
+	                                  &num_intersecting, &next_order, &lines);
+	callbacks.on_polygon = region_filter(region, region_stride, &num_elements,
+	                                     &num_intersecting, &next_order, &polygons);
+	callbacks.on_path = region_filter(region, region_stride, &num_elements,
+	                                  &num_intersecting, &next_order, &paths);
+	callbacks.on_polyline = region_filter(region, region_stride, &num_elements,
+	                                      &num_intersecting, &next_order, &polylines);
+	callbacks.on_rectangle = region_filter(region, region_stride, &num_elements,
+	                                       &num_intersecting, &next_order, &rectangles);
+	callbacks.on_ellipse = region_filter(region, region_stride, &num_elements,
+	                                     &num_intersecting, &next_order, &ellipses);
+	stream_svg_file(filename, callbacks);
 
 	end_time = ::omp_get_wtime();
-	std::cerr << "Read file in " << end_time - start_time << " seconds.\n";
+	std::cerr << "Scanned file in " << end_time - start_time << " seconds.\n";
+	finish_load();
+	std::cerr << "SVG is " << this->width << " x " << this->height << "\n";
+	std::cerr << "Kept " << this->num_elements() << " of "
+	          << num_elements << " elements (" << num_intersecting
+	          << " in region).\n";
+}
 
+void SVGFile::finish_load()
+{
+	if (options.remove_duplicates) {
+		rapidsvg::remove_duplicates(&groups, &lines, &polygons);
+		compact_orders();
+	}
+	if (options.spatial_order) {
+		sort_spatially(groups, &lines, &polygons);
+	}
+	if (options.simplify_polygons) {
+		double start_time = ::omp_get_wtime();
+		polygon_levels.build(polygons, float(std::max(width, height)));
+		std::cerr << "Simplified polygons in " << ::omp_get_wtime() - start_time
+		          << " seconds to";
+		for (auto& level : polygon_levels.levels) {
+			std::cerr << " " << level.points.size() / 2;
+		}
+		std::cerr << " points.\n";
+	}
+	if (options.chain_lines && !lines.empty()) {
+		double start_time = ::omp_get_wtime();
+		size_t num_lines = lines.size();
+		size_t num_chains = chain_lines(&lines, &arena, &polylines);
+		std::cerr << "Chained " << num_lines << " lines into " << num_chains
+		          << " polylines in " << ::omp_get_wtime() - start_time
+		          << " seconds.\n";
+	}
+	if (options.index_lines) {
+		const double megabyte = 1 << 20;
+		double line_bytes = double(lines.size() * sizeof(Line));
+		indexed_lines.build(lines);
+		// Releases the memory of the lines.
+		std::vector<Line>().swap(lines);
+		std::cerr << "Indexed " << indexed_lines.num_lines() << " lines with "
+		          << indexed_lines.num_vertices() << " end points in "
+		          << indexed_lines.chunks.size() << " chunks ("
+		          << indexed_lines.memory_bytes() / megabyte << " MB instead of "
+		          << line_bytes / megabyte << " MB).\n";
+	}
+}
+
+// Marks the positions of the elements as used, shifted by one.
+template<typename Element>
+void mark_orders(const std::vector<Element>& elements, std::vector<std::uint32_t>* used)
+{
+	for (auto& element : elements) {
+		(*used)[element.order + 1] = 1;
+	}
+}
+
+// Replaces the positions of the elements by their ranks.
+template<typename Element>
+void rank_orders(const std::vector<std::uint32_t>& ranks, std::vector<Element>* elements)
+{
+	for (auto& element : *elements) {
+		element.order = ranks[element.order];
+	}
+}
+
+void SVGFile::compact_orders()
+{
+	// ranks[p + 1] is first 1 if position p is used, and then the number
+	// of used positions up to and including p.
+	std::vector<std::uint32_t> ranks(size_t(next_order) + 1, 0);
+	mark_orders(lines, &ranks);
+	mark_orders(polygons, &ranks);
+	mark_orders(paths, &ranks);
+	mark_orders(polylines, &ranks);
+	mark_orders(rectangles, &ranks);
+	mark_orders(ellipses, &ranks);
+	for (auto& use : uses) {
+		size_t end = use.order + symbols[use.symbol].num_elements();
+		for (size_t p = use.order; p < end; ++p) {
+			ranks[p + 1] = 1;
+		}
+	}
+	for (size_t p = 0; p < next_order; ++p) {
+		ranks[p + 1] += ranks[p];
+	}
+
+	rank_orders(ranks, &lines);
+	rank_orders(ranks, &polygons);
+	rank_orders(ranks, &paths);
+	rank_orders(ranks, &polylines);
+	rank_orders(ranks, &rectangles);
+	rank_orders(ranks, &ellipses);
+	rank_orders(ranks, &uses);
+	next_order = ranks[next_order];
+}
+
+// Parses an element and appends it to elements.
+template<typename Element>
+const char* append_element(rapidxml::xml_node<>* node, const Transform& transform,
+                           std::uint32_t order, Arena* arena, const StyleProperties* css,
+                           std::vector<Element>* elements)
+{
+	elements->push_back(Element());
+	return parse_element(node, transform, order, arena, css, &elements->back());
+}
+
+void SVGFile::parse_symbol(rapidxml::xml_node<>* node, const Transform& transform,
+                           Symbol* symbol)
+{
+	using namespace std;
+	using namespace rapidxml;
+
+	int type = element_type(node->name());
+	if (type < 0) {
+		// A <symbol>, a group or another container. Nested groups add
+		// their transforms; nested uses are not drawn.
+		for (auto child = node->first_node(); child; child = child->next_sibling()) {
+			if (child->type() != node_element) {
+				continue;
+			}
+			if (strcmp(child->name(), "g") == 0) {
+				Transform child_transform;
+				const char* invalid = parse_node_transform(child, &child_transform);
+				if (invalid) {
+					add_error(ParseError::InvalidTransform, invalid);
+				}
+				parse_symbol(child, transform * child_transform, symbol);
+			}
+			else if (element_type(child->name()) >= 0) {
+				parse_symbol(child, transform, symbol);
+			}
+		}
+		return;
+	}
+
+	const StyleProperties* css = 0;
+	if (!style_sheet.empty()) {
+		auto classes = node->first_attribute("class");
+		auto id = node->first_attribute("id");
+		int style = style_sheet.find_style(node->name(),
+		                                   classes ? classes->value() : 0,
+		                                   id ? id->value() : 0);
+		css = style >= 0 ? &style_sheet.styles[style] : 0;
+	}
+	const std::uint32_t order = std::uint32_t(symbol->num_elements());
+	const char* invalid = 0;
+	switch (type) {
+	case LineElement:
+		invalid = append_element(node, transform, order, &arena, css, &symbol->lines);
+		break;
+	case PolygonElement:
+		invalid = append_element(node, transform, order, &arena, css, &symbol->polygons);
+		break;
+	case PathElement:
+		invalid = append_element(node, transform, order, &arena, css, &symbol->paths);
+		break;
+	case PolylineElement:
+		invalid = append_element(node, transform, order, &arena, css, &symbol->polylines);
+		break;
+	case RectangleElement:
+		invalid = append_element(node, transform, order, &arena, css, &symbol->rectangles);
+		break;
+	default:
+		invalid = append_element(node, transform, order, &arena, css, &symbol->ellipses);
+	}
+	if (invalid) {
+		add_error(ParseError::InvalidColor, invalid);
+	}
+}
+
+void SVGFile::add_uses(rapidxml::xml_node<>* svg,
+                       const std::vector<ElementNode>& use_nodes,
+                       const std::vector<Transform>& transforms)
+{
+	using namespace std;
+	using namespace rapidxml;
+
+	// The id referenced by a use, or null.
+	auto referenced_id = [](xml_node<>* node) -> const char*
+	{
+		auto href = node->first_attribute("href");
+		if (!href) {
+			href = node->first_attribute("xlink:href");
+		}
+		return href && href->value()[0] == '#' ? href->value() + 1 : 0;
+	};
+
+	// Ids referenced for the first time are looked up in the document.
+	size_t num_new = 0;
+	for (auto& use : use_nodes) {
+		const char* id = referenced_id(use.node);
+		if (id && symbol_ids.insert(make_pair(string(id), -1)).second) {
+			num_new++;
+		}
+	}
+	if (num_new > 0) {
+		vector<xml_node<>*> stack(1, svg);
+		string id;
+		while (!stack.empty()) {
+			auto node = stack.back();
+			stack.pop_back();
+			auto id_attribute = node->first_attribute("id");
+			if (id_attribute) {
+				id = id_attribute->value();
+				auto symbol_id = symbol_ids.find(id);
+				if (symbol_id != symbol_ids.end() && symbol_id->second < 0) {
+					symbols.push_back(Symbol());
+					symbol_id->second = int(symbols.size()) - 1;
+					// A referenced group is drawn with its own transform,
+					// as are the groups inside it.
+					Transform transform;
+					if (strcmp(node->name(), "g") == 0) {
+						const char* invalid = parse_node_transform(node, &transform);
+						if (invalid) {
+							add_error(ParseError::InvalidTransform, invalid);
+						}
+					}
+					parse_symbol(node, transform, &symbols.back());
+				}
+			}
+			for (auto child = last_child(node); child; child = child->previous_sibling()) {
+				if (child->type() == node_element) {
+					stack.push_back(child);
+				}
+			}
+		}
+	}
+
+	// Every use took one position in document order during the walk and
+	// takes one for every element of its symbol instead, or none if it
+	// draws nothing. The positions after it move by the difference.
+	// shifts[k] is the move of the positions after use node k.
+	vector<std::int64_t> shifts(use_nodes.size());
+	std::int64_t shift = 0;
+	size_t first_use = uses.size();
+	uses.reserve(uses.size() + use_nodes.size());
+	for (size_t k = 0; k < use_nodes.size(); ++k) {
+		shift--;
+		shifts[k] = shift;
+		xml_node<>* node = use_nodes[k].node;
+		const char* id = referenced_id(node);
+		auto symbol_id = id ? symbol_ids.find(id) : symbol_ids.end();
+		if (symbol_id == symbol_ids.end() || symbol_id->second < 0) {
+			continue;
+		}
+		shift += std::int64_t(symbols[symbol_id->second].num_elements());
+		shifts[k] = shift;
+
+		// The use is translated by x and y after its own transform.
+		Transform transform;
+		const char* invalid = parse_node_transform(node, &transform);
+		if (invalid) {
+			add_error(ParseError::InvalidTransform, invalid);
+		}
+		auto x = node->first_attribute("x");
+		auto y = node->first_attribute("y");
+		Transform translation(1, 0, 0, 1, x ? parse_number_attribute(x->value()) : 0,
+		                                  y ? parse_number_attribute(y->value()) : 0);
+		SymbolUse use;
+		use.symbol = symbol_id->second;
+		use.transform = transforms[use_nodes[k].transform] * transform * translation;
+		use.order = use_nodes[k].order;
+		uses.push_back(use);
+	}
+
+	// The uses and the element nodes are in document order, so the move
+	// of each is found by going through the use nodes along with them.
+	auto move = [&](std::uint32_t* order, size_t* k)
+	{
+		while (*k < use_nodes.size() && use_nodes[*k].order < *order) {
+			++*k;
+		}
+		*order = std::uint32_t(*order + (*k > 0 ? shifts[*k - 1] : 0));
+	};
+	size_t k = 0;
+	for (size_t i = first_use; i < uses.size(); ++i) {
+		move(&uses[i].order, &k);
+	}
+	for (int t = 0; t < NumElementTypes; ++t) {
+		k = 0;
+		for (auto& element : element_nodes[t]) {
+			move(&element.order, &k);
+		}
+	}
+	next_order = std::uint32_t(next_order + shift);
+}
+
+void SVGFile::find_open_groups()
+{
+	// The open group at depth d is the last group created at that depth,
+	// since anything after it in the file would be inside it.
+	size_t num_open = 0;
+	for (size_t i = 1; i < open_tags.size(); ++i) {
+		if (!tag_has_name(open_tags[i].c_str(),
+		                  open_tags[i].c_str() + open_tags[i].size(), "g")) {
+			break;
+		}
+		num_open++;
+	}
+
+	open_groups.assign(num_open, -1);
+	size_t num_found = 0;
+	for (int i = int(groups.size()) - 1; i >= 0 && num_found < num_open; --i) {
+		size_t depth = groups[i].depth;
+		if (depth < num_open && open_groups[depth] < 0) {
+			open_groups[depth] = i;
+			num_found++;
+		}
+	}
+}
+
+bool SVGFile::parse_buffer(char* data, const std::vector<int>& continued_groups,
+                           size_t file_offset)
+{
+	using namespace std;
+	using namespace rapidxml;
+	double start_time, end_time;
+
+	// The parse below writes into the buffer, so the tags are counted
+	// first. With the counts, the node lists and the groups are allocated
+	// once with their final sizes instead of growing.
 	start_time = ::omp_get_wtime();
-	xml_document<> doc;
-	data.push_back(0);
-	doc.parse<0>(&data[0]);
+	size_t tag_counts[NumElementTypes];
+	size_t num_groups, num_styles;
+	count_tags(data, tag_counts, &num_groups, &num_styles);
+	buffer_start = data;
+	buffer_offset = file_offset;
+	auto& nodes = element_nodes;
+	for (int t = 0; t < NumElementTypes; ++t) {
+		nodes[t].clear();
+		nodes[t].reserve(tag_counts[t]);
+	}
+	groups.reserve(groups.size() + num_groups);
+	end_time = ::omp_get_wtime();
+	std::cerr << "Counted tags in " << end_time - start_time << " seconds.\n";
+
+	start_time = ::omp_get_wtime();
+	// Clearing returns the memory of the last parse to the block pool,
+	// where this parse picks it up again.
+	xml_document<>& doc = *document;
+	doc.clear();
+	doc.parse<0>(data);
+	arena.set_huge_pages(options.huge_pages);
 	end_time = ::omp_get_wtime();
 	std::cerr << "Parsed XML in " << end_time - start_time << " seconds.\n";
 
@@ -144,92 +1341,212 @@ void SVGFile::load(const std::string& input_filename)
 
 	xml_node<>* svg = doc.first_node("svg");
 	if (!svg) {
-		throw std::runtime_error("No <svg> node.");
+		return false;
 	}
+	std::make_heap(errors.begin(), errors.end());
 
-	this->width = 1;
-	this->height = 1;
+	// Style sheets apply to the whole document, so they are read before
+	// the elements. The document is only searched if there are any.
+	if (num_styles > 0) {
+		vector<xml_node<>*> style_nodes;
+		find_style_nodes(svg, &style_nodes);
+		vector<const char*> invalid;
+		for (auto style_node : style_nodes) {
+			for (auto text = style_node->first_node(); text; text = text->next_sibling()) {
+				if (text->type() == node_data || text->type() == node_cdata) {
+					style_sheet.add_rules(text->value(), &invalid);
+				}
+			}
+		}
+		for (auto value : invalid) {
+			add_error(ParseError::InvalidColor, value);
+		}
+	}
 
-	for (auto attr = svg->first_attribute(); attr;
-	          attr = attr->next_attribute())
+	// Transforms met during the walk; the first is the root's.
+	vector<Transform> transforms(1, parse_svg_root(svg, &this->width, &this->height));
+
+	// The replayed opening tags of continued groups form a chain of
+	// first children below the root.
+	vector<xml_node<>*> continued_nodes;
+	auto node = svg->first_node();
+	while (node && continued_nodes.size() < continued_groups.size()) {
+		continued_nodes.push_back(node);
+		node = node->first_node();
+	}
+
+	// Structural pass: a depth-first walk in document order that records
+	// the groups and the element nodes. Every element gets its final
+	// position here, both in its vector and in document order, so that
+	// the attributes can be parsed in parallel.
+	size_t first[NumElementTypes] = {lines.size(), polygons.size(),
+	                                 paths.size(), polylines.size(),
+	                                 rectangles.size(), ellipses.size()};
+
+	// Every entry of the stack is the next child to visit in a group, the
+	// index of that group and the index of its accumulated transform.
+	struct Frame
 	{
-		if (strcmp(attr->name(), "width") == 0) {
-			this->width = float(atof(attr->value()));
+		xml_node<>* child;
+		int group;
+		int transform;
+	};
+	Frame root = {svg->first_node(), -1, 0};
+	vector<Frame> stack(1, root);
+	vector<ElementNode> use_nodes;
+
+	while (!stack.empty()) {
+		auto child = stack.back().child;
+		int group_index = stack.back().group;
+		int transform_index = stack.back().transform;
+		if (!child) {
+			// All children visited; close the group.
+			if (group_index >= 0) {
+				for (int t = 0; t < NumElementTypes; ++t) {
+					groups[group_index].end[t] = first[t] + nodes[t].size();
+				}
+			}
+			stack.pop_back();
+			continue;
 		}
-		else if (strcmp(attr->name(), "height") == 0) {
-			this->height = float(atof(attr->value()));
+		stack.back().child = child->next_sibling();
+
+		if (strcmp(child->name(), "g") == 0) {
+			// Found a group; visit its children next.
+			Frame frame = {child->first_node(), -1, transform_index};
+			size_t depth = stack.size() - 1;
+			bool continued = depth < continued_nodes.size() &&
+			                 child == continued_nodes[depth];
+			if (child->first_attribute("transform")) {
+				Transform transform;
+				const char* invalid = parse_node_transform(child, &transform);
+				// Continued groups were checked when they were first loaded.
+				if (invalid && !continued) {
+					add_error(ParseError::InvalidTransform, invalid);
+				}
+				transforms.push_back(transforms[transform_index] * transform);
+				frame.transform = int(transforms.size()) - 1;
+			}
+
+			if (continued) {
+				frame.group = continued_groups[depth];
+				stack.push_back(frame);
+				continue;
+			}
+			Group group;
+			group.parent = group_index;
+			group.depth = int(depth);
+			for (int t = 0; t < NumElementTypes; ++t) {
+				group.first[t] = first[t] + nodes[t].size();
+			}
+			group.transform = transforms[frame.transform];
+			groups.push_back(group);
+			frame.group = int(groups.size()) - 1;
+			stack.push_back(frame);
+		}
+		else {
+			int type = element_type(child->name());
+			if (type >= 0) {
+				ElementNode element = {child, transform_index, -1, next_order++};
+				if (!style_sheet.empty()) {
+					// Elements with the same classes share a style.
+					auto classes = child->first_attribute("class");
+					auto id = child->first_attribute("id");
+					element.style = style_sheet.find_style(child->name(),
+					                                       classes ? classes->value() : 0,
+					                                       id ? id->value() : 0);
+				}
+				nodes[type].push_back(element);
+			}
+			else if (strcmp(child->name(), "use") == 0) {
+				ElementNode use = {child, transform_index, -1, next_order++};
+				use_nodes.push_back(use);
+			}
 		}
 	}
 
-	// Queue of nodes we need to explore.
-	queue<xml_node<>*> nodes;
-	nodes.push(svg);
+	if (!use_nodes.empty()) {
+		add_uses(svg, use_nodes, transforms);
+	}
 
-	// Process the queue.
-	while ( !nodes.empty()) {
-		auto node = nodes.front();
-		nodes.pop();
+	// Parse all elements in parallel, directly into their positions, and
+	// flatten the transforms into the coordinates. The elements are
+	// numbered by type, so that type t has the numbers
+	// [type_start[t], type_start[t + 1]).
+	lines.resize(first[LineElement] + nodes[LineElement].size());
+	polygons.resize(first[PolygonElement] + nodes[PolygonElement].size());
+	paths.resize(first[PathElement] + nodes[PathElement].size());
+	polylines.resize(first[PolylineElement] + nodes[PolylineElement].size());
+	rectangles.resize(first[RectangleElement] + nodes[RectangleElement].size());
+	ellipses.resize(first[EllipseElement] + nodes[EllipseElement].size());
+	int type_start[NumElementTypes + 1] = {0};
+	for (int t = 0; t < NumElementTypes; ++t) {
+		type_start[t + 1] = type_start[t] + int(nodes[t].size());
+	}
+	int num_elements = type_start[NumElementTypes];
+	// The error of the first failing element.
+	exception_ptr error;
+	int error_element = num_elements;
 
-		// For each child of this node.
-		for (auto child = node->first_node(); child;
-		          child = child->next_sibling()) {
-			if (strcmp(child->name(), "g") == 0) {
-				// Found a group; add it to queue.
-				nodes.push(child);
-			}
-			else if (strcmp(child->name(), "line") == 0) {
-				// Add line to the collection of lines.
-				lines.push_back(Line());
-				Line& line = lines.back();
-
-				// To through the line attributes.
-				for (xml_attribute<> *attr = child->first_attribute();
-						attr; attr = attr->next_attribute())
-				{
-					if (strcmp(attr->name(), "x1") == 0) {
-						line.x1 = float(atof(attr->value()));
-					}
-					else if (strcmp(attr->name(), "x2") == 0) {
-						line.x2 = float(atof(attr->value()));
-					}
-					else if (strcmp(attr->name(), "y1") == 0) {
-						line.y1 = float(atof(attr->value()));
-					}
-					else if (strcmp(attr->name(), "y2") == 0) {
-						line.y2 = float(atof(attr->value()));
-					}
-					else if (strcmp(attr->name(), "style") == 0) {
-						// Process this style string.
-						line.parse_style(attr->value());
-					}
-				}
+	#pragma omp parallel for schedule(dynamic, 256)
+	for (int i = 0; i < num_elements; ++i) {
+		int type = 0;
+		while (i >= type_start[type + 1]) {
+			type++;
+		}
+		auto& node = nodes[type][i - type_start[type]];
+		size_t index = first[type] + (i - type_start[type]);
+		const Transform& transform = transforms[node.transform];
+		const StyleProperties* css = node.style >= 0 ? &style_sheet.styles[node.style] : 0;
+		try {
+			const char* invalid = 0;
+			switch (type) {
+			case LineElement:
+				invalid = parse_element(node.node, transform, node.order, &arena, css,
+				                        &lines[index]);
+				break;
+			case PolygonElement:
+				invalid = parse_element(node.node, transform, node.order, &arena, css,
+				                        &polygons[index]);
+				break;
+			case PathElement:
+				invalid = parse_element(node.node, transform, node.order, &arena, css,
+				                        &paths[index]);
+				break;
+			case PolylineElement:
+				invalid = parse_element(node.node, transform, node.order, &arena, css,
+				                        &polylines[index]);
+				break;
+			case RectangleElement:
+				invalid = parse_element(node.node, transform, node.order, &arena, css,
+				                        &rectangles[index]);
+				break;
+			default:
+				invalid = parse_element(node.node, transform, node.order, &arena, css,
+				                        &ellipses[index]);
 			}
-			else if (strcmp(child->name(), "polygon") == 0) {
-				// Add line to the collection of lines.
-				polygons.push_back(Polygon());
-				Polygon& polygon = polygons.back();
-
-				// To through the line attributes.
-				for (xml_attribute<> *attr = child->first_attribute();
-						attr; attr = attr->next_attribute())
-				{
-					if (strcmp(attr->name(), "points") == 0) {
-						polygon.parse_points(attr->value());
-					}
-					else if (strcmp(attr->name(), "style") == 0) {
-						// Process this style string.
-						polygon.parse_style(attr->value());
-					}
+			if (invalid) {
+				add_error(ParseError::InvalidColor, invalid);
+			}
+		}
+		catch (...) {
+			#pragma omp critical
+			{
+				if (i < error_element) {
+					error_element = i;
+					error = current_exception();
 				}
 			}
 		}
 	}
+	if (error) {
+		rethrow_exception(error);
+	}
+	std::sort_heap(errors.begin(), errors.end());
+
 	end_time = ::omp_get_wtime();
 	std::cerr << "Walked XML in " << end_time - start_time << " seconds.\n";
-	
-	std::cerr << "SVG is " << this->width << " x " << this->height << "\n";
-	std::cerr << "Found " << lines.size() << " lines.\n";
-	std::cerr << "Found " << polygons.size() << " polygons.\n";
+	return true;
 }
 
 }
\ No newline at end of file
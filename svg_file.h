@@ -3,38 +3,249 @@
 #ifndef RAPIDSVG_SVG_FILE_H
 #define RAPIDSVG_SVG_FILE_H
 
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "arena.h"
+#include "group.h"
+#include "indexed_lines.h"
 #include "line.h"
+#include "path.h"
 #include "polygon.h"
+#include "polygon_levels.h"
+#include "rect.h"
+#include "shapes.h"
+#include "style_sheet.h"
+#include "symbol.h"
+
+namespace rapidxml {
+	template<class Ch> class xml_document;
+	template<class Ch> class xml_node;
+}
 
 namespace rapidsvg {
 
+// Options for loading files and optional stages run afterwards.
+class LoadOptions
+{
+public:
+	LoadOptions() : remove_duplicates(false), spatial_order(false),
+	                simplify_polygons(false), chain_lines(false), index_lines(false),
+	                huge_pages(false), lenient(false), max_errors(100)
+	{ }
+	// Remove opaque lines and polygons drawn again later with the same
+	// geometry and style.
+	bool remove_duplicates;
+	// Reorder elements along a Hilbert curve where the image allows it.
+	bool spatial_order;
+	// Simplify polygons with many points to a few levels of detail, for
+	// drawing them when zoomed out.
+	bool simplify_polygons;
+	// Link lines sharing end points into polylines drawn with joins. The
+	// lines are moved to the end of SVGFile::polylines, so index_lines has
+	// no lines left to index.
+	bool chain_lines;
+	// Move the lines into SVGFile::indexed_lines, storing shared end
+	// points once.
+	bool index_lines;
+	// Back the memory of the elements by transparent huge pages.
+	bool huge_pages;
+	// Replace values that cannot be parsed, such as invalid colors, by
+	// their defaults and list them in SVGFile::errors instead of failing.
+	bool lenient;
+	// Number of errors kept in SVGFile::errors. Further errors are only
+	// counted.
+	size_t max_errors;
+};
+
+// A value that could not be parsed and was replaced by its default.
+class ParseError
+{
+public:
+	enum Code {InvalidColor, InvalidTransform};
+	Code code;
+	// Position of the value in the file.
+	size_t offset;
+
+	bool operator<(const ParseError& other) const { return offset < other.offset; }
+};
+
 // Represents a line in the SVG file.
 class SVGFile
 {
 public:
 	SVGFile();
+	~SVGFile();
 
-	// Load a file from file.
+	LoadOptions options;
+
+	// Load a file from file. The buffers, the parser memory and the arena
+	// of the previous load are reused, so loading the same file again
+	// does not allocate much.
 	void load(const std::string& filename);
 	void reload();
 	void clear();
 
-	double get_width() { return width; }
-	double get_height() { return height; }
+	// Loads a file that may still be being written. Trailing incomplete
+	// elements are ignored and missing closing tags are assumed.
+	void load_partial(const std::string& filename);
+	// Parses only the bytes appended to the file since the last load and
+	// adds the new elements. Returns true if anything was added.
+	// before_change, if given, is called just before the elements are
+	// changed, and not at all if no complete elements were appended.
+	bool load_appended(const std::function<void()>& before_change = nullptr);
+
+	// Loads only the elements intersecting region, keeping every
+	// stride-th of them. The file is streamed and never held in memory.
+	void load_region(const std::string& filename,
+	                 const Rect& region,
+	                 size_t stride = 1);
+
+	double get_width() const { return width; }
+	double get_height() const { return height; }
+	// Total number of elements of all types.
+	size_t num_elements() const;
+	// Number of positions in document order given out. Every element has
+	// a position of its own and every use one for each element of its
+	// symbol, so elements and uses are drawn in the order of their
+	// positions.
+	size_t num_orders() const { return next_order; }
 
 	// Lines in the SVG.
 	std::vector<Line> lines;
+	// With options.index_lines, the lines of the file are moved here when
+	// it has been loaded, in the same order, and the ranges of lines in
+	// groups refer to them. Lines appended in follow mode are not indexed.
+	IndexedLines indexed_lines;
 	// Polygons in the SVG.
 	std::vector<Polygon> polygons;
+	// With options.simplify_polygons, simplified copies of the polygons.
+	PolygonLevels polygon_levels;
+	// Paths in the SVG.
+	std::vector<Path> paths;
+	// Polylines in the SVG.
+	std::vector<Polyline> polylines;
+	// Rects in the SVG.
+	std::vector<Rectangle> rectangles;
+	// Circles and ellipses in the SVG.
+	std::vector<Ellipse> ellipses;
+	// Groups in the SVG, in document order.
+	std::vector<Group> groups;
+	// Elements drawn by <use> elements, stored once, and the uses, in
+	// document order. Uses are not part of any group.
+	std::vector<Symbol> symbols;
+	std::vector<SymbolUse> uses;
+
+	// In lenient mode, the first options.max_errors values that could not
+	// be parsed, ordered by offset, and the number of them all.
+	std::vector<ParseError> errors;
+	size_t num_errors;
 private:
+	SVGFile(const SVGFile&);
+	SVGFile& operator=(const SVGFile&);
+
+	// Runs the optional stages selected in options.
+	void finish_load();
+	// Renumbers the positions in document order so that no positions are
+	// left unused, e.g. by removed elements.
+	void compact_orders();
+	// Prints the number of elements of every type.
+	void print_counts() const;
+
+	// Parses a null-terminated buffer and adds its elements. Returns
+	// false if the buffer has no <svg> node. continued_groups are the
+	// existing groups that the outermost groups of the buffer continue.
+	// file_offset is the position in the file of the start of the buffer.
+	bool parse_buffer(char* data, const std::vector<int>& continued_groups,
+	                  size_t file_offset = 0);
+
+	// Adds an error for an invalid value in the buffer being parsed, or
+	// throws if not lenient. May be called from several threads.
+	void add_error(ParseError::Code code, const char* value);
+
+	// An element or <use> node along with its position in document order
+	// and the indices of its transform and of its style in style_sheet, or
+	// -1.
+	struct ElementNode
+	{
+		rapidxml::xml_node<char>* node;
+		int transform;
+		int style;
+		std::uint32_t order;
+	};
+
+	// Adds the uses of symbols for <use> nodes. The symbols not added
+	// before are looked for below svg. The positions of the element nodes
+	// after a use are moved to make room for the elements of its symbol.
+	void add_uses(rapidxml::xml_node<char>* svg,
+	              const std::vector<ElementNode>& use_nodes,
+	              const std::vector<Transform>& transforms);
+	// Parses the elements of node, or node itself if it is an element,
+	// into symbol.
+	void parse_symbol(rapidxml::xml_node<char>* node, const Transform& transform,
+	                  Symbol* symbol);
+
+	// Finds the groups that are open according to open_tags.
+	void find_open_groups();
+
 	std::string filename;
 	double width, height;
+	// Position in document order of the next element.
+	std::uint32_t next_order;
+	// Kept between loads to avoid allocating them again: the file
+	// contents, the parsed document and the element nodes of every type.
+	std::vector<char> file_data;
+	rapidxml::xml_document<char>* document;
+	std::vector<ElementNode> element_nodes[NumElementTypes];
+	// Rules of the <style> elements loaded so far.
+	StyleSheet style_sheet;
+	// Index in symbols of every id referenced by a <use>, or -1 if the id
+	// was not found.
+	std::unordered_map<std::string, int> symbol_ids;
+	// Holds the points and path data of the parsed elements. It is reset
+	// by clear.
+	Arena arena;
+
+	// How the file was loaded, so that reload can repeat it.
+	enum LoadMode {LoadFull, LoadPartial, LoadRegion};
+	LoadMode load_mode;
+	// Number of bytes of the file consisting of complete tags.
+	size_t loaded_bytes;
+	// Opening tags of the elements not yet closed at loaded_bytes.
+	std::vector<std::string> open_tags;
+	// Groups corresponding to the leading <g> tags in open_tags.
+	std::vector<int> open_groups;
+	// Region and stride given to load_region.
+	Rect region;
+	size_t region_stride;
+	// Buffer being parsed and its position in the file.
+	const char* buffer_start;
+	size_t buffer_offset;
+};
+
+// Functions called by stream_svg_file. Elements without a function are
+// skipped without being parsed.
+class StreamCallbacks
+{
+public:
+	// Called with the size of the SVG.
+	std::function<void(double, double)> on_size;
+	std::function<void(Line&)> on_line;
+	std::function<void(Polygon&)> on_polygon;
+	std::function<void(Path&)> on_path;
+	std::function<void(Polyline&)> on_polyline;
+	std::function<void(Rectangle&)> on_rectangle;
+	std::function<void(Ellipse&)> on_ellipse;
 };
 
-void parse_color(const char* color, float* r, float* g, float* b);
+// Streams the elements of an SVG file in document order without holding
+// the file in memory.
+void stream_svg_file(const std::string& filename,
+                     const StreamCallbacks& callbacks);
 
 }
 
@@ -0,0 +1,53 @@
+// Petter Strandmark 2013.
+
+#include "symbol.h"
+
+namespace rapidsvg {
+
+namespace
+{
+	template<typename Element>
+	void add_boxes(const std::vector<Element>& elements, bool* empty, Rect* box)
+	{
+		for (auto& element : elements) {
+			Rect element_box = element.bounding_box();
+			if (*empty) {
+				*box = element_box;
+				*empty = false;
+			}
+			else {
+				box->add(element_box.x_min, element_box.y_min);
+				box->add(element_box.x_max, element_box.y_max);
+			}
+		}
+	}
+}
+
+Rect Symbol::bounding_box() const
+{
+	bool empty = true;
+	Rect box;
+	add_boxes(lines, &empty, &box);
+	add_boxes(polygons, &empty, &box);
+	add_boxes(paths, &empty, &box);
+	add_boxes(polylines, &empty, &box);
+	add_boxes(rectangles, &empty, &box);
+	add_boxes(ellipses, &empty, &box);
+	return box;
+}
+
+Rect SymbolUse::bounding_box(const Rect& symbol_box) const
+{
+	float corners[8] = {symbol_box.x_min, symbol_box.y_min,
+	                    symbol_box.x_max, symbol_box.y_min,
+	                    symbol_box.x_max, symbol_box.y_max,
+	                    symbol_box.x_min, symbol_box.y_max};
+	transform.apply(corners, 4);
+	Rect box(corners[0], corners[1], corners[0], corners[1]);
+	for (int i = 1; i < 4; ++i) {
+		box.add(corners[2 * i], corners[2 * i + 1]);
+	}
+	return box;
+}
+
+}
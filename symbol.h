@@ -0,0 +1,63 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_SYMBOL_H
+#define RAPIDSVG_SYMBOL_H
+
+#include <cstdint>
+#include <vector>
+
+#include "line.h"
+#include "path.h"
+#include "polygon.h"
+#include "rect.h"
+#include "shapes.h"
+#include "transform.h"
+
+namespace rapidsvg {
+
+// Elements referenced by <use> elements, e.g. a <symbol> or an element in
+// <defs>. They are stored once, in the coordinates of the symbol, however
+// many times they are used. The orders of the elements number them in
+// document order within the symbol.
+class Symbol
+{
+public:
+	std::vector<Line> lines;
+	std::vector<Polygon> polygons;
+	std::vector<Path> paths;
+	std::vector<Polyline> polylines;
+	std::vector<Rectangle> rectangles;
+	std::vector<Ellipse> ellipses;
+
+	size_t num_elements() const
+	{
+		return lines.size() + polygons.size() + paths.size() +
+		       polylines.size() + rectangles.size() + ellipses.size();
+	}
+
+	// Returns the rectangle covered by all elements.
+	Rect bounding_box() const;
+};
+
+// A <use> element: a symbol drawn with a transform.
+class SymbolUse
+{
+public:
+	SymbolUse() : symbol(0), order(0)
+	{ }
+	// Index of the symbol in SVGFile::symbols.
+	int symbol;
+	// From the coordinates of the symbol to those of the SVG.
+	Transform transform;
+	// Position of the use in the document. The elements of the symbol
+	// take the positions from it on, one each.
+	std::uint32_t order;
+
+	// Returns the rectangle covered by the use of a symbol with the given
+	// bounding box.
+	Rect bounding_box(const Rect& symbol_box) const;
+};
+
+}
+
+#endif
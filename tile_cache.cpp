@@ -0,0 +1,221 @@
+// Petter Strandmark 2013.
+
+#include <algorithm>
+#include <cmath>
+
+#include "svg_file.h"
+#include "tile_cache.h"
+
+namespace rapidsvg {
+
+namespace
+{
+	// Number of levels whose triangles are kept.
+	const size_t max_scenes = 3;
+	// Curves are flattened to within this fraction of a tile pixel.
+	const double pixel_tolerance = 0.25;
+}
+
+const int TileCache::tile_size;
+const int TileCache::max_level;
+
+TileCache::TileCache(const SVGFile& file_, size_t memory_budget_, int num_threads)
+	: file(file_),
+	  extent(std::max(1.0, std::max(file_.get_width(), file_.get_height()))),
+	  memory_budget(memory_budget_),
+	  memory_used(0),
+	  frame(0),
+	  num_rendering(0),
+	  generation(0),
+	  stopping(false)
+{
+	if (num_threads <= 0) {
+		num_threads = std::max(1, int(std::thread::hardware_concurrency()) - 1);
+	}
+	for (int t = 0; t < num_threads; ++t) {
+		threads.push_back(std::thread(&TileCache::render_tiles, this));
+	}
+}
+
+TileCache::~TileCache()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+int TileCache::level_for(double pixels_per_unit) const
+{
+	double tiles = pixels_per_unit * extent / tile_size;
+	if (!(tiles > 1)) {
+		return 0;
+	}
+	return std::min(max_level, int(std::ceil(std::log2(tiles) - 1e-9)));
+}
+
+Rect TileCache::tile_region(const TileKey& key) const
+{
+	double size = extent / tiles_per_side(key.level);
+	return Rect(float(key.x * size), float(key.y * size),
+	            float((key.x + 1) * size), float((key.y + 1) * size));
+}
+
+Tile* TileCache::find(const TileKey& key)
+{
+	auto itr = tiles.find(key);
+	if (itr == tiles.end()) {
+		return 0;
+	}
+	itr->second->last_used = frame;
+	return itr->second.get();
+}
+
+void TileCache::request(const std::vector<TileKey>& keys)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& key : queue) {
+		pending.erase(key);
+	}
+	queue.clear();
+	for (auto& key : keys) {
+		if (tiles.count(key) == 0 && pending.insert(key).second) {
+			queue.push_back(key);
+		}
+	}
+	if (!queue.empty()) {
+		wake.notify_all();
+	}
+}
+
+bool TileCache::collect()
+{
+	++frame;
+	std::vector<std::unique_ptr<Tile> > collected;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		collected.swap(finished);
+		for (auto& tile : collected) {
+			pending.erase(tile->key);
+		}
+	}
+	for (auto& tile : collected) {
+		memory_used += tile->image.memory_bytes();
+		tile->last_used = frame;
+		tiles[tile->key] = std::move(tile);
+	}
+
+	// Tiles found in the last frame are kept even above the budget.
+	while (memory_used > memory_budget) {
+		auto oldest = tiles.end();
+		for (auto itr = tiles.begin(); itr != tiles.end(); ++itr) {
+			if (oldest == tiles.end() || itr->second->last_used < oldest->second->last_used) {
+				oldest = itr;
+			}
+		}
+		if (oldest == tiles.end() || oldest->second->last_used + 1 >= frame) {
+			break;
+		}
+		release(oldest->second.get());
+		tiles.erase(oldest);
+	}
+	return !collected.empty();
+}
+
+bool TileCache::busy()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return !pending.empty();
+}
+
+void TileCache::invalidate()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		++generation;
+		queue.clear();
+		idle.wait(lock, [this] { return num_rendering == 0; });
+		pending.clear();
+		finished.clear();
+	}
+	{
+		std::lock_guard<std::mutex> lock(scene_mutex);
+		scenes.clear();
+		scene_levels.clear();
+	}
+	for (auto& tile : tiles) {
+		release(tile.second.get());
+	}
+	tiles.clear();
+	extent = std::max(1.0, std::max(file.get_width(), file.get_height()));
+}
+
+void TileCache::release(Tile* tile)
+{
+	memory_used -= tile->image.memory_bytes();
+	if (tile->texture != 0) {
+		released_textures.push_back(tile->texture);
+	}
+}
+
+void TileCache::render_tiles()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		wake.wait(lock, [this] { return stopping || !queue.empty(); });
+		if (stopping) {
+			return;
+		}
+		TileKey key = queue.front();
+		queue.pop_front();
+		size_t tile_generation = generation;
+		Rect region = tile_region(key);
+		++num_rendering;
+		lock.unlock();
+
+		std::unique_ptr<Tile> tile(new Tile);
+		tile->key = key;
+		tile->image.clear(tile_size, tile_size);
+		scene_for(key.level)->render(region, &tile->image);
+
+		lock.lock();
+		--num_rendering;
+		if (generation == tile_generation) {
+			finished.push_back(std::move(tile));
+		}
+		if (num_rendering == 0) {
+			idle.notify_all();
+		}
+	}
+}
+
+std::shared_ptr<const SceneRaster> TileCache::scene_for(int level)
+{
+	// Levels are built one at a time; other threads wait for the level
+	// instead of building it again.
+	std::lock_guard<std::mutex> lock(scene_mutex);
+	auto itr = scenes.find(level);
+	if (itr != scenes.end()) {
+		scene_levels.erase(std::find(scene_levels.begin(), scene_levels.end(), level));
+		scene_levels.push_back(level);
+		return itr->second;
+	}
+
+	double units_per_pixel = extent / tiles_per_side(level) / tile_size;
+	std::shared_ptr<const SceneRaster> scene =
+		std::make_shared<SceneRaster>(file, float(pixel_tolerance * units_per_pixel));
+	scenes[level] = scene;
+	scene_levels.push_back(level);
+	// Tiles being rendered keep their triangles until they are done.
+	if (scene_levels.size() > max_scenes) {
+		scenes.erase(scene_levels.front());
+		scene_levels.pop_front();
+	}
+	return scene;
+}
+
+}
@@ -0,0 +1,151 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_TILE_CACHE_H
+#define RAPIDSVG_TILE_CACHE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "raster.h"
+#include "rect.h"
+
+namespace rapidsvg {
+
+class SVGFile;
+
+// A tile of the pyramid. At level z, the square [0, extent]^2 around the
+// SVG is covered by 2^z x 2^z tiles.
+class TileKey
+{
+public:
+	TileKey() : level(0), x(0), y(0)
+	{ }
+	TileKey(int level_, int x_, int y_) : level(level_), x(x_), y(y_)
+	{ }
+	int level, x, y;
+
+	bool operator==(const TileKey& other) const
+	{
+		return level == other.level && x == other.x && y == other.y;
+	}
+	// The tile at the level above covering this one.
+	TileKey parent() const { return TileKey(level - 1, x / 2, y / 2); }
+};
+
+class TileKeyHash
+{
+public:
+	size_t operator()(const TileKey& key) const
+	{
+		return (size_t(key.level) << 48) ^ (size_t(key.x) << 24) ^ size_t(key.y);
+	}
+};
+
+// A rendered tile.
+class Tile
+{
+public:
+	Tile() : texture(0), last_used(0)
+	{ }
+	TileKey key;
+	Image image;
+	// A texture holding the image, made and owned by the viewer, or 0.
+	unsigned texture;
+	// Frame the tile was last found in.
+	size_t last_used;
+};
+
+// Tiles of a file rendered in software by background threads, kept
+// until the images exceed a memory budget and then evicted least
+// recently used first. The triangles for a level are made by the first
+// tile of the level and shared by the others.
+//
+// All functions are called from one thread, and the file may only be
+// changed between invalidate and the next request.
+class TileCache
+{
+public:
+	static const int tile_size = 256;
+	static const int max_level = 24;
+
+	// Renders with num_threads threads, or one fewer than the number of
+	// cores if 0.
+	TileCache(const SVGFile& file, size_t memory_budget, int num_threads = 0);
+	~TileCache();
+
+	// The level with at least the given number of tile pixels per unit,
+	// or max_level.
+	int level_for(double pixels_per_unit) const;
+	// The part of the SVG covered by a tile.
+	Rect tile_region(const TileKey& key) const;
+	// Number of tiles along each side at a level.
+	static int tiles_per_side(int level) { return 1 << level; }
+
+	// Returns the tile if it has been rendered, or null.
+	Tile* find(const TileKey& key);
+	// Replaces the tiles waiting to be rendered by those of keys that are
+	// not rendered or being rendered. They are rendered in order.
+	void request(const std::vector<TileKey>& keys);
+	// Starts a new frame and adds the tiles rendered since the last call,
+	// evicting old tiles if needed. Returns whether any were added.
+	bool collect();
+	// Whether any tiles are waiting, being rendered or not yet collected.
+	bool busy();
+	// Drops all tiles and triangles after waiting for the tiles being
+	// rendered. Must be called before the file is changed.
+	void invalidate();
+
+	// Textures of tiles evicted since they were last cleared, for the
+	// viewer to delete.
+	std::vector<unsigned> released_textures;
+
+private:
+	TileCache(const TileCache&);
+	TileCache& operator=(const TileCache&);
+
+	void render_tiles();
+	std::shared_ptr<const SceneRaster> scene_for(int level);
+	void release(Tile* tile);
+
+	const SVGFile& file;
+	double extent;
+	size_t memory_budget;
+
+	// Rendered and collected tiles, and the frame counter.
+	std::unordered_map<TileKey, std::unique_ptr<Tile>, TileKeyHash> tiles;
+	size_t memory_used;
+	size_t frame;
+
+	// Shared with the threads rendering tiles.
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	std::deque<TileKey> queue;
+	// Tiles queued, being rendered or rendered but not collected.
+	std::unordered_set<TileKey, TileKeyHash> pending;
+	std::vector<std::unique_ptr<Tile> > finished;
+	int num_rendering;
+	// Incremented by invalidate, so that tiles of the old file are
+	// dropped.
+	size_t generation;
+	bool stopping;
+
+	// Triangles of the most recently used levels.
+	std::mutex scene_mutex;
+	std::map<int, std::shared_ptr<const SceneRaster> > scenes;
+	std::deque<int> scene_levels;
+
+	std::vector<std::thread> threads;
+};
+
+}
+
+#endif
@@ -0,0 +1,224 @@
+// Petter Strandmark 2013.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <exception>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+	#include <direct.h>
+#else
+	#include <sys/stat.h>
+#endif
+
+#include "png_writer.h"
+#include "raster.h"
+#include "svg_file.h"
+#include "tile_cache.h"
+#include "tile_pyramid.h"
+
+namespace rapidsvg {
+
+namespace
+{
+	const int tile_size = TileCache::tile_size;
+	// Tiles of this level and the levels below them are rendered by one
+	// thread each. The images of this level are kept until the levels
+	// above it are made.
+	const int parallel_level = 4;
+	// Curves are flattened to within this fraction of a pixel.
+	const double pixel_tolerance = 0.25;
+
+	void make_directory(const std::string& path)
+	{
+		#ifdef _WIN32
+			int result = _mkdir(path.c_str());
+		#else
+			int result = mkdir(path.c_str(), 0755);
+		#endif
+		if (result != 0 && errno != EEXIST) {
+			throw std::runtime_error("Could not create " + path + ".");
+		}
+	}
+
+	bool is_blank(const Image& image)
+	{
+		for (auto value : image.pixels) {
+			if (value != 255) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Scales image down to half its size into the quarter (qx, qy) of
+	// parent, averaging every 2x2 pixels.
+	void add_quarter(const Image& image, int qx, int qy, Image* parent)
+	{
+		const int half = tile_size / 2;
+		for (int y = 0; y < half; ++y) {
+			const std::uint8_t* row0 = &image.pixels[4 * size_t(2 * y) * tile_size];
+			const std::uint8_t* row1 = row0 + 4 * tile_size;
+			std::uint8_t* out = &parent->pixels[4 * (size_t(qy * half + y) * tile_size + qx * half)];
+			for (int x = 0; x < half; ++x) {
+				for (int c = 0; c < 4; ++c) {
+					int sum = row0[8 * x + c] + row0[8 * x + 4 + c] +
+					          row1[8 * x + c] + row1[8 * x + 4 + c];
+					out[4 * x + c] = std::uint8_t((sum + 2) / 4);
+				}
+			}
+		}
+	}
+
+	class PyramidExport
+	{
+	public:
+		PyramidExport(const SceneRaster& scene_, const std::string& directory_,
+		              int max_level_, double extent_)
+			: scene(scene_), directory(directory_), max_level(max_level_),
+			  extent(extent_), num_written(0)
+		{ }
+
+		// Makes and writes the tile and all tiles below it, and returns
+		// whether it has any elements. The image holds the tile afterwards.
+		bool export_subtree(const TileKey& key, Image* image)
+		{
+			double size = extent / TileCache::tiles_per_side(key.level);
+			Rect region(float(key.x * size), float(key.y * size),
+			            float((key.x + 1) * size), float((key.y + 1) * size));
+			if (!scene.overlaps(region)) {
+				return false;
+			}
+			image->clear(tile_size, tile_size);
+			if (key.level == max_level) {
+				scene.render(region, image);
+				if (is_blank(*image)) {
+					return false;
+				}
+			}
+			else {
+				Image child;
+				bool any = false;
+				for (int k = 0; k < 4; ++k) {
+					TileKey child_key(key.level + 1, 2 * key.x + k % 2, 2 * key.y + k / 2);
+					if (export_subtree(child_key, &child)) {
+						add_quarter(child, k % 2, k / 2, image);
+						any = true;
+					}
+				}
+				if (!any) {
+					return false;
+				}
+			}
+			write(key, *image);
+			return true;
+		}
+
+		// Makes and writes the tile from the four images below it, which
+		// are empty if those tiles have no elements.
+		bool export_from_children(const TileKey& key, const Image* children[4], Image* image)
+		{
+			image->clear(tile_size, tile_size);
+			bool any = false;
+			for (int k = 0; k < 4; ++k) {
+				if (!children[k]->pixels.empty()) {
+					add_quarter(*children[k], k % 2, k / 2, image);
+					any = true;
+				}
+			}
+			if (any) {
+				write(key, *image);
+			}
+			return any;
+		}
+
+		size_t get_num_written() const { return num_written; }
+
+	private:
+		void write(const TileKey& key, const Image& image)
+		{
+			std::string level = directory + "/" + std::to_string(key.level);
+			std::string column = level + "/" + std::to_string(key.x);
+			make_directory(level);
+			make_directory(column);
+			write_png(column + "/" + std::to_string(key.y) + ".png", image);
+			++num_written;
+		}
+
+		const SceneRaster& scene;
+		std::string directory;
+		int max_level;
+		double extent;
+		std::atomic<size_t> num_written;
+	};
+}
+
+int default_max_level(const SVGFile& file)
+{
+	double extent = std::max(file.get_width(), file.get_height());
+	double tiles = extent / tile_size;
+	return tiles > 1 ? std::min(TileCache::max_level, int(std::ceil(std::log2(tiles)))) : 0;
+}
+
+size_t export_tile_pyramid(const SVGFile& file, const std::string& directory,
+                           int max_level)
+{
+	using namespace std;
+
+	max_level = max(0, min(TileCache::max_level, max_level));
+	const double extent = max(1.0, max(file.get_width(), file.get_height()));
+	const double units_per_pixel = extent / TileCache::tiles_per_side(max_level) / tile_size;
+	SceneRaster scene(file, float(pixel_tolerance * units_per_pixel));
+	make_directory(directory);
+	PyramidExport pyramid(scene, directory, max_level, extent);
+
+	// The subtrees below the parallel level are made in parallel. Images
+	// of tiles without elements are left empty.
+	const int level = min(max_level, parallel_level);
+	const int side = TileCache::tiles_per_side(level);
+	vector<Image> images(size_t(side) * side);
+	exception_ptr error;
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < side * side; ++i) {
+		try {
+			if (!pyramid.export_subtree(TileKey(level, i % side, i / side), &images[i])) {
+				images[i] = Image();
+			}
+		}
+		catch (...) {
+			#pragma omp critical
+			{
+				error = current_exception();
+			}
+		}
+	}
+	if (error) {
+		rethrow_exception(error);
+	}
+
+	// The levels above are made from the images of the level below.
+	for (int z = level - 1; z >= 0; --z) {
+		const int child_side = TileCache::tiles_per_side(z + 1);
+		const int parent_side = TileCache::tiles_per_side(z);
+		vector<Image> parents(size_t(parent_side) * parent_side);
+		for (int y = 0; y < parent_side; ++y) {
+			for (int x = 0; x < parent_side; ++x) {
+				const Image* children[4];
+				for (int k = 0; k < 4; ++k) {
+					children[k] = &images[size_t(2 * y + k / 2) * child_side + 2 * x + k % 2];
+				}
+				Image& parent = parents[size_t(y) * parent_side + x];
+				if (!pyramid.export_from_children(TileKey(z, x, y), children, &parent)) {
+					parent = Image();
+				}
+			}
+		}
+		images.swap(parents);
+	}
+	return pyramid.get_num_written();
+}
+
+}
@@ -0,0 +1,28 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_TILE_PYRAMID_H
+#define RAPIDSVG_TILE_PYRAMID_H
+
+#include <string>
+
+namespace rapidsvg {
+
+class SVGFile;
+
+// Renders the file into a pyramid of 256x256 PNG tiles laid out as
+// directory/z/x/y.png, as read by XYZ web viewers. Level 0 is a single
+// tile covering the square around the SVG and every level has twice as
+// many tiles along each side as the one above, down to max_level, which
+// is rendered in parallel. The levels above are scaled down from the
+// tiles below them. Tiles without any elements are not written. Memory
+// use grows with the number of levels and threads but not with the
+// number of tiles. Returns the number of tiles written.
+size_t export_tile_pyramid(const SVGFile& file, const std::string& directory,
+                           int max_level);
+
+// The level with about one tile pixel per unit of the file.
+int default_max_level(const SVGFile& file);
+
+}
+
+#endif
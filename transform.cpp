@@ -0,0 +1,140 @@
+// Petter Strandmark 2013.
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "transform.h"
+
+namespace rapidsvg {
+
+Transform Transform::operator*(const Transform& other) const
+{
+	return Transform(a * other.a + c * other.b,
+	                 b * other.a + d * other.b,
+	                 a * other.c + c * other.d,
+	                 b * other.c + d * other.d,
+	                 a * other.e + c * other.f + e,
+	                 b * other.e + d * other.f + f);
+}
+
+double Transform::scale() const
+{
+	return std::sqrt(std::abs(a * d - b * c));
+}
+
+void Transform::apply(float* xy, std::size_t num_points) const
+{
+	// Plain single-precision loop over interleaved coordinates, which
+	// the compiler vectorizes.
+	const float fa = float(a), fb = float(b), fc = float(c);
+	const float fd = float(d), fe = float(e), ff = float(f);
+	for (std::size_t i = 0; i < num_points; ++i) {
+		float x = xy[2 * i];
+		float y = xy[2 * i + 1];
+		xy[2 * i]     = fa * x + fc * y + fe;
+		xy[2 * i + 1] = fb * x + fd * y + ff;
+	}
+}
+
+bool parse_transform(const char* text, Transform* transform)
+{
+	using namespace std;
+
+	const double pi = 3.14159265358979323846;
+	Transform result;
+	const char* ptr = text;
+	while (true) {
+		while (*ptr == ' ' || *ptr == ',' || *ptr == '\t' ||
+		       *ptr == '\r' || *ptr == '\n') {
+			ptr++;
+		}
+		if (*ptr == '\0') {
+			break;
+		}
+
+		const char* name = ptr;
+		while (*ptr && *ptr != '(') {
+			ptr++;
+		}
+		if (*ptr != '(') {
+			*transform = Transform();
+			return false;
+		}
+		size_t name_length = ptr - name;
+		while (name_length > 0 && name[name_length - 1] == ' ') {
+			name_length--;
+		}
+		ptr++;
+
+		// Read up to six arguments.
+		double args[6];
+		int num_args = 0;
+		while (true) {
+			while (*ptr == ' ' || *ptr == ',' || *ptr == '\t' ||
+			       *ptr == '\r' || *ptr == '\n') {
+				ptr++;
+			}
+			if (*ptr == ')' || *ptr == '\0' || num_args == 6) {
+				break;
+			}
+			char* end;
+			args[num_args] = strtod(ptr, &end);
+			if (end == ptr) {
+				break;
+			}
+			num_args++;
+			ptr = end;
+		}
+		if (*ptr != ')') {
+			*transform = Transform();
+			return false;
+		}
+		ptr++;
+
+		Transform t;
+		if (name_length == 6 && strncmp(name, "matrix", 6) == 0 && num_args == 6) {
+			t = Transform(args[0], args[1], args[2], args[3], args[4], args[5]);
+		}
+		else if (name_length == 9 && strncmp(name, "translate", 9) == 0 &&
+		         (num_args == 1 || num_args == 2)) {
+			t.e = args[0];
+			t.f = num_args == 2 ? args[1] : 0;
+		}
+		else if (name_length == 5 && strncmp(name, "scale", 5) == 0 &&
+		         (num_args == 1 || num_args == 2)) {
+			t.a = args[0];
+			t.d = num_args == 2 ? args[1] : args[0];
+		}
+		else if (name_length == 6 && strncmp(name, "rotate", 6) == 0 &&
+		         (num_args == 1 || num_args == 3)) {
+			double angle = args[0] * pi / 180;
+			Transform rotation(cos(angle), sin(angle), -sin(angle), cos(angle), 0, 0);
+			if (num_args == 3) {
+				// Rotation around (cx, cy).
+				Transform to_center(1, 0, 0, 1, args[1], args[2]);
+				Transform from_center(1, 0, 0, 1, -args[1], -args[2]);
+				t = to_center * rotation * from_center;
+			}
+			else {
+				t = rotation;
+			}
+		}
+		else if (name_length == 5 && strncmp(name, "skewX", 5) == 0 && num_args == 1) {
+			t.c = tan(args[0] * pi / 180);
+		}
+		else if (name_length == 5 && strncmp(name, "skewY", 5) == 0 && num_args == 1) {
+			t.b = tan(args[0] * pi / 180);
+		}
+		else {
+			*transform = Transform();
+			return false;
+		}
+
+		result = result * t;
+	}
+	*transform = result;
+	return true;
+}
+
+}
@@ -0,0 +1,44 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_TRANSFORM_H
+#define RAPIDSVG_TRANSFORM_H
+
+#include <cstddef>
+
+namespace rapidsvg {
+
+// Affine transformation as in SVG, mapping (x, y) to
+// (a*x + c*y + e, b*x + d*y + f).
+class Transform
+{
+public:
+	Transform() : a(1), b(0), c(0), d(1), e(0), f(0)
+	{ }
+	Transform(double a_, double b_, double c_, double d_, double e_, double f_) :
+		a(a_), b(b_), c(c_), d(d_), e(e_), f(f_)
+	{ }
+	double a, b, c, d, e, f;
+
+	// The transformation applying other first and then this.
+	Transform operator*(const Transform& other) const;
+
+	bool is_identity() const
+	{
+		return a == 1 && b == 0 && c == 0 && d == 1 && e == 0 && f == 0;
+	}
+
+	// Factor by which lengths such as stroke widths are scaled.
+	double scale() const;
+
+	// Transforms num_points points stored as x0, y0, x1, y1, ...
+	void apply(float* xy, std::size_t num_points) const;
+};
+
+// Parses an SVG transform list, e.g. "translate(10,20) rotate(45)".
+// Returns false, setting transform to the identity, if the list is
+// invalid.
+bool parse_transform(const char* text, Transform* transform);
+
+}
+
+#endif
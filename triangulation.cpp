@@ -0,0 +1,707 @@
+// Petter Strandmark 2013.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "triangulation.h"
+
+namespace rapidsvg {
+
+namespace
+{
+	typedef Triangulator::Node Node;
+
+	// Rings with more points than this are clipped with the z-order curve.
+	const size_t min_hashed_points = 80;
+
+	// Twice the signed area of the triangle pqr, negative if it turns
+	// left when walking the ring in the order the nodes are linked.
+	float area(const Node* p, const Node* q, const Node* r)
+	{
+		return (q->y - p->y) * (r->x - q->x) - (q->x - p->x) * (r->y - q->y);
+	}
+
+	bool equals(const Node* a, const Node* b)
+	{
+		return a->x == b->x && a->y == b->y;
+	}
+
+	int sign(float value)
+	{
+		return value > 0 ? 1 : (value < 0 ? -1 : 0);
+	}
+
+	bool point_in_triangle(float ax, float ay, float bx, float by, float cx, float cy,
+	                       float px, float py)
+	{
+		return (cx - px) * (ay - py) >= (ax - px) * (cy - py) &&
+		       (ax - px) * (by - py) >= (bx - px) * (ay - py) &&
+		       (bx - px) * (cy - py) >= (cx - px) * (by - py);
+	}
+
+	// Whether q lies in the bounding box of p and r.
+	bool on_segment(const Node* p, const Node* q, const Node* r)
+	{
+		return q->x <= std::max(p->x, r->x) && q->x >= std::min(p->x, r->x) &&
+		       q->y <= std::max(p->y, r->y) && q->y >= std::min(p->y, r->y);
+	}
+
+	bool intersects(const Node* p1, const Node* q1, const Node* p2, const Node* q2)
+	{
+		int o1 = sign(area(p1, q1, p2));
+		int o2 = sign(area(p1, q1, q2));
+		int o3 = sign(area(p2, q2, p1));
+		int o4 = sign(area(p2, q2, q1));
+		return (o1 != o2 && o3 != o4) ||
+		       (o1 == 0 && on_segment(p1, p2, q1)) ||
+		       (o2 == 0 && on_segment(p1, q2, q1)) ||
+		       (o3 == 0 && on_segment(p2, p1, q2)) ||
+		       (o4 == 0 && on_segment(p2, q1, q2));
+	}
+
+	// Whether the segment ab crosses an edge of the ring of a.
+	bool intersects_polygon(const Node* a, const Node* b)
+	{
+		const Node* p = a;
+		do {
+			if (p->i != a->i && p->next->i != a->i && p->i != b->i && p->next->i != b->i &&
+			    intersects(p, p->next, a, b)) {
+				return true;
+			}
+			p = p->next;
+		} while (p != a);
+		return false;
+	}
+
+	// Whether the segment from a to b starts inside the ring at a.
+	bool locally_inside(const Node* a, const Node* b)
+	{
+		return area(a->prev, a, a->next) < 0 ?
+		       area(a, b, a->next) >= 0 && area(a, a->prev, b) >= 0 :
+		       area(a, b, a->prev) < 0 || area(a, a->next, b) < 0;
+	}
+
+	// Whether the middle of the segment ab is inside the ring.
+	bool middle_inside(const Node* a, const Node* b)
+	{
+		const Node* p = a;
+		bool inside = false;
+		float px = (a->x + b->x) / 2;
+		float py = (a->y + b->y) / 2;
+		do {
+			if ((p->y > py) != (p->next->y > py) && p->next->y != p->y &&
+			    px < (p->next->x - p->x) * (py - p->y) / (p->next->y - p->y) + p->x) {
+				inside = !inside;
+			}
+			p = p->next;
+		} while (p != a);
+		return inside;
+	}
+
+	// Whether the segment ab splits the ring into two without crossing it.
+	bool is_valid_diagonal(const Node* a, const Node* b)
+	{
+		return a->next->i != b->i && a->prev->i != b->i && !intersects_polygon(a, b) &&
+		       ((locally_inside(a, b) && locally_inside(b, a) && middle_inside(a, b) &&
+		         (area(a->prev, a, b->prev) != 0 || area(a, b->prev, b) != 0)) ||
+		        (equals(a, b) && area(a->prev, a, a->next) > 0 &&
+		         area(b->prev, b, b->next) > 0));
+	}
+
+	void remove_node(Node* p)
+	{
+		p->next->prev = p->prev;
+		p->prev->next = p->next;
+		if (p->prev_z) {
+			p->prev_z->next_z = p->next_z;
+		}
+		if (p->next_z) {
+			p->next_z->prev_z = p->prev_z;
+		}
+	}
+
+	// Removes repeated points and points on a straight line between their
+	// neighbours, from start until end. Returns a node still in the ring.
+	Node* filter_points(Node* start, Node* end = 0)
+	{
+		if (!start) {
+			return start;
+		}
+		if (!end) {
+			end = start;
+		}
+		Node* p = start;
+		bool again;
+		do {
+			again = false;
+			if (!p->steiner && (equals(p, p->next) || area(p->prev, p, p->next) == 0)) {
+				remove_node(p);
+				p = end = p->prev;
+				if (p == p->next) {
+					break;
+				}
+				again = true;
+			}
+			else {
+				p = p->next;
+			}
+		} while (again || p != end);
+		return end;
+	}
+
+	// Position of a point along the z-order curve, with the coordinates
+	// scaled to 15 bits.
+	std::int32_t z_order(float x, float y, float min_x, float min_y, float scale)
+	{
+		std::uint32_t ix = std::uint32_t((x - min_x) * scale);
+		std::uint32_t iy = std::uint32_t((y - min_y) * scale);
+		ix = (ix | (ix << 8)) & 0x00FF00FF;
+		ix = (ix | (ix << 4)) & 0x0F0F0F0F;
+		ix = (ix | (ix << 2)) & 0x33333333;
+		ix = (ix | (ix << 1)) & 0x55555555;
+		iy = (iy | (iy << 8)) & 0x00FF00FF;
+		iy = (iy | (iy << 4)) & 0x0F0F0F0F;
+		iy = (iy | (iy << 2)) & 0x33333333;
+		iy = (iy | (iy << 1)) & 0x55555555;
+		return std::int32_t(ix | (iy << 1));
+	}
+
+	// Sorts the list linked by next_z by z with a bottom-up merge sort.
+	void sort_linked(Node* list)
+	{
+		size_t in_size = 1;
+		size_t num_merges;
+		do {
+			Node* p = list;
+			Node* tail = 0;
+			list = 0;
+			num_merges = 0;
+			while (p) {
+				num_merges++;
+				Node* q = p;
+				size_t p_size = 0;
+				for (size_t i = 0; i < in_size && q; ++i) {
+					p_size++;
+					q = q->next_z;
+				}
+				size_t q_size = in_size;
+				while (p_size > 0 || (q_size > 0 && q)) {
+					Node* e;
+					if (p_size != 0 && (q_size == 0 || !q || p->z <= q->z)) {
+						e = p;
+						p = p->next_z;
+						p_size--;
+					}
+					else {
+						e = q;
+						q = q->next_z;
+						q_size--;
+					}
+					if (tail) {
+						tail->next_z = e;
+					}
+					else {
+						list = e;
+					}
+					e->prev_z = tail;
+					tail = e;
+				}
+				p = q;
+			}
+			tail->next_z = 0;
+			in_size *= 2;
+		} while (num_merges > 1);
+	}
+
+	bool is_ear(const Node* ear)
+	{
+		const Node* a = ear->prev;
+		const Node* b = ear;
+		const Node* c = ear->next;
+		if (area(a, b, c) >= 0) {
+			// Reflex corner.
+			return false;
+		}
+		float x0 = std::min(a->x, std::min(b->x, c->x));
+		float y0 = std::min(a->y, std::min(b->y, c->y));
+		float x1 = std::max(a->x, std::max(b->x, c->x));
+		float y1 = std::max(a->y, std::max(b->y, c->y));
+		for (const Node* p = c->next; p != a; p = p->next) {
+			if (p->x >= x0 && p->x <= x1 && p->y >= y0 && p->y <= y1 &&
+			    point_in_triangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) &&
+			    area(p->prev, p, p->next) >= 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// As is_ear, but only looks at the points whose z-order lies within
+	// the bounding box of the triangle.
+	bool is_ear_hashed(const Node* ear, float min_x, float min_y, float scale)
+	{
+		const Node* a = ear->prev;
+		const Node* b = ear;
+		const Node* c = ear->next;
+		if (area(a, b, c) >= 0) {
+			return false;
+		}
+		float x0 = std::min(a->x, std::min(b->x, c->x));
+		float y0 = std::min(a->y, std::min(b->y, c->y));
+		float x1 = std::max(a->x, std::max(b->x, c->x));
+		float y1 = std::max(a->y, std::max(b->y, c->y));
+		std::int32_t min_z = z_order(x0, y0, min_x, min_y, scale);
+		std::int32_t max_z = z_order(x1, y1, min_x, min_y, scale);
+
+		auto blocks = [&](const Node* p)
+		{
+			return p != a && p != c &&
+			       p->x >= x0 && p->x <= x1 && p->y >= y0 && p->y <= y1 &&
+			       point_in_triangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) &&
+			       area(p->prev, p, p->next) >= 0;
+		};
+		const Node* p = ear->prev_z;
+		const Node* n = ear->next_z;
+		while (p && p->z >= min_z && n && n->z <= max_z) {
+			if (blocks(p) || blocks(n)) {
+				return false;
+			}
+			p = p->prev_z;
+			n = n->next_z;
+		}
+		for (; p && p->z >= min_z; p = p->prev_z) {
+			if (blocks(p)) {
+				return false;
+			}
+		}
+		for (; n && n->z <= max_z; n = n->next_z) {
+			if (blocks(n)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Clips the corners where the ring crosses itself right after them.
+	Node* cure_local_intersections(Node* start, std::vector<std::uint32_t>* triangles)
+	{
+		Node* p = start;
+		do {
+			Node* a = p->prev;
+			Node* b = p->next->next;
+			if (!equals(a, b) && intersects(a, p, p->next, b) &&
+			    locally_inside(a, b) && locally_inside(b, a)) {
+				triangles->push_back(a->i);
+				triangles->push_back(p->i);
+				triangles->push_back(b->i);
+				remove_node(p);
+				remove_node(p->next);
+				p = start = b;
+			}
+			p = p->next;
+		} while (p != start);
+		return filter_points(p);
+	}
+
+	Node* leftmost(Node* start)
+	{
+		Node* p = start;
+		Node* left = start;
+		do {
+			if (p->x < left->x || (p->x == left->x && p->y < left->y)) {
+				left = p;
+			}
+			p = p->next;
+		} while (p != start);
+		return left;
+	}
+
+	bool sector_contains_sector(const Node* m, const Node* p)
+	{
+		return area(m->prev, m, p->prev) < 0 && area(p->next, m, m->next) < 0;
+	}
+
+	// Finds a point of the outer ring that the leftmost point of a hole
+	// can be joined to without crossing the ring.
+	Node* find_hole_bridge(const Node* hole, Node* outer)
+	{
+		Node* p = outer;
+		float hx = hole->x;
+		float hy = hole->y;
+		float qx = -std::numeric_limits<float>::infinity();
+		Node* m = 0;
+		// The nearest segment left of the hole point on its horizontal
+		// line, and the end of it furthest left.
+		do {
+			if (hy <= p->y && hy >= p->next->y && p->next->y != p->y) {
+				float x = p->x + (hy - p->y) * (p->next->x - p->x) / (p->next->y - p->y);
+				if (x <= hx && x > qx) {
+					qx = x;
+					m = p->x < p->next->x ? p : p->next;
+					if (x == hx) {
+						return m;
+					}
+				}
+			}
+			p = p->next;
+		} while (p != outer);
+		if (!m) {
+			return 0;
+		}
+
+		// Points inside the triangle of the hole point, the crossing and
+		// m would block the bridge; the one at the smallest angle is used
+		// instead.
+		const Node* stop = m;
+		float mx = m->x;
+		float my = m->y;
+		float tan_min = std::numeric_limits<float>::infinity();
+		p = m;
+		do {
+			if (hx >= p->x && p->x >= mx && hx != p->x &&
+			    point_in_triangle(hy < my ? hx : qx, hy, mx, my, hy < my ? qx : hx, hy,
+			                      p->x, p->y)) {
+				float tan = std::abs(hy - p->y) / (hx - p->x);
+				if (locally_inside(p, hole) &&
+				    (tan < tan_min || (tan == tan_min &&
+				                       (p->x > m->x || (p->x == m->x &&
+				                                        sector_contains_sector(m, p)))))) {
+					m = p;
+					tan_min = tan;
+				}
+			}
+			p = p->next;
+		} while (p != stop);
+		return m;
+	}
+
+	// Winding number of the ring from start to end around the point.
+	// Counterclockwise rings count as one.
+	int winding_number(const float* xy, std::uint32_t start, std::uint32_t end,
+	                   float px, float py)
+	{
+		int winding = 0;
+		for (std::uint32_t i = start, j = end - 1; i < end; j = i++) {
+			float x0 = xy[2 * j];
+			float y0 = xy[2 * j + 1];
+			float x1 = xy[2 * i];
+			float y1 = xy[2 * i + 1];
+			float left = (x1 - x0) * (py - y0) - (px - x0) * (y1 - y0);
+			if (y0 <= py) {
+				if (y1 > py && left > 0) {
+					winding++;
+				}
+			}
+			else if (y1 <= py && left < 0) {
+				winding--;
+			}
+		}
+		return winding;
+	}
+
+	bool filled(int winding, bool even_odd)
+	{
+		return even_odd ? (winding & 1) != 0 : winding != 0;
+	}
+}
+
+void Triangulator::triangulate(const float* xy, const std::uint32_t* ring_ends,
+                               size_t num_rings, bool even_odd,
+                               std::vector<std::uint32_t>* triangles)
+{
+	triangles->clear();
+	rings.clear();
+	std::uint32_t start = 0;
+	for (size_t k = 0; k < num_rings; ++k) {
+		Ring ring;
+		ring.start = start;
+		ring.end = ring_ends[k];
+		start = ring.end;
+		if (ring.end - ring.start < 3) {
+			continue;
+		}
+		ring.area = 0;
+		ring.x_min = ring.x_max = xy[2 * ring.start];
+		ring.y_min = ring.y_max = xy[2 * ring.start + 1];
+		for (std::uint32_t i = ring.start, j = ring.end - 1; i < ring.end; j = i++) {
+			ring.area += double(xy[2 * j]) * xy[2 * i + 1] - double(xy[2 * i]) * xy[2 * j + 1];
+			ring.x_min = std::min(ring.x_min, xy[2 * i]);
+			ring.y_min = std::min(ring.y_min, xy[2 * i + 1]);
+			ring.x_max = std::max(ring.x_max, xy[2 * i]);
+			ring.y_max = std::max(ring.y_max, xy[2 * i + 1]);
+		}
+		if (ring.area == 0) {
+			continue;
+		}
+		ring.parent = Ring::Outline;
+		rings.push_back(ring);
+	}
+
+	// A ring bounds the filled region if it is filled on one side only.
+	// The sides are told apart by the winding number of the other rings
+	// around a point of the ring: inside, the ring itself adds one.
+	auto contains = [&](const Ring& ring, float px, float py)
+	{
+		return px >= ring.x_min && px <= ring.x_max && py >= ring.y_min && py <= ring.y_max &&
+		       winding_number(xy, ring.start, ring.end, px, py) != 0;
+	};
+	auto test_point = [&](const Ring& ring, float* px, float* py)
+	{
+		// The middle of the first edge, which is less likely than a
+		// point of the ring to be shared with other rings.
+		*px = (xy[2 * ring.start] + xy[2 * ring.start + 2]) / 2;
+		*py = (xy[2 * ring.start + 1] + xy[2 * ring.start + 3]) / 2;
+	};
+	if (rings.size() > 1) {
+		for (auto& ring : rings) {
+			float px, py;
+			test_point(ring, &px, &py);
+			int outside = 0;
+			for (auto& other : rings) {
+				if (&other != &ring && px >= other.x_min && px <= other.x_max &&
+				    py >= other.y_min && py <= other.y_max) {
+					outside += winding_number(xy, other.start, other.end, px, py);
+				}
+			}
+			int inside = outside + (ring.area > 0 ? 1 : -1);
+			bool filled_inside = filled(inside, even_odd);
+			bool filled_outside = filled(outside, even_odd);
+			if (filled_inside == filled_outside) {
+				ring.parent = Ring::Unused;
+			}
+			else {
+				ring.parent = filled_inside ? Ring::Outline : Ring::Hole;
+			}
+		}
+		// Every hole belongs to the smallest outline around it.
+		for (auto& ring : rings) {
+			if (ring.parent != Ring::Hole) {
+				continue;
+			}
+			float px, py;
+			test_point(ring, &px, &py);
+			ring.parent = Ring::Unused;
+			double parent_area = 0;
+			for (size_t k = 0; k < rings.size(); ++k) {
+				const Ring& other = rings[k];
+				if (other.parent == Ring::Outline &&
+				    (ring.parent < 0 || std::abs(other.area) < parent_area) &&
+				    contains(other, px, py)) {
+					ring.parent = int(k);
+					parent_area = std::abs(other.area);
+				}
+			}
+		}
+	}
+
+	for (size_t k = 0; k < rings.size(); ++k) {
+		if (rings[k].parent != Ring::Outline) {
+			continue;
+		}
+		outline_holes.clear();
+		for (auto& ring : rings) {
+			if (ring.parent == int(k)) {
+				outline_holes.push_back(&ring);
+			}
+		}
+		clip(xy, rings[k], outline_holes, triangles);
+	}
+	nodes.clear();
+}
+
+void Triangulator::clip(const float* xy, const Ring& outline,
+                        const std::vector<const Ring*>& holes,
+                        std::vector<std::uint32_t>* triangles)
+{
+	nodes.clear();
+	Node* outer = linked_list(xy, outline.start, outline.end, true);
+	if (!outer || outer->next == outer->prev) {
+		return;
+	}
+	if (!holes.empty()) {
+		outer = eliminate_holes(xy, holes, outer);
+	}
+
+	z_scale = 0;
+	size_t num_points = outline.end - outline.start;
+	for (auto hole : holes) {
+		num_points += hole->end - hole->start;
+	}
+	if (num_points > min_hashed_points) {
+		min_x = outline.x_min;
+		min_y = outline.y_min;
+		float size = std::max(outline.x_max - outline.x_min, outline.y_max - outline.y_min);
+		z_scale = size > 0 ? 32767 / size : 0;
+	}
+	clip_linked(outer, 0, triangles);
+}
+
+Node* Triangulator::insert_node(std::uint32_t i, float x, float y, Node* last)
+{
+	Node node = {i, x, y, 0, 0, 0, 0, 0, false};
+	nodes.push_back(node);
+	Node* p = &nodes.back();
+	if (!last) {
+		p->prev = p;
+		p->next = p;
+	}
+	else {
+		p->next = last->next;
+		p->prev = last;
+		last->next->prev = p;
+		last->next = p;
+	}
+	return p;
+}
+
+Node* Triangulator::linked_list(const float* xy, std::uint32_t start, std::uint32_t end,
+                                bool clockwise)
+{
+	float sum = 0;
+	for (std::uint32_t i = start, j = end - 1; i < end; j = i++) {
+		sum += (xy[2 * j] - xy[2 * i]) * (xy[2 * i + 1] + xy[2 * j + 1]);
+	}
+	Node* last = 0;
+	if (clockwise == (sum > 0)) {
+		for (std::uint32_t i = start; i < end; ++i) {
+			last = insert_node(i, xy[2 * i], xy[2 * i + 1], last);
+		}
+	}
+	else {
+		for (std::uint32_t i = end; i-- > start;) {
+			last = insert_node(i, xy[2 * i], xy[2 * i + 1], last);
+		}
+	}
+	if (last && equals(last, last->next)) {
+		remove_node(last);
+		last = last->next;
+	}
+	return last;
+}
+
+Node* Triangulator::eliminate_holes(const float* xy, const std::vector<const Ring*>& holes,
+                                    Node* outer)
+{
+	hole_queue.clear();
+	for (auto hole : holes) {
+		Node* list = linked_list(xy, hole->start, hole->end, false);
+		if (list == list->next) {
+			list->steiner = true;
+		}
+		hole_queue.push_back(leftmost(list));
+	}
+	// Holes are bridged from left to right, so that every bridge goes to
+	// the outer ring or to a hole already part of it.
+	std::sort(hole_queue.begin(), hole_queue.end(),
+		[](const Node* a, const Node* b)
+		{
+			return a->x < b->x;
+		});
+	for (auto hole : hole_queue) {
+		Node* bridge = find_hole_bridge(hole, outer);
+		if (!bridge) {
+			continue;
+		}
+		Node* bridge_reverse = split_polygon(bridge, hole);
+		filter_points(bridge_reverse, bridge_reverse->next);
+		outer = filter_points(bridge, bridge->next);
+	}
+	return outer;
+}
+
+void Triangulator::clip_linked(Node* ear, int pass, std::vector<std::uint32_t>* triangles)
+{
+	if (!ear) {
+		return;
+	}
+	if (pass == 0 && z_scale > 0) {
+		Node* p = ear;
+		do {
+			if (p->z == 0) {
+				p->z = z_order(p->x, p->y, min_x, min_y, z_scale);
+			}
+			p->prev_z = p->prev;
+			p->next_z = p->next;
+			p = p->next;
+		} while (p != ear);
+		p->prev_z->next_z = 0;
+		p->prev_z = 0;
+		sort_linked(p);
+	}
+
+	Node* stop = ear;
+	while (ear->prev != ear->next) {
+		Node* prev = ear->prev;
+		Node* next = ear->next;
+		if (z_scale > 0 ? is_ear_hashed(ear, min_x, min_y, z_scale) : is_ear(ear)) {
+			triangles->push_back(prev->i);
+			triangles->push_back(ear->i);
+			triangles->push_back(next->i);
+			remove_node(ear);
+			// Skipping the next point gives fewer sliver triangles.
+			ear = next->next;
+			stop = next->next;
+			continue;
+		}
+		ear = next;
+		if (ear == stop) {
+			// No ears left: remove degenerate points and try again, then
+			// clip where the ring crosses itself, and last split the ring
+			// in two.
+			if (pass == 0) {
+				clip_linked(filter_points(ear), 1, triangles);
+			}
+			else if (pass == 1) {
+				ear = cure_local_intersections(filter_points(ear), triangles);
+				clip_linked(ear, 2, triangles);
+			}
+			else if (pass == 2) {
+				split_clip(ear, triangles);
+			}
+			break;
+		}
+	}
+}
+
+void Triangulator::split_clip(Node* start, std::vector<std::uint32_t>* triangles)
+{
+	Node* a = start;
+	do {
+		for (Node* b = a->next->next; b != a->prev; b = b->next) {
+			if (a->i != b->i && is_valid_diagonal(a, b)) {
+				Node* c = split_polygon(a, b);
+				a = filter_points(a, a->next);
+				c = filter_points(c, c->next);
+				clip_linked(a, 0, triangles);
+				clip_linked(c, 0, triangles);
+				return;
+			}
+		}
+		a = a->next;
+	} while (a != start);
+}
+
+Node* Triangulator::split_polygon(Node* a, Node* b)
+{
+	// The two rings share copies of a and b.
+	Node* a2 = insert_node(a->i, a->x, a->y, 0);
+	Node* b2 = insert_node(b->i, b->x, b->y, 0);
+	Node* an = a->next;
+	Node* bp = b->prev;
+
+	a->next = b;
+	b->prev = a;
+
+	a2->next = an;
+	an->prev = a2;
+
+	b2->next = a2;
+	a2->prev = b2;
+
+	bp->next = b2;
+	b2->prev = bp;
+	return b2;
+}
+
+}
@@ -0,0 +1,81 @@
+// Petter Strandmark 2013.
+
+#ifndef RAPIDSVG_TRIANGULATION_H
+#define RAPIDSVG_TRIANGULATION_H
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace rapidsvg {
+
+// Triangulates shapes made of several rings, such as paths with subpaths,
+// by ear clipping. The rings are sorted into outlines and holes by the
+// fill rule, and every hole is bridged into the outline around it, so that
+// each outline and its holes are clipped as one ring. The remaining points
+// are kept in a linked list sorted along a z-order curve, so that finding
+// an ear only looks at the points near it. The buffers are kept between
+// calls.
+class Triangulator
+{
+public:
+	// Triangulates the shape whose rings have the points xy = x0, y0, x1,
+	// y1, ... Ring k ends before point ring_ends[k] and starts where the
+	// ring before it ends. A point is filled by the evenodd fill rule if
+	// even_odd is true and by the nonzero rule otherwise. triangles is
+	// replaced by the indices of the points of the triangles, three for
+	// each. Rings crossing each other are not split where they cross.
+	void triangulate(const float* xy, const std::uint32_t* ring_ends, size_t num_rings,
+	                 bool even_odd, std::vector<std::uint32_t>* triangles);
+
+	// A point of the ring being clipped.
+	struct Node
+	{
+		std::uint32_t i;
+		float x, y;
+		Node* prev;
+		Node* next;
+		// Position along the z-order curve and the neighbours in the list
+		// sorted by it.
+		std::int32_t z;
+		Node* prev_z;
+		Node* next_z;
+		// Whether the node is a single point hole, which is not removed.
+		bool steiner;
+	};
+
+private:
+	class Ring
+	{
+	public:
+		std::uint32_t start, end;
+		// Twice the signed area, positive if counterclockwise.
+		double area;
+		float x_min, y_min, x_max, y_max;
+		// Index of the outline a hole lies in, or one of the values below.
+		int parent;
+		enum {Outline = -1, Unused = -2, Hole = -3};
+	};
+
+	void clip(const float* xy, const Ring& outline, const std::vector<const Ring*>& holes,
+	          std::vector<std::uint32_t>* triangles);
+
+	Node* linked_list(const float* xy, std::uint32_t start, std::uint32_t end, bool clockwise);
+	Node* insert_node(std::uint32_t i, float x, float y, Node* last);
+	Node* eliminate_holes(const float* xy, const std::vector<const Ring*>& holes, Node* outer);
+	void clip_linked(Node* ear, int pass, std::vector<std::uint32_t>* triangles);
+	void split_clip(Node* start, std::vector<std::uint32_t>* triangles);
+	Node* split_polygon(Node* a, Node* b);
+
+	std::deque<Node> nodes;
+	std::vector<Ring> rings;
+	std::vector<const Ring*> outline_holes;
+	std::vector<Node*> hole_queue;
+	// Bounding box and scale of the z-order curve, or scale 0 for small
+	// rings, which are clipped without it.
+	float min_x, min_y, z_scale;
+};
+
+}
+
+#endif